@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include "../log.h"
+#include "bench_support.h"
+
+// The benchmarks do not write log files
+ServiceInstance<Logger> Logger::instance_;
+
+Logger* Logger::getInstance()
+{
+    return instance_.get([]() { return new Logger(); });
+}
+
+Logger::Logger()
+{
+}
+
+Logger::~Logger()
+{
+}
+
+void Logger::FnCreateLogFile()
+{
+}
+
+void Logger::FnLog(std::string, std::string)
+{
+}
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<std::size_t>(p * values.size()))];
+}
+
+void printReportHeader(const std::string& nameTitle, const std::vector<reportColumn>& columns)
+{
+    std::cout << std::left << std::setw(12) << nameTitle << std::right;
+    for (const reportColumn& column : columns)
+    {
+        std::cout << std::setw(column.width) << column.title;
+    }
+    std::cout << "\n";
+}
+
+void printReportRow(const std::string& name, const std::vector<reportColumn>& columns, const std::vector<double>& values)
+{
+    std::cout << std::left << std::setw(12) << name << std::right << std::fixed;
+    for (std::size_t i = 0; i < columns.size() && i < values.size(); i++)
+    {
+        std::cout << std::setprecision(columns[i].precision) << std::setw(columns[i].width) << values[i];
+    }
+    std::cout << "\n";
+}
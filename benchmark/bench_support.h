@@ -0,0 +1,78 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/system/error_code.hpp>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Shared by the benchmarks. bench_support.cpp also defines a Logger that
+ * writes nothing, linked in place of log.cpp so no benchmark writes log files.
+ */
+
+// Value at quantile p (0 to 1) of values, 0 for none
+double percentile(std::vector<double> values, double p);
+
+struct sequentialResult
+{
+    std::size_t failures = 0;
+    std::vector<double> latencyUs;
+};
+
+// Sends requests one at a time on a fresh io_context. Every request is
+// started from the completion of the previous one, so the io_context thread
+// only ever runs client code. send(ioc, onDone) starts one request and
+// run(ioc) runs the io_context, so a benchmark can measure around it. The
+// completion callback only captures one pointer, like the callbacks Central
+// passes.
+template <typename Send, typename Run>
+sequentialResult runSequentialRequests(int requests, Send send, Run run)
+{
+    struct State
+    {
+        boost::asio::io_context ioc{1};
+        sequentialResult result;
+        int remaining;
+        std::chrono::steady_clock::time_point start;
+        Send send;
+
+        void next()
+        {
+            start = std::chrono::steady_clock::now();
+            send(ioc, [this](boost::system::error_code ec, const std::string& msg) { done(ec, msg); });
+        }
+
+        void done(boost::system::error_code ec, const std::string& msg)
+        {
+            result.latencyUs.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            if (ec || !msg.empty())
+            {
+                result.failures++;
+            }
+            if (--remaining > 0)
+            {
+                next();
+            }
+        }
+    } state{{}, {}, requests, {}, std::move(send)};
+
+    state.result.latencyUs.reserve(requests);
+    boost::asio::post(state.ioc, [&state]() { state.next(); });
+    run(state.ioc);
+    return std::move(state.result);
+}
+
+// A results table column, right aligned, values printed with precision decimals
+struct reportColumn
+{
+    const char* title;
+    int width;
+    int precision;
+};
+
+// Header and rows of a results table whose first column is the run name
+void printReportHeader(const std::string& nameTitle, const std::vector<reportColumn>& columns);
+void printReportRow(const std::string& name, const std::vector<reportColumn>& columns, const std::vector<double>& values);
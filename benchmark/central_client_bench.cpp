@@ -0,0 +1,175 @@
+// Callback vs coroutine Central client benchmark.
+// Sends the same ParkInOut sized POST to a loopback responder, once through
+// httpClientSession (callback chain) and once through coroutineHttpClient,
+// and reports heap allocations per request on the client thread and the
+// request latency distribution.
+//
+// Usage: central_client_bench [requests]
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../central.h"
+#include "bench_support.h"
+
+namespace
+{
+
+// Only allocations made on the client thread are counted
+std::atomic<std::size_t> allocationCount{0};
+thread_local bool countAllocations = false;
+
+}
+
+void* operator new(std::size_t size)
+{
+    if (countAllocations)
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+
+const char* RESPONSE_BODY = R"({"status":"ok"})";
+
+std::atomic<bool> responderStopping{false};
+
+// Connection-per-request responder, like Central closes after every reply
+void runResponder(boost::asio::ip::tcp::acceptor& acceptor)
+{
+    for (;;)
+    {
+        boost::asio::ip::tcp::socket socket(acceptor.get_executor());
+        boost::system::error_code ec;
+        acceptor.accept(socket, ec);
+        if (ec || responderStopping)
+        {
+            return;
+        }
+
+        boost::beast::flat_buffer buffer;
+        boost::beast::http::request<boost::beast::http::string_body> req;
+        boost::beast::http::read(socket, buffer, req, ec);
+        if (ec)
+        {
+            continue;
+        }
+
+        boost::beast::http::response<boost::beast::http::string_body> res{boost::beast::http::status::ok, req.version()};
+        res.set(boost::beast::http::field::content_type, "application/json");
+        res.keep_alive(false);
+        res.body() = RESPONSE_BODY;
+        res.prepare_payload();
+        boost::beast::http::write(socket, res, ec);
+        socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+    }
+}
+
+const std::vector<reportColumn> COLUMNS = {
+    {"allocs/req", 10, 1}, {"p50 us", 10, 1}, {"p99 us", 10, 1}, {"failed", 10, 0}};
+
+struct Result
+{
+    std::size_t allocations = 0;
+    sequentialResult requests;
+};
+
+template <typename Send>
+Result runClient(int requests, Send send)
+{
+    Result result;
+    result.requests = runSequentialRequests(requests, std::move(send), [&result](boost::asio::io_context& ioc) {
+        allocationCount = 0;
+        countAllocations = true;
+        ioc.run();
+        countAllocations = false;
+        result.allocations = allocationCount;
+    });
+    return result;
+}
+
+void report(const std::string& name, int requests, const Result& result)
+{
+    printReportRow(name, COLUMNS, {static_cast<double>(result.allocations) / requests,
+                                   percentile(result.requests.latencyUs, 0.50),
+                                   percentile(result.requests.latencyUs, 0.99),
+                                   static_cast<double>(result.requests.failures)});
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int requests = (argc > 1) ? std::atoi(argv[1]) : 5000;
+
+    boost::asio::io_context serverIoc;
+    boost::asio::ip::tcp::acceptor acceptor(serverIoc, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    std::string port = std::to_string(acceptor.local_endpoint().port());
+    std::thread responder([&acceptor]() { runResponder(acceptor); });
+
+    std::string body = R"({"username":"EVHogging","password":"123","location_code":"ABC123","lot_no":"165","lpn":"SNN4019G","lot_in_image":"","lot_out_image":"","lot_in_time":"2024-04-11 21:32:51","lot_out_time":""})";
+
+    std::cout << "requests " << requests << "\n";
+    printReportHeader("client", COLUMNS);
+
+    // Both clients get a freshly built payload per request, as Central
+    // serializes the JSON body for every send.
+    // A session is reused across requests, as Central did per endpoint.
+    std::shared_ptr<httpClientSession> session;
+    Result callbackResult = runClient(requests, [&](boost::asio::io_context& ioc, auto onDone) {
+        if (!session)
+        {
+            session = std::make_shared<httpClientSession>(ioc, onDone);
+        }
+        std::string payload = body;
+        session->run("127.0.0.1", port, "/ParkInOut", 11, payload);
+    });
+    session.reset();
+    report("callback", requests, callbackResult);
+
+    std::shared_ptr<coroutineHttpClient> client;
+    centralRequestPolicy policy;
+    Result coroutineResult = runClient(requests, [&](boost::asio::io_context& ioc, auto onDone) {
+        if (!client)
+        {
+            client = std::make_shared<coroutineHttpClient>(ioc);
+        }
+        std::string payload = body;
+        client->post("127.0.0.1", port, "/ParkInOut", std::move(payload), policy, onDone);
+    });
+    client.reset();
+    report("coroutine", requests, coroutineResult);
+
+    // Unblock the responder waiting in accept
+    responderStopping = true;
+    boost::system::error_code ec;
+    boost::asio::ip::tcp::socket wake(serverIoc);
+    wake.connect(acceptor.local_endpoint(), ec);
+    responder.join();
+
+    return 0;
+}
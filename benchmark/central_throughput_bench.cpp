@@ -0,0 +1,200 @@
+// Central client throughput benchmark.
+// Starts a loopback MockCentral, points the configuration at it and pushes
+// park events with base64 images through Central::FnSendParkInParkOutInfo,
+// keeping [concurrency] events in flight. Reports events/sec, bytes/sec on
+// the wire and the send latency distribution. Every event is one request
+// (maxAttempts=1), so mock errors and drops show up as failed events.
+// With [batch_events] above 1 events are coalesced into /ParkInOutBatch
+// requests of that many events, flushed after at most [batch_delay_ms];
+// "nobatch" makes the mock refuse batches to exercise the single fallback.
+// [none|gzip|deflate] [level] compress the request bodies.
+//
+// Usage: central_throughput_bench [events] [concurrency] [image_kb] [latency_ms] [jitter_ms] [error_rate] [drop_rate] [close|keepalive] [batch_events] [batch_delay_ms] [batch|nobatch] [none|gzip|deflate] [level]
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../central.h"
+#include "../common.h"
+#include "../ini_parser.h"
+#include "../log.h"
+#include "bench_support.h"
+#include "mock_central.h"
+
+namespace
+{
+
+void writeRandomFile(const std::string& path, std::size_t size)
+{
+    std::mt19937 random(static_cast<unsigned int>(size));
+    std::vector<char> data(size);
+    std::generate(data.begin(), data.end(), [&random]() { return static_cast<char>(random()); });
+    std::ofstream(path, std::ios::binary).write(data.data(), data.size());
+}
+
+void writeIniFile(const std::string& path, unsigned short port, int batchEvents, int batchDelayMs, const std::string& compression, int compressionLevel)
+{
+    std::ofstream ini(path);
+    ini << "[setting]\n"
+        << "cameraIP=127.0.0.1\n"
+        << "centralIP=127.0.0.1\n"
+        << "centralServerPort=" << port << "\n"
+        << "parkingLotLocationCode=BENCH\n"
+        << "timerForFilteringSnapshot=60\n"
+        << "timerTimeoutForDeviceStatusUpdateToCentral=60\n"
+        << "timerCentralHeartbeat=60\n"
+        << "networkInterface=lo\n"
+        << "[central]\n"
+        << "maxAttempts=1\n"
+        << "batchMaxEvents=" << batchEvents << "\n"
+        << "batchMaxDelayMs=" << batchDelayMs << "\n"
+        << "compression=" << compression << "\n"
+        << "compressionLevel=" << compressionLevel << "\n";
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t events = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    std::size_t concurrency = std::max<std::size_t>(1, (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 8);
+    std::size_t imageKb = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 100;
+
+    MockCentral::Options options;
+    options.latency = std::chrono::milliseconds((argc > 4) ? std::atoi(argv[4]) : 5);
+    options.latencyJitter = std::chrono::milliseconds((argc > 5) ? std::atoi(argv[5]) : 5);
+    options.errorRate = (argc > 6) ? std::atof(argv[6]) : 0.0;
+    options.dropRate = (argc > 7) ? std::atof(argv[7]) : 0.0;
+    options.closeMode = ((argc > 8) && (std::strcmp(argv[8], "keepalive") == 0)) ? MockCentral::CloseMode::KeepAlive : MockCentral::CloseMode::Close;
+    int batchEvents = (argc > 9) ? std::atoi(argv[9]) : 1;
+    int batchDelayMs = (argc > 10) ? std::atoi(argv[10]) : 20;
+    options.batchSupport = !((argc > 11) && (std::strcmp(argv[11], "nobatch") == 0));
+    std::string compression = (argc > 12) ? argv[12] : "none";
+    int compressionLevel = (argc > 13) ? std::atoi(argv[13]) : 1;
+
+    char dirTemplate[] = "/tmp/central_bench_XXXXXX";
+    if (mkdtemp(dirTemplate) == nullptr)
+    {
+        std::cerr << "Failed to create a temporary directory" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string dir = dirTemplate;
+    std::string lotInImage = dir + "/lot_in.jpg";
+    std::string lotOutImage = dir + "/lot_out.jpg";
+    std::string iniFile = dir + "/configuration.ini";
+    writeRandomFile(lotInImage, imageKb * 1024);
+    writeRandomFile(lotOutImage, imageKb * 1024 + 1);
+
+    boost::asio::io_context mockIoContext;
+    MockCentral mock(mockIoContext, {boost::asio::ip::make_address("127.0.0.1"), 0}, options);
+    mock.FnStart();
+    std::thread mockThread([&mockIoContext]() { mockIoContext.run(); });
+
+    writeIniFile(iniFile, mock.FnGetPort(), batchEvents, batchDelayMs, compression, compressionLevel);
+    if (!IniParser::getInstance()->FnReadIniFile(iniFile))
+    {
+        return EXIT_FAILURE;
+    }
+
+    boost::asio::io_context centralIoContext;
+    auto work = boost::asio::make_work_guard(centralIoContext);
+    Central::getInstance()->FnCentralInitialization(centralIoContext);
+    std::thread centralThread([&centralIoContext]() { centralIoContext.run(); });
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::size_t inFlight = 0;
+    std::size_t completed = 0;
+    std::size_t failed = 0;
+    std::vector<double> latencyMs;
+    latencyMs.reserve(events);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < events; i++)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return inFlight < concurrency; });
+            inFlight++;
+        }
+
+        // Every other event is a park out, which carries both images
+        bool parkOut = (i % 2) == 1;
+        std::string lotInBase64 = Common::getInstance()->FnConvertImageToBase64String(lotInImage);
+        std::string lotOutBase64 = parkOut ? Common::getInstance()->FnConvertImageToBase64String(lotOutImage) : "";
+
+        auto sent = std::chrono::steady_clock::now();
+        Central::getInstance()->FnSendParkInParkOutInfo(std::to_string(i % 500 + 1),
+                                                        "SNN4019G",
+                                                        lotInBase64,
+                                                        lotOutBase64,
+                                                        "2024-04-11 21:32:51",
+                                                        parkOut ? "2024-04-11 23:02:10" : "",
+                                                        [&, sent](boost::beast::error_code ec, const std::string& msg) {
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sent).count();
+            std::lock_guard<std::mutex> lock(mutex);
+            latencyMs.push_back(elapsed);
+            if (ec || !msg.empty())
+            {
+                failed++;
+            }
+            completed++;
+            inFlight--;
+            cv.notify_all();
+        });
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return completed == events; });
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const MockCentral::Counters& counters = mock.FnGetCounters();
+    std::sort(latencyMs.begin(), latencyMs.end());
+
+    std::cout << "events " << events << ", concurrency " << concurrency << ", image " << imageKb << " KiB"
+              << ", mock latency " << options.latency.count() << "+" << options.latencyJitter.count() << " ms"
+              << ", error rate " << options.errorRate << ", drop rate " << options.dropRate
+              << ", " << ((options.closeMode == MockCentral::CloseMode::KeepAlive) ? "keepalive" : "close")
+              << ", batch " << batchEvents << " / " << batchDelayMs << " ms" << (options.batchSupport ? "" : " (refused)")
+              << ", compression " << compression << " " << compressionLevel << "\n"
+              << "ok " << (events - failed) << ", failed " << failed
+              << " (mock errors " << counters.errors << ", drops " << counters.drops << ")\n"
+              << "mock saw   " << counters.parkInOuts << " park events, " << counters.parkInOutBatches << " batch requests\n"
+              << std::fixed << std::setprecision(1)
+              << "events/sec " << events / seconds << "\n"
+              << "MB/sec     " << counters.bytesReceived / seconds / 1e6
+              << " (" << counters.compressedRequests << " compressed requests, " << counters.bytesInflated / seconds / 1e6 << " MB/sec inflated)\n"
+              << std::setprecision(2)
+              << "latency ms p50 " << percentile(latencyMs, 0.50)
+              << "  p90 " << percentile(latencyMs, 0.90)
+              << "  p99 " << percentile(latencyMs, 0.99)
+              << "  p99.9 " << percentile(latencyMs, 0.999)
+              << "  max " << (latencyMs.empty() ? 0 : latencyMs.back()) << std::endl;
+
+    work.reset();
+    centralThread.join();
+    mock.FnStop();
+    mockThread.join();
+
+    std::remove(lotInImage.c_str());
+    std::remove(lotOutImage.c_str());
+    std::remove(iniFile.c_str());
+    rmdir(dir.c_str());
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+// Request body compression benchmark.
+// Builds park out bodies (two base64 images in the ParkInOut JSON) and
+// compresses them with every encoding, level and strategy, reporting the CPU time per
+// body against the bytes saved. Without image files the images are random
+// bytes, as incompressible as JPEG data; pass real snapshots to measure
+// those instead.
+//
+// Usage: compression_bench [iterations] [image files...]
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../body_compression.h"
+#include "../common.h"
+#include "../log.h"
+#include "../payload_template.h"
+#include "bench_support.h"
+
+namespace
+{
+
+struct sample
+{
+    std::string name;
+    std::string body;
+};
+
+std::string randomBase64(std::size_t size)
+{
+    std::mt19937 random(static_cast<unsigned int>(size));
+    std::vector<unsigned char> data(size);
+    for (unsigned char& c : data)
+    {
+        c = static_cast<unsigned char>(random());
+    }
+    return Common::getInstance()->FnEncodeBase64(boost::asio::buffer(data));
+}
+
+std::string parkOutBody(const std::string& lotInImage, const std::string& lotOutImage)
+{
+    PayloadTemplate parkInOut({
+        staticPayloadField("username", "testuser"),
+        staticPayloadField("password", "testpassword"),
+        staticPayloadField("carpark_code", "OGS"),
+        variablePayloadField("lot_no"),
+        variablePayloadField("lpn"),
+        variablePayloadField("lot_in_image"),
+        variablePayloadField("lot_out_image"),
+        variablePayloadField("lot_in_time"),
+        variablePayloadField("lot_out_time")
+    });
+
+    std::string body;
+    std::string log;
+    parkInOut.FnRender({"165", "SNN4019G", lotInImage, lotOutImage, "2024-04-11 21:32:51", "2024-04-11 23:02:10"}, body, log);
+    return body;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int iterations = (argc > 1) ? std::max(1, std::atoi(argv[1])) : 50;
+
+    std::vector<sample> samples;
+    if (argc > 2)
+    {
+        for (int i = 2; i < argc; i++)
+        {
+            std::string image = Common::getInstance()->FnConvertImageToBase64String(argv[i]);
+            if (image.empty())
+            {
+                std::cerr << "Failed to read " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+            samples.push_back({argv[i], parkOutBody(image, image)});
+        }
+    }
+    else
+    {
+        for (std::size_t kb : {50, 100, 200})
+        {
+            samples.push_back({"random " + std::to_string(kb) + " KiB x2", parkOutBody(randomBase64(kb * 1024), randomBase64(kb * 1024 + 1))});
+        }
+    }
+
+    struct setting
+    {
+        contentEncoding encoding;
+        int level;
+        compressionStrategy strategy;
+    };
+    const std::vector<setting> settings = {
+        {contentEncoding::Gzip, 1, compressionStrategy::Default},
+        {contentEncoding::Gzip, 3, compressionStrategy::Default},
+        {contentEncoding::Gzip, 6, compressionStrategy::Default},
+        {contentEncoding::Gzip, 9, compressionStrategy::Default},
+        {contentEncoding::Gzip, 1, compressionStrategy::HuffmanOnly},
+        {contentEncoding::Deflate, 1, compressionStrategy::Default},
+        {contentEncoding::Deflate, 1, compressionStrategy::HuffmanOnly}
+    };
+
+    std::cout << std::left << std::setw(24) << "body" << std::setw(10) << "encoding" << std::setw(7) << "level" << std::setw(10) << "strategy"
+              << std::right << std::setw(11) << "body KiB" << std::setw(11) << "sent KiB" << std::setw(9) << "saved"
+              << std::setw(13) << "compress us" << std::setw(9) << "MB/s" << std::setw(12) << "inflate us" << "\n";
+
+    for (const sample& s : samples)
+    {
+        for (const setting& config : settings)
+        {
+            std::string compressed;
+            std::string inflated;
+
+            // Warm up the thread's zlib state, as steady traffic would
+            BodyCompressor::FnCompress(config.encoding, config.level, config.strategy, s.body, compressed);
+
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++)
+            {
+                if (!BodyCompressor::FnCompress(config.encoding, config.level, config.strategy, s.body, compressed))
+                {
+                    std::cerr << "Compression failed" << std::endl;
+                    return EXIT_FAILURE;
+                }
+            }
+            double compressUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++)
+            {
+                BodyCompressor::FnDecompress(config.encoding, compressed, inflated);
+            }
+            double inflateUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+            if (inflated != s.body)
+            {
+                std::cerr << "Round trip failed" << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            double saved = 1.0 - static_cast<double>(compressed.size()) / s.body.size();
+            std::cout << std::left << std::setw(24) << s.name << std::setw(10) << BodyCompressor::FnGetEncodingName(config.encoding) << std::setw(7) << config.level
+                      << std::setw(10) << ((config.strategy == compressionStrategy::HuffmanOnly) ? "huffman" : "default")
+                      << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(11) << s.body.size() / 1024.0 << std::setw(11) << compressed.size() / 1024.0
+                      << std::setw(8) << saved * 100 << "%"
+                      << std::setw(13) << compressUs << std::setw(9) << s.body.size() / compressUs
+                      << std::setw(12) << inflateUs << "\n";
+        }
+    }
+
+    return 0;
+}
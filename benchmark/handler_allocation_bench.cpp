@@ -0,0 +1,287 @@
+// Allocation-counting benchmark for the camera server session.
+// Replays keep-alive POSTs and short-lived connections against a loopback
+// copy of the camera session, once with plain bind_front_handler/make_shared
+// (previous code) and once with handler_memory + pooled sessions (current
+// code), and reports heap allocations per request.
+//
+// Usage: handler_allocation_bench [requests]
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <thread>
+#include "../handler_allocator.h"
+
+namespace
+{
+
+// Only allocations made on the server thread are counted
+std::atomic<std::size_t> allocationCount{0};
+thread_local bool countAllocations = false;
+
+}
+
+void* operator new(std::size_t size)
+{
+    if (countAllocations)
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+
+const char* REQUEST_BODY = R"({"lot_no":"165","lpn":"SNN4019G","lot_in_time":"2024-04-11 21:32:51"})";
+
+typedef boost::asio::strand<boost::asio::io_context::executor_type> strand_type;
+
+// The previous session type-erases its strand (any_io_executor), which costs
+// an allocation per executor copy, the current one keeps the concrete type.
+template <bool Recycling>
+using bench_stream = typename std::conditional<Recycling,
+    boost::beast::basic_stream<boost::asio::ip::tcp, strand_type>,
+    boost::beast::tcp_stream>::type;
+
+template <bool Recycling>
+class BenchSession : public std::enable_shared_from_this<BenchSession<Recycling>>
+{
+public:
+    template <typename Socket>
+    explicit BenchSession(Socket&& socket)
+        : stream_(std::move(socket))
+    {
+    }
+
+    void do_read()
+    {
+        if (Recycling)
+        {
+            req_.clear();
+            req_.body().clear();
+        }
+        else
+        {
+            req_ = {};
+        }
+        stream_.expires_after(std::chrono::seconds(30));
+        boost::beast::http::async_read(stream_, buffer_, req_, wrap(&BenchSession::on_read));
+    }
+
+private:
+    bench_stream<Recycling> stream_;
+    boost::beast::flat_buffer buffer_;
+    boost::beast::http::request<boost::beast::http::string_body> req_;
+    boost::beast::http::response<boost::beast::http::string_body> res_;
+    handler_memory handlerMemory_;
+
+    template <typename Fn>
+    auto wrap(Fn fn)
+    {
+        auto handler = boost::beast::bind_front_handler(fn, this->shared_from_this());
+        if constexpr (Recycling)
+        {
+            return make_custom_alloc_handler(handlerMemory_, std::move(handler));
+        }
+        else
+        {
+            return handler;
+        }
+    }
+
+    void on_read(boost::beast::error_code ec, std::size_t)
+    {
+        if (ec)
+        {
+            return;
+        }
+        if (Recycling)
+        {
+            res_.clear();
+            res_.body().clear();
+        }
+        else
+        {
+            res_ = {};
+        }
+        res_.result(boost::beast::http::status::ok);
+        res_.version(req_.version());
+        res_.set(boost::beast::http::field::content_type, "application/json");
+        res_.keep_alive(req_.keep_alive());
+        res_.body() = R"({"code": "0", "msg": "success"})";
+        res_.prepare_payload();
+        boost::beast::http::async_write(stream_, res_, wrap(&BenchSession::on_write));
+    }
+
+    void on_write(boost::beast::error_code ec, std::size_t)
+    {
+        if (ec || !res_.keep_alive())
+        {
+            boost::beast::error_code ignored;
+            stream_.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_send, ignored);
+            return;
+        }
+        do_read();
+    }
+};
+
+template <bool Recycling>
+class BenchListener
+{
+public:
+    explicit BenchListener(boost::asio::io_context& io_context)
+        : io_context_(io_context),
+        acceptor_(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0})
+    {
+        do_accept();
+    }
+
+    boost::asio::ip::tcp::endpoint endpoint() const
+    {
+        return acceptor_.local_endpoint();
+    }
+
+private:
+    boost::asio::io_context& io_context_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    handler_memory handlerMemory_;
+
+    static std::pmr::synchronized_pool_resource& session_pool()
+    {
+        static std::pmr::synchronized_pool_resource pool;
+        return pool;
+    }
+
+    void do_accept()
+    {
+        auto handler = [this](boost::beast::error_code ec, auto socket) {
+            if (ec)
+            {
+                return;
+            }
+            if constexpr (Recycling)
+            {
+                std::allocate_shared<BenchSession<Recycling>>(std::pmr::polymorphic_allocator<BenchSession<Recycling>>(&session_pool()), std::move(socket))->do_read();
+            }
+            else
+            {
+                std::make_shared<BenchSession<Recycling>>(std::move(socket))->do_read();
+            }
+            do_accept();
+        };
+
+        if constexpr (Recycling)
+        {
+            acceptor_.async_accept(boost::asio::make_strand(io_context_), make_custom_alloc_handler(handlerMemory_, std::move(handler)));
+        }
+        else
+        {
+            acceptor_.async_accept(boost::asio::make_strand(io_context_), std::move(handler));
+        }
+    }
+};
+
+// Blocking client on the main thread, its allocations are not counted
+void runClient(boost::asio::ip::tcp::endpoint endpoint, std::size_t requests, bool keepAlive)
+{
+    boost::asio::io_context io_context;
+    boost::beast::tcp_stream stream(io_context);
+    boost::beast::flat_buffer buffer;
+    bool connected = false;
+
+    boost::beast::http::request<boost::beast::http::string_body> req{boost::beast::http::verb::post, "/", 11};
+    req.set(boost::beast::http::field::content_type, "application/json");
+    req.keep_alive(keepAlive);
+    req.body() = REQUEST_BODY;
+    req.prepare_payload();
+
+    for (std::size_t i = 0; i < requests; i++)
+    {
+        if (!connected)
+        {
+            stream.connect(endpoint);
+            connected = true;
+        }
+        boost::beast::http::write(stream, req);
+        boost::beast::http::response<boost::beast::http::string_body> res;
+        boost::beast::http::read(stream, buffer, res);
+        if (!keepAlive)
+        {
+            boost::beast::error_code ignored;
+            stream.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+            stream.close();
+            connected = false;
+        }
+    }
+}
+
+template <bool Recycling>
+double allocationsPerRequest(std::size_t requests, bool keepAlive)
+{
+    boost::asio::io_context io_context(1);
+    BenchListener<Recycling> server(io_context);
+    auto guard = boost::asio::make_work_guard(io_context);
+    std::thread serverThread([&io_context]() {
+        countAllocations = true;
+        io_context.run();
+    });
+
+    // Warm up: first connection sizes buffers and pools
+    runClient(server.endpoint(), 10, keepAlive);
+
+    std::size_t before = allocationCount.load();
+    runClient(server.endpoint(), requests, keepAlive);
+    std::size_t total = allocationCount.load() - before;
+
+    guard.reset();
+    io_context.stop();
+    serverThread.join();
+
+    return static_cast<double>(total) / static_cast<double>(requests);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t requests = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 20000;
+
+    std::cout << "server allocations per request, " << requests << " requests" << std::endl;
+    std::cout << std::left << std::setw(26) << "mode"
+              << std::setw(16) << "previous"
+              << std::setw(16) << "recycling" << std::endl;
+
+    std::cout << std::left << std::fixed << std::setprecision(2)
+              << std::setw(26) << "keep-alive"
+              << std::setw(16) << allocationsPerRequest<false>(requests, true)
+              << std::setw(16) << allocationsPerRequest<true>(requests, true) << std::endl;
+
+    std::cout << std::left << std::fixed << std::setprecision(2)
+              << std::setw(26) << "connection per request"
+              << std::setw(16) << allocationsPerRequest<false>(requests / 10, false)
+              << std::setw(16) << allocationsPerRequest<true>(requests / 10, false) << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,401 @@
+#include <boost/beast/ssl.hpp>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "../body_compression.h"
+#include "mock_central.h"
+
+namespace
+{
+
+const char* REPLY_OK = R"({"status":"ok"})";
+const char* REPLY_ERROR = R"({"status":"error","message":"mock failure"})";
+
+// Acknowledges every event of a batch. Event ids are the only
+// "event_id" keys of the body, the base64 images cannot contain quotes.
+std::string batchReply(boost::beast::string_view body, std::size_t& events)
+{
+    static const boost::beast::string_view key = "\"event_id\":\"";
+
+    std::string reply = R"({"status":"ok","results":[)";
+    events = 0;
+    std::size_t pos = body.find(key);
+    while (pos != boost::beast::string_view::npos)
+    {
+        std::size_t idStart = pos + key.size();
+        std::size_t idEnd = body.find('"', idStart);
+        if (idEnd == boost::beast::string_view::npos)
+        {
+            break;
+        }
+        if (events > 0)
+        {
+            reply += ',';
+        }
+        reply += R"({"event_id":")";
+        reply.append(body.data() + idStart, idEnd - idStart);
+        reply += R"(","status":"ok"})";
+        events++;
+        pos = body.find(key, idEnd);
+    }
+    reply += "]}";
+    return reply;
+}
+
+// P-256 key and a self-signed certificate for the listen endpoint, installed
+// in context. Returns the certificate as PEM.
+std::string installSelfSignedCertificate(boost::asio::ssl::context& context, const boost::asio::ip::tcp::endpoint& endpoint)
+{
+    std::string address = endpoint.address().to_string();
+    // The port keeps the subjects of several mocks apart in one trust store
+    std::string commonName = "MockCentral " + address + ":" + std::to_string(endpoint.port());
+
+    EVP_PKEY* key = nullptr;
+    EVP_PKEY_CTX* keyContext = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+    if (!keyContext || (EVP_PKEY_keygen_init(keyContext) <= 0) ||
+        (EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyContext, NID_X9_62_prime256v1) <= 0) ||
+        (EVP_PKEY_keygen(keyContext, &key) <= 0))
+    {
+        EVP_PKEY_CTX_free(keyContext);
+        throw std::runtime_error("mock key generation failed");
+    }
+    EVP_PKEY_CTX_free(keyContext);
+
+    X509* certificate = X509_new();
+    X509_set_version(certificate, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+    X509_gmtime_adj(X509_getm_notBefore(certificate), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(certificate), 7 * 24 * 3600);
+    X509_set_pubkey(certificate, key);
+
+    X509_NAME* name = X509_get_subject_name(certificate);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>(commonName.c_str()), -1, -1, 0);
+    X509_set_issuer_name(certificate, name);
+
+    // Clients check the address they connect to against the alternative name
+    X509V3_CTX extensionContext;
+    X509V3_set_ctx_nodb(&extensionContext);
+    X509V3_set_ctx(&extensionContext, certificate, certificate, nullptr, nullptr, 0);
+    std::string alternativeName = "IP:" + address;
+    X509_EXTENSION* extension = X509V3_EXT_conf_nid(nullptr, &extensionContext, NID_subject_alt_name, alternativeName.c_str());
+    if (extension)
+    {
+        X509_add_ext(certificate, extension, -1);
+        X509_EXTENSION_free(extension);
+    }
+
+    X509_sign(certificate, key, EVP_sha256());
+
+    SSL_CTX_use_certificate(context.native_handle(), certificate);
+    SSL_CTX_use_PrivateKey(context.native_handle(), key);
+
+    BIO* bio = BIO_new(BIO_s_mem());
+    PEM_write_bio_X509(bio, certificate);
+    char* data = nullptr;
+    long size = BIO_get_mem_data(bio, &data);
+    std::string pem(data, static_cast<std::size_t>(size));
+
+    BIO_free(bio);
+    X509_free(certificate);
+    EVP_PKEY_free(key);
+    return pem;
+}
+
+}
+
+template <typename Stream>
+class MockCentral::Session : public std::enable_shared_from_this<MockCentral::Session<Stream>>
+{
+public:
+    static constexpr bool IS_TLS = !std::is_same<Stream, boost::beast::tcp_stream>::value;
+
+    template <typename... Args>
+    explicit Session(MockCentral& mock, Args&&... args)
+        : mock_(mock),
+        stream_(std::forward<Args>(args)...),
+        timer_(stream_.get_executor())
+    {
+    }
+
+    void run()
+    {
+        if constexpr (IS_TLS)
+        {
+            boost::beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
+            stream_.async_handshake(boost::asio::ssl::stream_base::server,
+                boost::beast::bind_front_handler(&Session::onHandshake, this->shared_from_this()));
+        }
+        else
+        {
+            doRead();
+        }
+    }
+
+private:
+    MockCentral& mock_;
+    Stream stream_;
+    boost::asio::steady_timer timer_;
+    boost::beast::flat_buffer buffer_;
+    std::optional<boost::beast::http::request_parser<boost::beast::http::string_body>> parser_;
+    boost::beast::http::request<boost::beast::http::string_body> req_;
+    boost::beast::http::response<boost::beast::http::string_body> res_;
+
+    void onHandshake(boost::beast::error_code ec)
+    {
+        if (ec)
+        {
+            return doClose();
+        }
+
+        mock_.counters_.tlsHandshakes.fetch_add(1, std::memory_order_relaxed);
+        if constexpr (IS_TLS)
+        {
+            if (SSL_session_reused(stream_.native_handle()))
+            {
+                mock_.counters_.tlsResumed.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        doRead();
+    }
+
+    void doRead()
+    {
+        // Batches of park events with images exceed the default 1 MB body limit
+        parser_.emplace();
+        parser_->body_limit(64 * 1024 * 1024);
+        boost::beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
+        boost::beast::http::async_read(stream_, buffer_, *parser_,
+            boost::beast::bind_front_handler(&Session::onRead, this->shared_from_this()));
+    }
+
+    void onRead(boost::beast::error_code ec, std::size_t bytes_transferred)
+    {
+        if (ec)
+        {
+            return doClose();
+        }
+
+        mock_.counters_.bytesReceived.fetch_add(bytes_transferred, std::memory_order_relaxed);
+        req_ = parser_->release();
+
+        timer_.expires_after(mock_.rollLatency());
+        timer_.async_wait(boost::beast::bind_front_handler(&Session::onDelay, this->shared_from_this()));
+    }
+
+    void onDelay(boost::beast::error_code ec)
+    {
+        boost::beast::string_view target = req_.target();
+        bool known = true;
+        bool batch = false;
+
+        // Compressed bodies are inflated like Central would, 400 if that fails
+        bool badBody = false;
+        auto encoding = req_.find(boost::beast::http::field::content_encoding);
+        if (encoding != req_.end())
+        {
+            contentEncoding bodyEncoding = BodyCompressor::FnParseEncoding(std::string(encoding->value()));
+            std::string inflated;
+            if (BodyCompressor::FnDecompress(bodyEncoding, req_.body(), inflated))
+            {
+                mock_.counters_.compressedRequests.fetch_add(1, std::memory_order_relaxed);
+                mock_.counters_.bytesInflated.fetch_add(inflated.size(), std::memory_order_relaxed);
+                req_.body() = std::move(inflated);
+            }
+            else
+            {
+                badBody = true;
+            }
+        }
+        if (target == "/HeartBeat")
+        {
+            mock_.counters_.heartbeats.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (target == "/DeviceStatus")
+        {
+            mock_.counters_.deviceStatuses.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (target == "/ParkInOut")
+        {
+            mock_.counters_.parkInOuts.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if ((target == "/ParkInOutBatch") && mock_.options_.batchSupport)
+        {
+            mock_.counters_.parkInOutBatches.fetch_add(1, std::memory_order_relaxed);
+            batch = true;
+        }
+        else
+        {
+            mock_.counters_.notFound.fetch_add(1, std::memory_order_relaxed);
+            known = false;
+        }
+
+        Outcome outcome = (known && !badBody) ? mock_.rollOutcome() : Outcome::Reply;
+        if (outcome == Outcome::Drop)
+        {
+            mock_.counters_.drops.fetch_add(1, std::memory_order_relaxed);
+            boost::beast::get_lowest_layer(stream_).socket().close(ec);
+            return;
+        }
+
+        bool keepAlive = (mock_.options_.closeMode == CloseMode::KeepAlive) && req_.keep_alive();
+
+        res_ = {};
+        res_.version(req_.version());
+        res_.set(boost::beast::http::field::server, "MockCentral");
+        res_.set(boost::beast::http::field::content_type, "application/json");
+        res_.keep_alive(keepAlive);
+        if (!known)
+        {
+            res_.result(boost::beast::http::status::not_found);
+            res_.body() = REPLY_ERROR;
+        }
+        else if (badBody)
+        {
+            mock_.counters_.errors.fetch_add(1, std::memory_order_relaxed);
+            res_.result(boost::beast::http::status::bad_request);
+            res_.body() = REPLY_ERROR;
+        }
+        else if (outcome == Outcome::Error)
+        {
+            mock_.counters_.errors.fetch_add(1, std::memory_order_relaxed);
+            res_.result(boost::beast::http::status::internal_server_error);
+            res_.body() = REPLY_ERROR;
+        }
+        else if (batch)
+        {
+            std::size_t events = 0;
+            res_.result(boost::beast::http::status::ok);
+            res_.body() = batchReply(req_.body(), events);
+            mock_.counters_.parkInOuts.fetch_add(events, std::memory_order_relaxed);
+        }
+        else
+        {
+            res_.result(boost::beast::http::status::ok);
+            res_.body() = REPLY_OK;
+        }
+        res_.prepare_payload();
+
+        boost::beast::http::async_write(stream_, res_,
+            boost::beast::bind_front_handler(&Session::onWrite, this->shared_from_this(), keepAlive));
+    }
+
+    void onWrite(bool keepAlive, boost::beast::error_code ec, std::size_t)
+    {
+        if (ec || !keepAlive)
+        {
+            return doClose();
+        }
+
+        doRead();
+    }
+
+    void doClose()
+    {
+        // No TLS close_notify, Central's client does not wait for one either
+        boost::beast::error_code ec;
+        if constexpr (IS_TLS)
+        {
+            // Keeps the session resumable for the client's next connection
+            SSL_set_shutdown(stream_.native_handle(), SSL_SENT_SHUTDOWN);
+        }
+        boost::beast::get_lowest_layer(stream_).socket().shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+        boost::beast::get_lowest_layer(stream_).socket().close(ec);
+    }
+};
+
+MockCentral::MockCentral(boost::asio::io_context& io_context, const boost::asio::ip::tcp::endpoint& endpoint, const Options& options)
+    : io_context_(io_context),
+    acceptor_(io_context),
+    options_(options),
+    random_(std::random_device{}())
+{
+    acceptor_.open(endpoint.protocol());
+    acceptor_.set_option(boost::asio::socket_base::reuse_address(true));
+    acceptor_.bind(endpoint);
+    acceptor_.listen(boost::asio::socket_base::max_listen_connections);
+
+    if (options_.tls)
+    {
+        tlsContext_ = std::make_unique<boost::asio::ssl::context>(boost::asio::ssl::context::tls_server);
+        certificatePem_ = installSelfSignedCertificate(*tlsContext_, acceptor_.local_endpoint());
+    }
+}
+
+void MockCentral::FnStart()
+{
+    doAccept();
+}
+
+void MockCentral::FnStop()
+{
+    boost::asio::post(io_context_, [this]() {
+        boost::system::error_code ec;
+        acceptor_.close(ec);
+    });
+}
+
+unsigned short MockCentral::FnGetPort() const
+{
+    return acceptor_.local_endpoint().port();
+}
+
+const MockCentral::Counters& MockCentral::FnGetCounters() const
+{
+    return counters_;
+}
+
+const std::string& MockCentral::FnGetCertificatePem() const
+{
+    return certificatePem_;
+}
+
+MockCentral::Outcome MockCentral::rollOutcome()
+{
+    std::lock_guard<std::mutex> lock(randomMutex_);
+    double roll = std::uniform_real_distribution<double>(0.0, 1.0)(random_);
+    if (roll < options_.dropRate)
+    {
+        return Outcome::Drop;
+    }
+    if (roll < options_.dropRate + options_.errorRate)
+    {
+        return Outcome::Error;
+    }
+    return Outcome::Reply;
+}
+
+std::chrono::milliseconds MockCentral::rollLatency()
+{
+    if (options_.latencyJitter.count() <= 0)
+    {
+        return options_.latency;
+    }
+    std::lock_guard<std::mutex> lock(randomMutex_);
+    return options_.latency + std::chrono::milliseconds(std::uniform_int_distribution<long>(0, options_.latencyJitter.count())(random_));
+}
+
+void MockCentral::doAccept()
+{
+    acceptor_.async_accept(boost::asio::make_strand(io_context_),
+        [this](boost::beast::error_code ec, boost::asio::ip::tcp::socket socket) {
+            if (ec)
+            {
+                // Acceptor closed by FnStop()
+                return;
+            }
+            counters_.connections.fetch_add(1, std::memory_order_relaxed);
+            if (tlsContext_)
+            {
+                std::make_shared<Session<boost::beast::ssl_stream<boost::beast::tcp_stream>>>(*this, std::move(socket), *tlsContext_)->run();
+            }
+            else
+            {
+                std::make_shared<Session<boost::beast::tcp_stream>>(*this, std::move(socket))->run();
+            }
+            doAccept();
+        });
+}
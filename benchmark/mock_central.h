@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+
+/*
+ * Loopback stand-in for the Central server, for load tests without the
+ * real one. Serves /HeartBeat, /DeviceStatus, /ParkInOut and the
+ * /ParkInOutBatch batch target with a JSON reply after a configurable delay,
+ * and can fail or drop a share of the requests. Other targets get 404.
+ * gzip and deflate request bodies are inflated, 400 if they are invalid.
+ * With tls the mock serves HTTPS with a self-signed certificate made at
+ * startup for the listen address, clients can trust it by its PEM.
+ */
+class MockCentral
+{
+public:
+    enum class CloseMode
+    {
+        Close,      // reply with Connection: close and close, like Central does
+        KeepAlive   // keep the connection for further requests
+    };
+
+    struct Options
+    {
+        std::chrono::milliseconds latency{0};
+        // Uniform extra delay in [0, latencyJitter]
+        std::chrono::milliseconds latencyJitter{0};
+        // Share of requests answered with 500
+        double errorRate = 0.0;
+        // Share of requests whose connection is closed without a reply
+        double dropRate = 0.0;
+        CloseMode closeMode = CloseMode::Close;
+        // Without it /ParkInOutBatch gets 404, like a Central without batch support
+        bool batchSupport = true;
+        bool tls = false;
+    };
+
+    struct Counters
+    {
+        std::atomic<std::size_t> connections{0};
+        std::atomic<std::size_t> heartbeats{0};
+        std::atomic<std::size_t> deviceStatuses{0};
+        std::atomic<std::size_t> parkInOuts{0};
+        std::atomic<std::size_t> parkInOutBatches{0};
+        std::atomic<std::size_t> errors{0};
+        std::atomic<std::size_t> drops{0};
+        std::atomic<std::size_t> notFound{0};
+        std::atomic<std::size_t> bytesReceived{0};
+        std::atomic<std::size_t> compressedRequests{0};
+        // Size of the compressed bodies once inflated
+        std::atomic<std::size_t> bytesInflated{0};
+        std::atomic<std::size_t> tlsHandshakes{0};
+        std::atomic<std::size_t> tlsResumed{0};
+    };
+
+    MockCentral(boost::asio::io_context& io_context, const boost::asio::ip::tcp::endpoint& endpoint, const Options& options);
+
+    void FnStart();
+    void FnStop();
+    unsigned short FnGetPort() const;
+    const Counters& FnGetCounters() const;
+    // Certificate of the TLS mock, empty without tls
+    const std::string& FnGetCertificatePem() const;
+
+private:
+    template <typename Stream>
+    class Session;
+
+    // Dice for error and drop decisions, shared by the sessions of this mock
+    enum class Outcome
+    {
+        Reply,
+        Error,
+        Drop
+    };
+
+    Outcome rollOutcome();
+    std::chrono::milliseconds rollLatency();
+    void doAccept();
+
+    boost::asio::io_context& io_context_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    Options options_;
+    std::unique_ptr<boost::asio::ssl::context> tlsContext_;
+    std::string certificatePem_;
+    Counters counters_;
+    std::mutex randomMutex_;
+    std::mt19937 random_;
+};
@@ -0,0 +1,79 @@
+// Standalone mock Central server.
+// Point centralIP / centralServerPort in configuration.ini at it to run the
+// application without the real Central. Prints request counters every 5 s.
+// With tls the certificate is printed at startup, save it as tlsCaFile.
+//
+// Usage: mock_central [port] [latency_ms] [jitter_ms] [error_rate] [drop_rate] [close|keepalive] [address] [batch|nobatch] [http|tls]
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include "mock_central.h"
+
+int main(int argc, char* argv[])
+{
+    unsigned short port = static_cast<unsigned short>((argc > 1) ? std::atoi(argv[1]) : 8080);
+
+    MockCentral::Options options;
+    options.latency = std::chrono::milliseconds((argc > 2) ? std::atoi(argv[2]) : 0);
+    options.latencyJitter = std::chrono::milliseconds((argc > 3) ? std::atoi(argv[3]) : 0);
+    options.errorRate = (argc > 4) ? std::atof(argv[4]) : 0.0;
+    options.dropRate = (argc > 5) ? std::atof(argv[5]) : 0.0;
+    options.closeMode = ((argc > 6) && (std::strcmp(argv[6], "keepalive") == 0)) ? MockCentral::CloseMode::KeepAlive : MockCentral::CloseMode::Close;
+    std::string address = (argc > 7) ? argv[7] : "127.0.0.1";
+    options.batchSupport = !((argc > 8) && (std::strcmp(argv[8], "nobatch") == 0));
+    options.tls = (argc > 9) && (std::strcmp(argv[9], "tls") == 0);
+
+    boost::asio::io_context io_context;
+    MockCentral mock(io_context, {boost::asio::ip::make_address(address), port}, options);
+    mock.FnStart();
+
+    std::cout << "mock Central listening on " << address << ":" << mock.FnGetPort()
+              << ", latency " << options.latency.count() << "+" << options.latencyJitter.count() << " ms"
+              << ", error rate " << options.errorRate << ", drop rate " << options.dropRate
+              << ", " << ((options.closeMode == MockCentral::CloseMode::KeepAlive) ? "keepalive" : "close")
+              << ", " << (options.batchSupport ? "batch" : "nobatch")
+              << ", " << (options.tls ? "tls" : "http") << std::endl;
+    if (options.tls)
+    {
+        std::cout << mock.FnGetCertificatePem() << std::flush;
+    }
+
+    boost::asio::steady_timer reportTimer(io_context);
+    std::function<void()> scheduleReport = [&]() {
+        reportTimer.expires_after(std::chrono::seconds(5));
+        reportTimer.async_wait([&](const boost::system::error_code& ec) {
+            if (ec)
+            {
+                return;
+            }
+            const MockCentral::Counters& counters = mock.FnGetCounters();
+            std::cout << "connections " << counters.connections
+                      << ", heartbeat " << counters.heartbeats
+                      << ", device status " << counters.deviceStatuses
+                      << ", park in/out " << counters.parkInOuts
+                      << " (" << counters.parkInOutBatches << " batches)"
+                      << ", errors " << counters.errors
+                      << ", drops " << counters.drops
+                      << ", bytes " << counters.bytesReceived
+                      << ", compressed " << counters.compressedRequests
+                      << ", tls handshakes " << counters.tlsHandshakes
+                      << " (" << counters.tlsResumed << " resumed)" << std::endl;
+            scheduleReport();
+        });
+    };
+    scheduleReport();
+
+    boost::asio::signal_set signals(io_context, SIGINT, SIGTERM);
+    signals.async_wait([&](const boost::system::error_code&, int) {
+        mock.FnStop();
+        reportTimer.cancel();
+    });
+
+    io_context.run();
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Contention benchmark for service access.
+// Compares the old "lock_guard on every getInstance()" pattern against
+// Logger::getInstance() on ServiceInstance<T> and against the logger pointer
+// of a ServiceContext, the way the components handed one read it.
+//
+// Usage: singleton_contention_bench [iterations_per_thread] [max_threads]
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../log.h"
+#include "../service.h"
+#include "bench_support.h"
+
+namespace
+{
+
+class DummyService
+{
+};
+
+class MutexSingleton
+{
+public:
+    static DummyService* getInstance()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (instance_ == nullptr)
+        {
+            instance_ = new DummyService();
+        }
+        return instance_;
+    }
+
+private:
+    static DummyService* instance_;
+    static std::mutex mutex_;
+};
+
+DummyService* MutexSingleton::instance_ = nullptr;
+std::mutex MutexSingleton::mutex_;
+
+Logger* loggerGetInstance()
+{
+    return Logger::getInstance();
+}
+
+double run(std::size_t threads, std::size_t iterations, const std::function<const void*()>& access)
+{
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+
+    for (std::size_t t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&]() {
+            // Keeps the accesses from being optimised away without a shared
+            // counter adding contention of its own
+            const void* volatile sink = nullptr;
+            while (!go.load(std::memory_order_acquire))
+            {
+            }
+            for (std::size_t i = 0; i < iterations; i++)
+            {
+                sink = access();
+            }
+            (void)sink;
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(iterations * threads);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t iterations = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+    std::size_t maxThreads = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 6;
+
+    ServiceContext services;
+    services.logger = Logger::getInstance();
+
+    std::cout << std::left << std::setw(10) << "threads"
+              << std::setw(20) << "mutex ns/op"
+              << std::setw(20) << "instance ns/op"
+              << std::setw(20) << "context ns/op" << std::endl;
+
+    for (std::size_t threads = 1; threads <= maxThreads; threads++)
+    {
+        double mutexNs = run(threads, iterations, &MutexSingleton::getInstance);
+        double slotNs = run(threads, iterations, &loggerGetInstance);
+        // A constructed context is just a pointer read with no synchronisation.
+        double contextNs = run(threads, iterations, [&services]() { return services.logger; });
+
+        std::cout << std::left << std::setw(10) << threads
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(20) << mutexNs
+                  << std::setw(20) << slotNs
+                  << std::setw(20) << contextNs << std::endl;
+    }
+
+    return 0;
+}
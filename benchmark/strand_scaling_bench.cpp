@@ -0,0 +1,281 @@
+// Strand partitioning benchmark.
+// Runs timer completions and HTTP request/response round trips either all
+// through one shared strand (previous layout) or through one strand per
+// timer / connection (current layout), for 1..N worker threads.
+//
+// Usage: strand_scaling_bench [max_threads] [handler_work_us]
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+typedef boost::asio::strand<boost::asio::io_context::executor_type> strand_type;
+
+const std::size_t TIMER_COUNT = 64;
+const std::size_t TIMER_ROUNDS = 200;
+const std::size_t CLIENT_COUNT = 16;
+const std::size_t CLIENT_REQUESTS = 200;
+
+int handlerWorkUs = 20;
+
+// Stand-in for the work a completion handler does (logging, JSON, DB calls)
+void simulateHandlerWork()
+{
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(handlerWorkUs);
+    while (std::chrono::steady_clock::now() < until)
+    {
+    }
+}
+
+void runThreads(boost::asio::io_context& io_context, std::size_t threads)
+{
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < threads; i++)
+    {
+        workers.emplace_back([&io_context]() { io_context.run(); });
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+class RearmingTimer : public std::enable_shared_from_this<RearmingTimer>
+{
+public:
+    RearmingTimer(boost::asio::io_context& io_context, const strand_type& strand, std::atomic<std::size_t>& completions)
+        : timer_(io_context), strand_(strand), completions_(completions), rounds_(0)
+    {
+    }
+
+    void start()
+    {
+        timer_.expires_after(std::chrono::microseconds(0));
+        timer_.async_wait(boost::asio::bind_executor(strand_, [self = shared_from_this()](const boost::system::error_code& ec) {
+            if (ec)
+            {
+                return;
+            }
+            simulateHandlerWork();
+            self->completions_.fetch_add(1, std::memory_order_relaxed);
+            if (++self->rounds_ < TIMER_ROUNDS)
+            {
+                self->start();
+            }
+        }));
+    }
+
+private:
+    boost::asio::steady_timer timer_;
+    strand_type strand_;
+    std::atomic<std::size_t>& completions_;
+    std::size_t rounds_;
+};
+
+double benchTimers(std::size_t threads, bool perTimerStrand)
+{
+    boost::asio::io_context io_context(static_cast<int>(threads));
+    strand_type shared(io_context.get_executor());
+    std::atomic<std::size_t> completions{0};
+
+    for (std::size_t i = 0; i < TIMER_COUNT; i++)
+    {
+        std::make_shared<RearmingTimer>(io_context, perTimerStrand ? boost::asio::make_strand(io_context) : shared, completions)->start();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    runThreads(io_context, threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return completions.load() / seconds;
+}
+
+// Minimal keep-alive HTTP server answering every request with 200
+class ServerSession : public std::enable_shared_from_this<ServerSession>
+{
+public:
+    explicit ServerSession(boost::asio::ip::tcp::socket&& socket)
+        : stream_(std::move(socket))
+    {
+    }
+
+    void do_read()
+    {
+        req_ = {};
+        boost::beast::http::async_read(stream_, buffer_, req_,
+                                    [self = shared_from_this()](boost::beast::error_code ec, std::size_t) {
+            if (ec)
+            {
+                return;
+            }
+            self->res_ = {};
+            self->res_.result(boost::beast::http::status::ok);
+            self->res_.version(self->req_.version());
+            self->res_.keep_alive(true);
+            self->res_.body() = R"({"code": "0", "msg": "success"})";
+            self->res_.prepare_payload();
+            boost::beast::http::async_write(self->stream_, self->res_,
+                                        [self](boost::beast::error_code ec, std::size_t) {
+                if (!ec)
+                {
+                    self->do_read();
+                }
+            });
+        });
+    }
+
+private:
+    boost::beast::tcp_stream stream_;
+    boost::beast::flat_buffer buffer_;
+    boost::beast::http::request<boost::beast::http::string_body> req_;
+    boost::beast::http::response<boost::beast::http::string_body> res_;
+};
+
+void doAccept(boost::asio::ip::tcp::acceptor& acceptor)
+{
+    acceptor.async_accept([&acceptor](boost::beast::error_code ec, boost::asio::ip::tcp::socket socket) {
+        if (!ec)
+        {
+            std::make_shared<ServerSession>(std::move(socket))->do_read();
+            doAccept(acceptor);
+        }
+    });
+}
+
+class Client : public std::enable_shared_from_this<Client>
+{
+public:
+    Client(const strand_type& strand, boost::asio::ip::tcp::endpoint endpoint, std::atomic<std::size_t>& completions)
+        : stream_(strand), endpoint_(endpoint), completions_(completions), requests_(0)
+    {
+    }
+
+    void start()
+    {
+        stream_.async_connect(endpoint_, [self = shared_from_this()](boost::beast::error_code ec) {
+            if (!ec)
+            {
+                self->do_write();
+            }
+        });
+    }
+
+private:
+    boost::beast::tcp_stream stream_;
+    boost::asio::ip::tcp::endpoint endpoint_;
+    boost::beast::flat_buffer buffer_;
+    boost::beast::http::request<boost::beast::http::string_body> req_;
+    boost::beast::http::response<boost::beast::http::string_body> res_;
+    std::atomic<std::size_t>& completions_;
+    std::size_t requests_;
+
+    void do_write()
+    {
+        req_ = {};
+        req_.version(11);
+        req_.method(boost::beast::http::verb::post);
+        req_.target("/HeartBeat");
+        req_.set(boost::beast::http::field::content_type, "application/json");
+        req_.body() = R"({"username":"testuser","password":"testpassword","carpark_code":"OGS"})";
+        req_.prepare_payload();
+
+        boost::beast::http::async_write(stream_, req_, [self = shared_from_this()](boost::beast::error_code ec, std::size_t) {
+            if (ec)
+            {
+                return;
+            }
+            self->res_ = {};
+            boost::beast::http::async_read(self->stream_, self->buffer_, self->res_,
+                                        [self](boost::beast::error_code ec, std::size_t) {
+                if (ec)
+                {
+                    return;
+                }
+                simulateHandlerWork();
+                self->completions_.fetch_add(1, std::memory_order_relaxed);
+                if (++self->requests_ < CLIENT_REQUESTS)
+                {
+                    self->do_write();
+                }
+                else
+                {
+                    boost::beast::error_code ignored;
+                    self->stream_.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+                }
+            });
+        });
+    }
+};
+
+double benchHttp(std::size_t threads, bool perConnectionStrand)
+{
+    // Server on its own context and threads so only the client side is measured
+    boost::asio::io_context serverContext;
+    boost::asio::ip::tcp::acceptor acceptor(serverContext, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    doAccept(acceptor);
+    auto serverGuard = boost::asio::make_work_guard(serverContext);
+    std::vector<std::thread> serverThreads;
+    for (int i = 0; i < 2; i++)
+    {
+        serverThreads.emplace_back([&serverContext]() { serverContext.run(); });
+    }
+
+    boost::asio::io_context io_context(static_cast<int>(threads));
+    strand_type shared(io_context.get_executor());
+    std::atomic<std::size_t> completions{0};
+
+    for (std::size_t i = 0; i < CLIENT_COUNT; i++)
+    {
+        std::make_shared<Client>(perConnectionStrand ? boost::asio::make_strand(io_context) : shared, acceptor.local_endpoint(), completions)->start();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    runThreads(io_context, threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    serverGuard.reset();
+    serverContext.stop();
+    for (auto& thread : serverThreads)
+    {
+        thread.join();
+    }
+
+    return completions.load() / seconds;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t maxThreads = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 6;
+    handlerWorkUs = (argc > 2) ? std::atoi(argv[2]) : 20;
+
+    std::cout << "handler work: " << handlerWorkUs << " us, completions/sec" << std::endl;
+    std::cout << std::left << std::setw(10) << "threads"
+              << std::setw(18) << "timer shared"
+              << std::setw(18) << "timer per-lot"
+              << std::setw(18) << "http shared"
+              << std::setw(18) << "http per-conn" << std::endl;
+
+    for (std::size_t threads = 1; threads <= maxThreads; threads++)
+    {
+        std::cout << std::left << std::setw(10) << threads << std::fixed << std::setprecision(0)
+                  << std::setw(18) << benchTimers(threads, false)
+                  << std::setw(18) << benchTimers(threads, true)
+                  << std::setw(18) << benchHttp(threads, false)
+                  << std::setw(18) << benchHttp(threads, true) << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+// Central TLS connection cost benchmark.
+// Sends heartbeat sized POSTs one at a time to loopback MockCentrals through
+// coroutineHttpClient and compares, per request, the latency and the CPU
+// time of the client thread for:
+//   http        a new TCP connection per request, what Central does today
+//   tls-full    a new TLS connection per request, full handshake every time
+//   tls-resume  a new TLS connection per request, resuming the last session
+//   tls-pooled  TLS with keep-alive, connections reused from the pool
+// The mock certificate is made at startup and trusted by the client, so the
+// peer verification cost is included.
+//
+// Usage: tls_handshake_bench [requests] [tls12|tls13]
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../central_client.h"
+#include "bench_support.h"
+#include "mock_central.h"
+
+namespace
+{
+
+const char* HEARTBEAT_BODY = R"({"username":"EVHogging","password":"123","carpark_code":"OGS","heartbeat_dt":"2024-04-11 21:32:51"})";
+
+const std::vector<reportColumn> COLUMNS = {
+    {"req/s", 9, 1}, {"p50 us", 9, 1}, {"p99 us", 9, 1}, {"cpu us", 10, 1}, {"connects", 9, 0},
+    {"reused", 8, 0}, {"hshake", 8, 0}, {"resumed", 8, 0}, {"failed", 8, 0}};
+
+struct Result
+{
+    sequentialResult requests;
+    double wallSeconds = 0;
+    double clientCpuSeconds = 0;
+    std::size_t connects = 0;
+    std::size_t reusedConnections = 0;
+    std::size_t tlsHandshakes = 0;
+    std::size_t tlsResumed = 0;
+};
+
+double threadCpuSeconds()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The client io_context runs on this thread, so its CPU time is the
+// client's alone. The mocks run on their own thread.
+Result runClient(int requests, unsigned short port, const centralRequestPolicy& policy, std::shared_ptr<boost::asio::ssl::context> tlsContext)
+{
+    Result result;
+    std::shared_ptr<coroutineHttpClient> client;
+    const std::string portString = std::to_string(port);
+    auto send = [&](boost::asio::io_context& ioc, auto onDone) {
+        if (!client)
+        {
+            client = std::make_shared<coroutineHttpClient>(ioc, tlsContext);
+        }
+        client->post("127.0.0.1", portString, "/HeartBeat", HEARTBEAT_BODY, policy, onDone);
+    };
+    result.requests = runSequentialRequests(requests, send, [&result](boost::asio::io_context& ioc) {
+        double cpuStart = threadCpuSeconds();
+        auto wallStart = std::chrono::steady_clock::now();
+        ioc.run();
+        result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        result.clientCpuSeconds = threadCpuSeconds() - cpuStart;
+    });
+    const centralConnectionStats& stats = client->connectionStats();
+    result.connects = stats.connects;
+    result.reusedConnections = stats.reusedConnections;
+    result.tlsHandshakes = stats.tlsHandshakes;
+    result.tlsResumed = stats.tlsResumed;
+    return result;
+}
+
+void report(const std::string& name, int requests, const Result& result)
+{
+    printReportRow(name, COLUMNS, {requests / result.wallSeconds,
+                                   percentile(result.requests.latencyUs, 0.50),
+                                   percentile(result.requests.latencyUs, 0.99),
+                                   result.clientCpuSeconds * 1e6 / requests,
+                                   static_cast<double>(result.connects),
+                                   static_cast<double>(result.reusedConnections),
+                                   static_cast<double>(result.tlsHandshakes),
+                                   static_cast<double>(result.tlsResumed),
+                                   static_cast<double>(result.requests.failures)});
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int requests = (argc > 1) ? std::max(1, std::atoi(argv[1])) : 2000;
+    bool tls12 = (argc > 2) && (std::strcmp(argv[2], "tls12") == 0);
+
+    boost::asio::io_context mockIoContext;
+    const boost::asio::ip::tcp::endpoint loopback(boost::asio::ip::make_address("127.0.0.1"), 0);
+
+    MockCentral::Options plainOptions;
+    MockCentral plainMock(mockIoContext, loopback, plainOptions);
+
+    MockCentral::Options tlsOptions;
+    tlsOptions.tls = true;
+    MockCentral tlsMock(mockIoContext, loopback, tlsOptions);
+
+    MockCentral::Options keepAliveOptions = tlsOptions;
+    keepAliveOptions.closeMode = MockCentral::CloseMode::KeepAlive;
+    MockCentral keepAliveMock(mockIoContext, loopback, keepAliveOptions);
+
+    plainMock.FnStart();
+    tlsMock.FnStart();
+    keepAliveMock.FnStart();
+    std::thread mockThread([&mockIoContext]() { mockIoContext.run(); });
+
+    // Trust both mock certificates, as Central trusts tlsCaFile
+    auto tlsContext = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tls_client);
+    tlsContext->add_certificate_authority(boost::asio::buffer(tlsMock.FnGetCertificatePem()));
+    tlsContext->add_certificate_authority(boost::asio::buffer(keepAliveMock.FnGetCertificatePem()));
+    tlsContext->set_verify_mode(boost::asio::ssl::verify_peer);
+    SSL_CTX_set_max_proto_version(tlsContext->native_handle(), tls12 ? TLS1_2_VERSION : TLS1_3_VERSION);
+
+    centralRequestPolicy policy;
+    policy.maxAttempts = 1;
+
+    std::cout << "requests " << requests << ", " << (tls12 ? "TLS 1.2" : "TLS 1.3") << "\n";
+    printReportHeader("mode", COLUMNS);
+
+    report("http", requests, runClient(requests, plainMock.FnGetPort(), policy, nullptr));
+
+    centralRequestPolicy tlsPolicy = policy;
+    tlsPolicy.tls = true;
+    tlsPolicy.tlsSessionResumption = false;
+    report("tls-full", requests, runClient(requests, tlsMock.FnGetPort(), tlsPolicy, tlsContext));
+
+    tlsPolicy.tlsSessionResumption = true;
+    report("tls-resume", requests, runClient(requests, tlsMock.FnGetPort(), tlsPolicy, tlsContext));
+
+    tlsPolicy.keepAlive = true;
+    report("tls-pooled", requests, runClient(requests, keepAliveMock.FnGetPort(), tlsPolicy, tlsContext));
+
+    const MockCentral::Counters& tlsCounters = tlsMock.FnGetCounters();
+    const MockCentral::Counters& keepAliveCounters = keepAliveMock.FnGetCounters();
+    std::cout << "mock saw " << tlsCounters.tlsHandshakes + keepAliveCounters.tlsHandshakes << " handshakes, "
+              << tlsCounters.tlsResumed + keepAliveCounters.tlsResumed << " resumed\n";
+
+    plainMock.FnStop();
+    tlsMock.FnStop();
+    keepAliveMock.FnStop();
+    mockIoContext.stop();
+    mockThread.join();
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+// Database write journal benchmark.
+// Appends park in/out INSERT statements to a WriteJournal, as MariaDB does
+// while the database is unavailable, then reopens the file (the recovery
+// scan after a restart) and drains it the way the replayer does. A torn
+// last record is simulated to show recovery stops at the last whole one.
+//
+// Usage: write_journal_bench [records] [journal file]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../write_journal.h"
+
+namespace
+{
+
+std::string insertStatement(std::size_t i)
+{
+    return "INSERT INTO tbl_ev_lot_trans (location_code, lot_no, lpn, lot_in_image, lot_out_image, lot_in_dt, lot_out_dt, add_dt, update_dt,"
+           " lot_in_central_sent_dt, lot_out_central_sent_dt, idempotency_key) VALUES ('OGS', '165', 'SNN4019G',"
+           " '/home/root/ev_charging_hogging/images/Img_240411_213251.jpg', NULL, '2024-04-11 21:32:51', NULL,"
+           " '2024-04-11 21:32:51', NULL, NULL, NULL, '5f0c2a9e1b7d4e63-" + std::to_string(i) + "') ON DUPLICATE KEY UPDATE id = id";
+}
+
+double elapsedUs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t records = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    std::string path = (argc > 2) ? argv[2] : "/tmp/write_journal_bench.bin";
+    std::remove(path.c_str());
+
+    std::vector<std::string> statements;
+    statements.reserve(records);
+    for (std::size_t i = 0; i < records; i++)
+    {
+        statements.push_back(insertStatement(i));
+    }
+
+    std::size_t capacity = 0;
+    for (const std::string& statement : statements)
+    {
+        capacity += statement.size() + 24;
+    }
+    capacity += 4096;
+
+    std::cout << std::fixed << std::setprecision(2);
+
+    WriteJournal journal;
+    if (!journal.FnOpen(path, capacity))
+    {
+        std::cerr << "Failed to open " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string& statement : statements)
+    {
+        if (!journal.FnAppend(statement))
+        {
+            std::cerr << "Journal full" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    double appendUs = elapsedUs(start);
+    std::size_t usedBytes = journal.FnGetUsedBytes();
+    std::cout << "append   " << records << " records, " << usedBytes / 1048576.0 << " MiB, "
+              << appendUs / records << " us/record, " << records / (appendUs / 1e6) << " records/s\n";
+    journal.FnClose();
+
+    // Tear the last record, as a power cut in the middle of a write would
+    int fd = ::open(path.c_str(), O_RDWR);
+    char garbage = 0x5A;
+    if ((fd < 0) || (::pwrite(fd, &garbage, 1, static_cast<off_t>(64 + usedBytes - 8)) != 1))
+    {
+        std::cerr << "Failed to tear the last record" << std::endl;
+        return EXIT_FAILURE;
+    }
+    ::close(fd);
+
+    start = std::chrono::steady_clock::now();
+    if (!journal.FnOpen(path, capacity))
+    {
+        std::cerr << "Failed to reopen " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+    double recoverUs = elapsedUs(start);
+    std::cout << "recover  " << journal.FnGetPendingCount() << " of " << records << " records valid after the torn write, "
+              << recoverUs / 1000 << " ms\n";
+
+    std::size_t drained = 0;
+    std::size_t mismatches = 0;
+    start = std::chrono::steady_clock::now();
+    while (!journal.FnIsEmpty())
+    {
+        std::vector<std::string> batch = journal.FnPeek(200);
+        for (const std::string& statement : batch)
+        {
+            if (statement != statements[drained])
+            {
+                mismatches++;
+            }
+            drained++;
+        }
+        journal.FnConsume(batch.size());
+    }
+    double drainUs = elapsedUs(start);
+    std::cout << "drain    " << drained << " records in batches of 200, " << drainUs / drained << " us/record, "
+              << mismatches << " mismatches\n";
+
+    journal.FnClose();
+    std::remove(path.c_str());
+    return (mismatches == 0) && (drained == records - 1) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
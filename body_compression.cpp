@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <zlib.h>
+#include "body_compression.h"
+
+namespace
+{
+
+int deflateWindowBits(contentEncoding encoding)
+{
+    // +16 selects the gzip wrapper instead of the zlib one
+    return (encoding == contentEncoding::Gzip) ? (MAX_WBITS + 16) : MAX_WBITS;
+}
+
+struct deflateState
+{
+    z_stream stream{};
+    bool initialized = false;
+    contentEncoding encoding = contentEncoding::Identity;
+    int level = 0;
+    compressionStrategy strategy = compressionStrategy::Default;
+
+    ~deflateState()
+    {
+        if (initialized)
+        {
+            deflateEnd(&stream);
+        }
+    }
+
+    bool prepare(contentEncoding newEncoding, int newLevel, compressionStrategy newStrategy)
+    {
+        if (initialized && (encoding == newEncoding) && (level == newLevel) && (strategy == newStrategy))
+        {
+            return deflateReset(&stream) == Z_OK;
+        }
+
+        if (initialized)
+        {
+            deflateEnd(&stream);
+            initialized = false;
+        }
+
+        stream = z_stream{};
+        int zStrategy = (newStrategy == compressionStrategy::HuffmanOnly) ? Z_HUFFMAN_ONLY : Z_DEFAULT_STRATEGY;
+        if (deflateInit2(&stream, newLevel, Z_DEFLATED, deflateWindowBits(newEncoding), 8, zStrategy) != Z_OK)
+        {
+            return false;
+        }
+        initialized = true;
+        encoding = newEncoding;
+        level = newLevel;
+        strategy = newStrategy;
+        return true;
+    }
+};
+
+struct inflateState
+{
+    z_stream stream{};
+    bool initialized = false;
+
+    ~inflateState()
+    {
+        if (initialized)
+        {
+            inflateEnd(&stream);
+        }
+    }
+
+    bool prepare()
+    {
+        if (initialized)
+        {
+            return inflateReset(&stream) == Z_OK;
+        }
+
+        stream = z_stream{};
+        // +32 accepts both the gzip and the zlib wrapper
+        if (inflateInit2(&stream, MAX_WBITS + 32) != Z_OK)
+        {
+            return false;
+        }
+        initialized = true;
+        return true;
+    }
+};
+
+}
+
+contentEncoding BodyCompressor::FnParseEncoding(const std::string& name)
+{
+    if (name == "gzip")
+    {
+        return contentEncoding::Gzip;
+    }
+    if (name == "deflate")
+    {
+        return contentEncoding::Deflate;
+    }
+    return contentEncoding::Identity;
+}
+
+const char* BodyCompressor::FnGetEncodingName(contentEncoding encoding)
+{
+    switch (encoding)
+    {
+        case contentEncoding::Gzip:
+            return "gzip";
+        case contentEncoding::Deflate:
+            return "deflate";
+        default:
+            return "";
+    }
+}
+
+compressionStrategy BodyCompressor::FnParseStrategy(const std::string& name)
+{
+    return (name == "huffman") ? compressionStrategy::HuffmanOnly : compressionStrategy::Default;
+}
+
+bool BodyCompressor::FnCompress(contentEncoding encoding, int level, compressionStrategy strategy, std::string_view in, std::string& out)
+{
+    thread_local deflateState state;
+
+    if ((encoding == contentEncoding::Identity) || !state.prepare(encoding, std::clamp(level, 1, 9), strategy))
+    {
+        return false;
+    }
+
+    z_stream& stream = state.stream;
+    out.resize(deflateBound(&stream, static_cast<uLong>(in.size())));
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+
+    // The output is sized to deflateBound, one call finishes the stream
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+    {
+        out.clear();
+        return false;
+    }
+
+    out.resize(stream.total_out);
+    return true;
+}
+
+bool BodyCompressor::FnDecompress(contentEncoding encoding, std::string_view in, std::string& out)
+{
+    thread_local inflateState state;
+
+    out.clear();
+    if ((encoding == contentEncoding::Identity) || !state.prepare())
+    {
+        return false;
+    }
+
+    z_stream& stream = state.stream;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+
+    std::size_t chunk = std::max<std::size_t>(in.size() * 2, 4096);
+    for (;;)
+    {
+        std::size_t used = out.size();
+        out.resize(used + chunk);
+        stream.next_out = reinterpret_cast<Bytef*>(&out[used]);
+        stream.avail_out = static_cast<uInt>(chunk);
+
+        int ret = inflate(&stream, Z_NO_FLUSH);
+        out.resize(used + chunk - stream.avail_out);
+
+        if (ret == Z_STREAM_END)
+        {
+            return true;
+        }
+        // Out of input with room left means a truncated body
+        if ((ret != Z_OK) || ((stream.avail_in == 0) && (stream.avail_out != 0)))
+        {
+            out.clear();
+            return false;
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+enum class contentEncoding
+{
+    Identity,
+    Gzip,
+    Deflate     // zlib format, as HTTP "deflate" is defined
+};
+
+enum class compressionStrategy
+{
+    Default,
+    // Entropy coding only, no match search. Base64 image data has no
+    // repeats to find, this keeps the 6-of-8-bit saving at a fraction of the CPU.
+    HuffmanOnly
+};
+
+/*
+ * zlib compression of HTTP bodies.
+ * Every thread keeps its own deflate and inflate streams and resets them per
+ * body, so the ~256 KiB of zlib state is allocated once per thread and level
+ * rather than per request.
+ */
+class BodyCompressor
+{
+public:
+    // "gzip" or "deflate", anything else is Identity
+    static contentEncoding FnParseEncoding(const std::string& name);
+    // Content-Encoding header value, empty for Identity
+    static const char* FnGetEncodingName(contentEncoding encoding);
+    // "huffman", anything else is Default
+    static compressionStrategy FnParseStrategy(const std::string& name);
+
+    /*
+     * Replace out with the compressed form of in. Level is the zlib level,
+     * 1 (fastest) to 9 (smallest). Returns false if zlib fails.
+     */
+    static bool FnCompress(contentEncoding encoding, int level, compressionStrategy strategy, std::string_view in, std::string& out);
+
+    // Replace out with the decompressed form of in, false if in is not valid
+    static bool FnDecompress(contentEncoding encoding, std::string_view in, std::string& out);
+};
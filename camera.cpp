@@ -3,8 +3,7 @@
 #include <mutex>
 #include "camera.h"
 
-CameraServer* CameraServer::cameraServer_ = nullptr;
-std::mutex CameraServer::mutex_;
+ServiceInstance<CameraServer> CameraServer::instance_;
 
 CameraServer::CameraServer()
 {
@@ -13,19 +12,20 @@ CameraServer::CameraServer()
 
 CameraServer* CameraServer::getInstance()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-
-    if (cameraServer_ == nullptr)
-    {
-        cameraServer_ = new CameraServer();
-    }
-    return cameraServer_;
+    return instance_.get([]() { return new CameraServer(); });
 }
 
-void CameraServer::FnCameraServerInitialization(boost::asio::io_context& io_context, const std::string& address, unsigned short port)
+void CameraServer::FnCameraServerInitialization(const std::vector<boost::asio::io_context*>& io_contexts, const std::string& address, unsigned short port)
 {
     auto const address_ = boost::asio::ip::make_address(address);
 
-    pCameraServer_ = std::make_shared<listener>(io_context, boost::asio::ip::tcp::endpoint{address_, port});
-    pCameraServer_->run();
+    // One acceptor per io_context, sharing the port when there is more than one
+    bool reusePort = (io_contexts.size() > 1);
+
+    for (boost::asio::io_context* io_context : io_contexts)
+    {
+        auto server = std::make_shared<listener>(*io_context, boost::asio::ip::tcp::endpoint{address_, port}, reusePort);
+        server->run();
+        cameraServers_.push_back(server);
+    }
 }
\ No newline at end of file
@@ -7,15 +7,25 @@
 #include <boost/asio/strand.hpp>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <vector>
+#include "handler_allocator.h"
 #include "log.h"
+#include "service.h"
+
+// Sessions keep the concrete strand type instead of the type-erased
+// any_io_executor, copying that one allocates on every composed operation
+typedef boost::asio::strand<boost::asio::io_context::executor_type> session_strand;
+typedef boost::asio::ip::tcp::socket::rebind_executor<session_strand>::other session_socket;
+typedef boost::beast::basic_stream<boost::asio::ip::tcp, session_strand> session_stream;
 
 // Handles an HTTP server connection
 class session : public std::enable_shared_from_this<session>
 {
 public:
     // Take ownership of the stream
-    session(boost::asio::ip::tcp::socket&& socket)
+    session(session_socket&& socket)
         : stream_(std::move(socket))
     {
 
@@ -38,16 +48,20 @@ public:
     {
         // Make the request empty before reading,
         // otherwise the operation behavior is undefined.
-        req_ = {};
+        // Clearing instead of reassigning keeps the body capacity for the
+        // next request on this connection.
+        req_.clear();
+        req_.body().clear();
 
         // Set the timeout.
         stream_.expires_after(std::chrono::seconds(30));
 
         // Read a request
         boost::beast::http::async_read(stream_, buffer_, req_,
-                            boost::beast::bind_front_handler(
-                                &session::on_read,
-                                shared_from_this()));
+                            make_custom_alloc_handler(handlerMemory_,
+                                boost::beast::bind_front_handler(
+                                    &session::on_read,
+                                    shared_from_this())));
     }
 
     void on_read(boost::beast::error_code ec, std::size_t bytes_transferred)
@@ -68,7 +82,8 @@ public:
             return;
         }
 
-        res_ = {};
+        res_.clear();
+        res_.body().clear();
 
         if (req_.method() == boost::beast::http::verb::post)
         {
@@ -125,10 +140,11 @@ public:
 
         // Write the response
         boost::beast::http::async_write(stream_, res_,
-                        boost::beast::bind_front_handler(
-                            &session::on_write,
-                            shared_from_this(),
-                            keep_alive));
+                        make_custom_alloc_handler(handlerMemory_,
+                            boost::beast::bind_front_handler(
+                                &session::on_write,
+                                shared_from_this(),
+                                keep_alive)));
     }
 
     void on_write(bool keep_alive, boost::beast::error_code ec, std::size_t bytes_transferred)
@@ -164,17 +180,22 @@ public:
     }
 
 private:
-    boost::beast::tcp_stream stream_;
+    session_stream stream_;
     boost::beast::flat_buffer buffer_;
     boost::beast::http::request<boost::beast::http::string_body> req_;
     boost::beast::http::response<boost::beast::http::string_body> res_;
+    handler_memory handlerMemory_;
 };
 
 // Accepts incoming connections and launches the sessions
 class listener : public std::enable_shared_from_this<listener>
 {
 public:
-    listener(boost::asio::io_context& io_context, boost::asio::ip::tcp::endpoint endpoint)
+    // SO_REUSEPORT lets several listeners, one per io_context, bind the same
+    // endpoint and have the kernel spread incoming connections between them
+    typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+
+    listener(boost::asio::io_context& io_context, boost::asio::ip::tcp::endpoint endpoint, bool reusePort = false)
         : io_context_(io_context),
         acceptor_(boost::asio::make_strand(io_context))
     {
@@ -200,6 +221,18 @@ public:
             return;
         }
 
+        if (reusePort)
+        {
+            acceptor_.set_option(reuse_port(true), ec);
+            if (ec)
+            {
+                std::ostringstream oss;
+                oss << "Listener set_option SO_REUSEPORT Exception :" << ec.message();
+                Logger::getInstance()->FnLog(oss.str(), "SERVER");
+                return;
+            }
+        }
+
         // Bind to the server address
         acceptor_.bind(endpoint, ec);
         if (ec)
@@ -230,17 +263,29 @@ public:
 private:
     boost::asio::io_context& io_context_;
     boost::asio::ip::tcp::acceptor acceptor_;
+    handler_memory handlerMemory_;
+
+    // Sessions are allocated from here and their memory is recycled for the
+    // next connection. Sessions end on their own strands, so it must be
+    // synchronized, and it must outlive every listener and session, so it is
+    // not a member.
+    static std::pmr::synchronized_pool_resource& session_pool()
+    {
+        static std::pmr::synchronized_pool_resource pool;
+        return pool;
+    }
 
     void do_accept()
     {
         // The new connection gets its own strand
         acceptor_.async_accept(boost::asio::make_strand(io_context_),
-                            boost::beast::bind_front_handler(
-                                &listener::on_accept,
-                                shared_from_this()));
+                            make_custom_alloc_handler(handlerMemory_,
+                                boost::beast::bind_front_handler(
+                                    &listener::on_accept,
+                                    shared_from_this())));
     }
 
-    void on_accept(boost::beast::error_code ec, boost::asio::ip::tcp::socket socket)
+    void on_accept(boost::beast::error_code ec, session_socket socket)
     {
         if (ec)
         {
@@ -251,7 +296,7 @@ private:
         else
         {
             // Create the session and run it
-            std::make_shared<session>(std::move(socket))->run();
+            std::allocate_shared<session>(std::pmr::polymorphic_allocator<session>(&session_pool()), std::move(socket))->run();
         }
 
         // Accept another connection
@@ -264,7 +309,7 @@ class CameraServer
 
 public:
     static CameraServer* getInstance();
-    void FnCameraServerInitialization(boost::asio::io_context& io_context, const std::string& address, unsigned short port);
+    void FnCameraServerInitialization(const std::vector<boost::asio::io_context*>& io_contexts, const std::string& address, unsigned short port);
 
     /*
      * Singleton CameraServer cannot be cloneable
@@ -277,9 +322,8 @@ public:
     void operator=(const CameraServer&) = delete;
 
 private:
-    static CameraServer* cameraServer_;
-    static std::mutex mutex_;
+    static ServiceInstance<CameraServer> instance_;
     CameraServer();
 
-    std::shared_ptr<listener> pCameraServer_;
+    std::vector<std::shared_ptr<listener>> cameraServers_;
 };
\ No newline at end of file
@@ -1,10 +1,13 @@
+#include <algorithm>
 #include <iostream>
 #include <boost/asio.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
-#include <boost/json/src.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
 #include <string>
 #include <sstream>
+#include <unordered_map>
 #include <vector>
 #include "central.h"
 #include "common.h"
@@ -12,36 +15,292 @@
 #include "log.h"
 
 
-Central* Central::central_ = nullptr;
-std::mutex Central::mutex_;
+ServiceInstance<Central> Central::instance_;
+
+namespace
+{
+
+// Log line of the request being sent, reused by every send on this thread
+std::string& logBuffer()
+{
+    thread_local std::string buffer;
+    buffer.assign("Request JSON Body :");
+    return buffer;
+}
+
+// Acknowledgements of a batch, {"results":[{"event_id":"1","status":"ok"},...]}.
+// Returns false if the body is not a batch acknowledgement.
+bool parseBatchAcks(const std::string& body, std::unordered_map<std::string, bool>& acks)
+{
+    try
+    {
+        boost::property_tree::ptree pt;
+        std::istringstream iss(body);
+        boost::property_tree::read_json(iss, pt);
+
+        boost::optional<boost::property_tree::ptree&> results = pt.get_child_optional("results");
+        if (!results)
+        {
+            return false;
+        }
+
+        for (const auto& result : *results)
+        {
+            acks[result.second.get<std::string>("event_id")] = (result.second.get<std::string>("status", "") == "ok");
+        }
+        return true;
+    }
+    catch (const boost::property_tree::ptree_error&)
+    {
+        return false;
+    }
+}
+
+}
 
 const std::string Central::ERROR_CODE_RECOVERED = "0";
 const std::string Central::ERROR_CODE_CAMERA = "1";
 const std::string Central::ERROR_CODE_IPC = "2";
 
 Central::Central()
-    : centralStatus_(false)
+    : centralStatus_(false),
+    pIoContext_(nullptr),
+    payloads_(nullptr),
+    batchGeneration_(0),
+    batchRejectedConfig_(nullptr),
+    nextBatchEventId_(1)
 {
-    centralServerIp_ = IniParser::getInstance()->FnGetCentralIP();
-    centralServerPort_ = IniParser::getInstance()->FnGetCentralServerPort();
+
 }
 
 Central* Central::getInstance()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    return instance_.get([]() { return new Central(); });
+}
+
+void Central::FnCentralInitialization(boost::asio::io_context& io_context)
+{
+    pIoContext_ = &io_context;
+    pCentralClient_ = std::make_shared<coroutineHttpClient>(io_context, createTlsContext(*IniParser::getInstance()->FnGetConfig()));
+    pBatchStrand_ = std::make_unique<boost::asio::strand<boost::asio::io_context::executor_type>>(io_context.get_executor());
+    pBatchTimer_ = std::make_unique<boost::asio::steady_timer>(*pBatchStrand_);
+
+    // Render the payload templates now, not on the first send
+    getPayloads(IniParser::getInstance()->FnGetConfig());
+}
+
+std::unique_ptr<const Central::centralPayloads> Central::buildPayloads(const IniConfig* config) const
+{
+    const std::string passwordPlaceholder = "******";
+
+    return std::unique_ptr<const centralPayloads>(new centralPayloads{
+        config,
+        PayloadTemplate({
+            staticPayloadField("username", USERNAME),
+            staticPayloadField("password", PASSWORD, passwordPlaceholder),
+            staticPayloadField("carpark_code", config->parkingLotLocationCode),
+            variablePayloadField("heartbeat_dt"),
+            staticPayloadField("msg", "Heartbeat Update")
+        }),
+        PayloadTemplate({
+            staticPayloadField("username", USERNAME),
+            staticPayloadField("password", PASSWORD, passwordPlaceholder),
+            staticPayloadField("carpark_code", config->parkingLotLocationCode),
+            variablePayloadField("device_ip"),
+            variablePayloadField("error_code")
+        }),
+        PayloadTemplate({
+            staticPayloadField("username", USERNAME),
+            staticPayloadField("password", PASSWORD, passwordPlaceholder),
+            staticPayloadField("carpark_code", config->parkingLotLocationCode),
+            variablePayloadField("lot_no"),
+            variablePayloadField("lpn"),
+            variablePayloadField("lot_in_image", "Lot In Image"),
+            variablePayloadField("lot_out_image", "Lot Out Image"),
+            variablePayloadField("lot_in_time"),
+            variablePayloadField("lot_out_time")
+        }),
+        PayloadTemplate({
+            variablePayloadField("event_id"),
+            variablePayloadField("lot_no"),
+            variablePayloadField("lpn"),
+            variablePayloadField("lot_in_image", "Lot In Image"),
+            variablePayloadField("lot_out_image", "Lot Out Image"),
+            variablePayloadField("lot_in_time"),
+            variablePayloadField("lot_out_time")
+        }),
+        PayloadTemplate({
+            staticPayloadField("username", USERNAME),
+            staticPayloadField("password", PASSWORD, passwordPlaceholder),
+            staticPayloadField("carpark_code", config->parkingLotLocationCode),
+            rawPayloadField("events", "Batched Events")
+        }),
+        PayloadTemplate({
+            staticPayloadField("username", USERNAME),
+            staticPayloadField("password", PASSWORD, passwordPlaceholder),
+            staticPayloadField("carpark_code", config->parkingLotLocationCode),
+            variablePayloadField("lot_no"),
+            variablePayloadField("lpn"),
+            variablePayloadField("lot_in_time"),
+            variablePayloadField("hogging_time"),
+            variablePayloadField("policy"),
+            variablePayloadField("reason")
+        })
+    });
+}
+
+const Central::centralPayloads* Central::getPayloads(const IniConfig* config)
+{
+    const centralPayloads* payloads = payloads_.load(std::memory_order_acquire);
+    if (payloads && payloads->config == config)
+    {
+        return payloads;
+    }
+
+    // First send after a configuration reload renders the templates again
+    std::lock_guard<std::mutex> lock(payloadsMutex_);
+    payloads = payloads_.load(std::memory_order_relaxed);
+    if (!payloads || payloads->config != config)
+    {
+        payloadsHistory_.push_back(buildPayloads(config));
+        payloads = payloadsHistory_.back().get();
+        payloads_.store(payloads, std::memory_order_release);
+    }
+    return payloads;
+}
+
+std::shared_ptr<boost::asio::ssl::context> Central::createTlsContext(const IniConfig& config)
+{
+    std::shared_ptr<boost::asio::ssl::context> context = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tls_client);
+
+    try
+    {
+        context->set_options(boost::asio::ssl::context::default_workarounds |
+                            boost::asio::ssl::context::no_sslv2 |
+                            boost::asio::ssl::context::no_sslv3 |
+                            boost::asio::ssl::context::no_tlsv1 |
+                            boost::asio::ssl::context::no_tlsv1_1);
+
+        if (config.centralTlsVerify)
+        {
+            context->set_verify_mode(boost::asio::ssl::verify_peer);
+            if (config.centralTlsCaFile.empty())
+            {
+                context->set_default_verify_paths();
+            }
+            else
+            {
+                context->load_verify_file(config.centralTlsCaFile);
+            }
+        }
+        else
+        {
+            context->set_verify_mode(boost::asio::ssl::verify_none);
+        }
+    }
+    catch (const boost::system::system_error& ex)
+    {
+        // Plain HTTP keeps working, TLS requests fail their handshake
+        std::ostringstream oss;
+        oss << "Central TLS context setup failed :" << ex.what();
+        Logger::getInstance()->FnLog(oss.str(), "CENTRAL");
+    }
+
+    return context;
+}
+
+centralRequestPolicy Central::requestPolicy(const IniConfig& config)
+{
+    centralRequestPolicy policy;
+    policy.connectTimeout = std::chrono::milliseconds(config.centralConnectTimeoutMs);
+    policy.writeTimeout = std::chrono::milliseconds(config.centralWriteTimeoutMs);
+    policy.readTimeout = std::chrono::milliseconds(config.centralReadTimeoutMs);
+    policy.maxAttempts = config.centralMaxAttempts;
+    policy.retryDelay = std::chrono::milliseconds(config.centralRetryDelayMs);
+    policy.compression = BodyCompressor::FnParseEncoding(config.centralCompression);
+    policy.compressionLevel = config.centralCompressionLevel;
+    policy.deflateStrategy = BodyCompressor::FnParseStrategy(config.centralCompressionStrategy);
+    policy.compressionMinBytes = static_cast<std::size_t>(std::max(config.centralCompressionMinBytes, 0));
+    policy.tls = config.centralTls;
+    policy.tlsSessionResumption = config.centralTlsSessionResumption;
+    policy.keepAlive = config.centralKeepAlive;
+    policy.keepAliveIdleTimeout = std::chrono::milliseconds(config.centralKeepAliveIdleTimeoutMs);
+    return policy;
+}
+
+circuitBreakerPolicy Central::breakerPolicy(const IniConfig& config)
+{
+    circuitBreakerPolicy policy;
+    policy.failureThreshold = config.centralCircuitFailureThreshold;
+    policy.openBaseDelay = std::chrono::milliseconds(config.centralCircuitOpenBaseMs);
+    policy.openMaxDelay = std::chrono::milliseconds(config.centralCircuitOpenMaxMs);
+    return policy;
+}
+
+void Central::postToCentral(const IniConfig* config, const std::string& target, std::string body, bool isProbe,
+                        coroutineHttpClient::response_callback_type callback)
+{
+    bool halfOpenProbe = false;
+    if (!circuitBreaker_.FnAllowRequest(isProbe, &halfOpenProbe))
+    {
+        // Reported from the io_context like a sent request, never from inside the caller
+        boost::asio::post(*pIoContext_, [callback = std::move(callback)]() {
+            centralResponse response;
+            response.ec = boost::asio::error::try_again;
+            response.msg = "Circuit Open";
+            callback(response);
+        });
+        return;
+    }
 
-    if (central_ == nullptr)
+    centralRequestPolicy policy = requestPolicy(*config);
+    if (circuitBreaker_.FnGetState() != circuitState::Closed)
     {
-        central_ = new Central();
+        // The probe answers whether Central is back, retries would only delay that
+        policy.maxAttempts = 1;
     }
-    return central_;
+
+    pCentralClient_->post(config->centralIP, std::to_string(config->centralServerPort), target, std::move(body), policy,
+                        [this, config, halfOpenProbe, callback = std::move(callback)](const centralResponse& response) {
+                            recordOutcome(config, response, halfOpenProbe);
+                            callback(response);
+                        });
 }
 
-void Central::FnCentralInitialization(boost::asio::io_context& io_context, boost::asio::strand<boost::asio::io_context::executor_type>& strand)
+void Central::recordOutcome(const IniConfig* config, const centralResponse& response, bool halfOpenProbe)
 {
-    pSendDeviceStatusSession_ = std::make_shared<httpClientSession>(io_context, strand, std::bind(&Central::onSendDeviceStatusUpdateCallbackHandler, this, std::placeholders::_1, std::placeholders::_2));
-    pSendHeartbeatSession_ = std::make_shared<httpClientSession>(io_context, strand, std::bind(&Central::onSendHeartbeatUpdateCallbackHandler, this, std::placeholders::_1, std::placeholders::_2));
-    pSendParkInParkOutSession_ = std::make_shared<httpClientSession>(io_context, strand, std::bind(&Central::onSendParkInParkOutCallbackHandler, this, std::placeholders::_1, std::placeholders::_2));
+    // Cancelled requests say nothing about Central, but a cancelled probe must not leave the circuit half-open
+    bool changed;
+    bool aborted = (response.ec == boost::asio::error::operation_aborted);
+    if (aborted)
+    {
+        changed = circuitBreaker_.FnRecordAborted(halfOpenProbe);
+    }
+    else
+    {
+        // Central answering, even with a client error, is Central being up
+        bool failed = response.ec || (response.status >= 500);
+        changed = failed ? circuitBreaker_.FnRecordFailure(breakerPolicy(*config), halfOpenProbe) : circuitBreaker_.FnRecordSuccess(halfOpenProbe);
+    }
+
+    circuitState state = circuitBreaker_.FnGetState();
+    centralStatus_.store(state == circuitState::Closed);
+
+    if (changed)
+    {
+        std::ostringstream oss;
+        oss << "Central circuit " << CircuitBreaker::FnGetStateName(state);
+        if (aborted)
+        {
+            oss << " again, probe cancelled, the next heartbeat probes";
+        }
+        else if (state == circuitState::Open)
+        {
+            oss << " after " << circuitBreaker_.FnGetConsecutiveFailures() << " consecutive failures, next heartbeat probe in "
+                << circuitBreaker_.FnGetOpenDelay().count() << " ms";
+        }
+        Logger::getInstance()->FnLog(oss.str(), "CENTRAL");
+    }
 }
 
 void Central::onSendHeartbeatUpdateCallbackHandler(boost::beast::error_code ec, const std::string& msg)
@@ -64,17 +323,16 @@ void Central::FnSendHeartbeatUpdate()
 {
     Logger::getInstance()->FnLog(__func__, "CENTRAL");
 
-    boost::json::object jsonObject;
-    jsonObject["username"] = USERNAME;
-    jsonObject["password"] = PASSWORD;
-    jsonObject["carpark_code"] = IniParser::getInstance()->FnGetParkingLotLocationCode();
-    jsonObject["heartbeat_dt"] = Common::getInstance()->FnGetDateTimeFormat_YYYY_MM_DD_HH_MM_SS();
-    jsonObject["msg"] = "Heartbeat Update";
+    // One snapshot per message, so a reload never mixes old and new values
+    const IniConfig* config = IniParser::getInstance()->FnGetConfig();
 
-    std::string body = boost::json::serialize(jsonObject);
+    std::string body;
+    std::string& logBody = logBuffer();
+    getPayloads(config)->heartbeat.FnRender({Common::getInstance()->FnGetDateTimeFormat_YYYY_MM_DD_HH_MM_SS()}, body, logBody);
 
-    Logger::getInstance()->FnLog("Request JSON Body :" + body, "CENTRAL");
-    pSendHeartbeatSession_->run(IniParser::getInstance()->FnGetCentralIP(), std::to_string(IniParser::getInstance()->FnGetCentralServerPort()), "/HeartBeat", 11, body);
+    Logger::getInstance()->FnLog(logBody, "CENTRAL");
+    postToCentral(config, "/HeartBeat", std::move(body), true,
+                [this](const centralResponse& response) { onSendHeartbeatUpdateCallbackHandler(response.ec, response.msg); });
 }
 
 void Central::onSendDeviceStatusUpdateCallbackHandler(boost::beast::error_code ec, const std::string& msg)
@@ -93,21 +351,25 @@ void Central::onSendDeviceStatusUpdateCallbackHandler(boost::beast::error_code e
     }
 }
 
-void Central::FnSendDeviceStatusUpdate(const std::string& device_ip, const std::string& error_code)
+void Central::FnSendDeviceStatusUpdate(const std::string& device_ip, const std::string& error_code, send_callback callback)
 {
     Logger::getInstance()->FnLog(__func__, "CENTRAL");
 
-    boost::json::object jsonObject;
-    jsonObject["username"] = USERNAME;
-    jsonObject["password"] = PASSWORD;
-    jsonObject["carpark_code"] = IniParser::getInstance()->FnGetParkingLotLocationCode();
-    jsonObject["device_ip"] = device_ip;
-    jsonObject["error_code"] = error_code;
+    const IniConfig* config = IniParser::getInstance()->FnGetConfig();
 
-    std::string body = boost::json::serialize(jsonObject);
+    std::string body;
+    std::string& logBody = logBuffer();
+    getPayloads(config)->deviceStatus.FnRender({device_ip, error_code}, body, logBody);
 
-    Logger::getInstance()->FnLog("Request JSON Body :" + body, "CENTRAL");
-    pSendDeviceStatusSession_->run(IniParser::getInstance()->FnGetCentralIP(), std::to_string(IniParser::getInstance()->FnGetCentralServerPort()), "/DeviceStatus", 11, body);
+    Logger::getInstance()->FnLog(logBody, "CENTRAL");
+    postToCentral(config, "/DeviceStatus", std::move(body), false,
+                [this, callback = std::move(callback)](const centralResponse& response) {
+                    onSendDeviceStatusUpdateCallbackHandler(response.ec, response.msg);
+                    if (callback)
+                    {
+                        callback(response.ec, response.msg);
+                    }
+                });
 }
 
 void Central::onSendParkInParkOutCallbackHandler(boost::beast::error_code ec, const std::string& msg)
@@ -131,40 +393,269 @@ void Central::FnSendParkInParkOutInfo(const std::string& lot_no,
                                 const std::string& lot_in_image,
                                 const std::string& lot_out_image,
                                 const std::string& lot_in_time,
-                                const std::string& lot_out_time)
+                                const std::string& lot_out_time,
+                                send_callback callback)
+{
+    Logger::getInstance()->FnLog(__func__, "CENTRAL");
+
+    const IniConfig* config = IniParser::getInstance()->FnGetConfig();
+
+    if (config->centralBatchMaxEvents <= 1)
+    {
+        sendParkInParkOut(config, lot_no, lpn, lot_in_image, lot_out_image, lot_in_time, lot_out_time, std::move(callback));
+        return;
+    }
+
+    parkInOutEvent event{std::to_string(nextBatchEventId_.fetch_add(1, std::memory_order_relaxed)),
+                        lot_no, lpn, lot_in_image, lot_out_image, lot_in_time, lot_out_time, std::move(callback)};
+    boost::asio::post(*pBatchStrand_, [this, config, event = std::move(event)]() mutable {
+        queueBatchEvent(config, event);
+    });
+}
+
+void Central::FnSendParkInParkOutInfo(const parking_lot_t& lot, send_callback callback)
+{
+    std::string lotInImage = lot.lot_in_image_path.empty() ? "" : Common::getInstance()->FnConvertImageToBase64String(lot.lot_in_image_path);
+    std::string lotOutImage = lot.lot_out_image_path.empty() ? "" : Common::getInstance()->FnConvertImageToBase64String(lot.lot_out_image_path);
+    FnSendParkInParkOutInfo(lot.lot_no.str(),
+                            lot.lpn.str(),
+                            lotInImage,
+                            lotOutImage,
+                            Common::getInstance()->FnFormatDateTime_YYYY_MM_DD_HH_MM_SS(lot.lot_in_dt),
+                            Common::getInstance()->FnFormatDateTime_YYYY_MM_DD_HH_MM_SS(lot.lot_out_dt),
+                            std::move(callback));
+}
+
+void Central::onSendHoggingEventCallbackHandler(boost::beast::error_code ec, const std::string& msg)
 {
     Logger::getInstance()->FnLog(__func__, "CENTRAL");
 
-    boost::json::object jsonObject;
-    jsonObject["username"] = USERNAME;
-    jsonObject["password"] = PASSWORD;
-    jsonObject["carpark_code"] = IniParser::getInstance()->FnGetParkingLotLocationCode();
-    jsonObject["lot_no"] = lot_no;
-    jsonObject["lpn"] = lpn;
-    jsonObject["lot_in_image"] = lot_in_image;
-    jsonObject["lot_out_image"] = lot_out_image;
-    jsonObject["lot_in_time"] = lot_in_time;
-    jsonObject["lot_out_time"] = lot_out_time;
-
-    std::string body = boost::json::serialize(jsonObject);
-
-    // For logging only
-    boost::json::object logJsonObject;
-    logJsonObject["username"] = USERNAME;
-    logJsonObject["password"] = PASSWORD;
-    logJsonObject["carpark_code"] = IniParser::getInstance()->FnGetParkingLotLocationCode();
-    logJsonObject["lot_no"] = lot_no;
-    logJsonObject["lpn"] = lpn;
-    logJsonObject["lot_in_image"] = lot_in_image.empty() ? "" : "Lot In Image";
-    logJsonObject["lot_out_image"] = lot_out_image.empty() ? "" : "Lot Out Image";
-    logJsonObject["lot_in_time"] = lot_in_time;
-    logJsonObject["lot_out_time"] = lot_out_time;
-
-    std::string logBody = boost::json::serialize(logJsonObject);
-    Logger::getInstance()->FnLog("Request JSON Body :" + logBody, "CENTRAL");
-    // End for Logging
-
-    pSendParkInParkOutSession_->run(IniParser::getInstance()->FnGetCentralIP(), std::to_string(IniParser::getInstance()->FnGetCentralServerPort()), "/ParkInOut", 11, body);
+    if (!ec)
+    {
+        Logger::getInstance()->FnLog("Send hogging event successfully.", "CENTRAL");
+    }
+    else
+    {
+        std::ostringstream oss;
+        oss << msg << " :" << ec.message();
+        Logger::getInstance()->FnLog(oss.str(), "CENTRAL");
+    }
+}
+
+void Central::FnSendHoggingEvent(const lot_hogging_t& hogging, send_callback callback)
+{
+    Logger::getInstance()->FnLog(__func__, "CENTRAL");
+
+    const IniConfig* config = IniParser::getInstance()->FnGetConfig();
+
+    std::string body;
+    std::string& logBody = logBuffer();
+    getPayloads(config)->hogging.FnRender({hogging.lot_no.str(),
+                                        hogging.lpn.str(),
+                                        Common::getInstance()->FnFormatDateTime_YYYY_MM_DD_HH_MM_SS(hogging.lot_in_dt),
+                                        Common::getInstance()->FnFormatDateTime_YYYY_MM_DD_HH_MM_SS(hogging.hogging_dt),
+                                        hogging.policy,
+                                        hoggingReasonName(hogging.reason)}, body, logBody);
+
+    Logger::getInstance()->FnLog(logBody, "CENTRAL");
+    postToCentral(config, "/HoggingEvent", std::move(body), false,
+                [this, callback = std::move(callback)](const centralResponse& response) {
+                    onSendHoggingEventCallbackHandler(response.ec, response.msg);
+                    if (callback)
+                    {
+                        callback(response.ec, response.msg);
+                    }
+                });
+}
+
+void Central::sendParkInParkOut(const IniConfig* config,
+                            const std::string& lot_no,
+                            const std::string& lpn,
+                            const std::string& lot_in_image,
+                            const std::string& lot_out_image,
+                            const std::string& lot_in_time,
+                            const std::string& lot_out_time,
+                            send_callback callback)
+{
+    // The body and its log view, with the images left out, come from one pass
+    std::string body;
+    std::string& logBody = logBuffer();
+    getPayloads(config)->parkInOut.FnRender({lot_no, lpn, lot_in_image, lot_out_image, lot_in_time, lot_out_time}, body, logBody);
+
+    Logger::getInstance()->FnLog(logBody, "CENTRAL");
+
+    postToCentral(config, "/ParkInOut", std::move(body), false,
+                [this, callback = std::move(callback)](const centralResponse& response) {
+                    onSendParkInParkOutCallbackHandler(response.ec, response.msg);
+                    if (callback)
+                    {
+                        callback(response.ec, response.msg);
+                    }
+                });
+}
+
+void Central::queueBatchEvent(const IniConfig* config, parkInOutEvent& event)
+{
+    if (batchRejectedConfig_ == config)
+    {
+        sendParkInParkOut(config, event.lot_no, event.lpn, event.lot_in_image, event.lot_out_image, event.lot_in_time, event.lot_out_time, std::move(event.callback));
+        return;
+    }
+
+    batchEvents_.push_back(std::move(event));
+
+    if (batchEvents_.size() >= static_cast<std::size_t>(config->centralBatchMaxEvents))
+    {
+        flushBatch(config);
+    }
+    else if (batchEvents_.size() == 1)
+    {
+        // The first event of a batch waits at most batchMaxDelayMs. A cancel
+        // does not stop a wait that has already completed, its handler then
+        // belongs to a batch flushed since and is ignored.
+        pBatchTimer_->expires_after(std::chrono::milliseconds(config->centralBatchMaxDelayMs));
+        pBatchTimer_->async_wait(boost::asio::bind_executor(*pBatchStrand_, [this, config, generation = batchGeneration_](const boost::system::error_code& ec) {
+            if (ec || (generation != batchGeneration_))
+            {
+                return;
+            }
+            flushBatch(config);
+        }));
+    }
+}
+
+void Central::flushBatch(const IniConfig* config)
+{
+    pBatchTimer_->cancel();
+    batchGeneration_++;
+    if (batchEvents_.empty())
+    {
+        return;
+    }
+
+    std::shared_ptr<parkInOutBatch> batch = std::make_shared<parkInOutBatch>(std::move(batchEvents_));
+    batchEvents_.clear();
+
+    if ((batch->size() == 1) || (batchRejectedConfig_ == config))
+    {
+        sendBatchEventsSingly(config, *batch);
+        return;
+    }
+
+    const centralPayloads* payloads = getPayloads(config);
+
+    std::string events = "[";
+    std::string eventsLog = "Batched Events :[";
+    for (std::size_t i = 0; i < batch->size(); i++)
+    {
+        const parkInOutEvent& event = (*batch)[i];
+        if (i > 0)
+        {
+            events += ',';
+            eventsLog += ',';
+        }
+        payloads->parkInOutEvent.FnRender({event.id, event.lot_no, event.lpn, event.lot_in_image, event.lot_out_image, event.lot_in_time, event.lot_out_time}, events, eventsLog);
+    }
+    events += ']';
+    eventsLog += ']';
+
+    std::string body;
+    std::string& logBody = logBuffer();
+    payloads->parkInOutBatch.FnRender({events}, body, logBody);
+
+    Logger::getInstance()->FnLog(logBody, "CENTRAL");
+    Logger::getInstance()->FnLog(eventsLog, "CENTRAL");
+
+    postToCentral(config, config->centralBatchTarget, std::move(body), false,
+                [this, config, batch](const centralResponse& response) {
+                    boost::asio::post(*pBatchStrand_, [this, config, batch, response]() {
+                        onSendBatchResponse(config, *batch, response);
+                    });
+                });
+}
+
+void Central::onSendBatchResponse(const IniConfig* config, parkInOutBatch& batch, const centralResponse& response)
+{
+    auto report = [this](parkInOutEvent& event, boost::beast::error_code ec, const std::string& msg) {
+        onSendParkInParkOutCallbackHandler(ec, msg);
+        if (event.callback)
+        {
+            event.callback(ec, msg);
+        }
+    };
+
+    // Central unreachable after all attempts, single sends would fail the same way
+    if (response.ec)
+    {
+        for (parkInOutEvent& event : batch)
+        {
+            report(event, response.ec, response.msg);
+        }
+        return;
+    }
+
+    // A client error or a reply without acknowledgements means Central does not take batches
+    std::unordered_map<std::string, bool> acks;
+    bool refused = ((response.status >= 400) && (response.status < 500)) || (response.status == 501);
+    if (!refused && (response.status == 200) && !parseBatchAcks(response.body, acks))
+    {
+        refused = true;
+    }
+
+    if (refused)
+    {
+        std::ostringstream oss;
+        oss << "Central refused park in park out batch, status " << response.status << ", sending events singly until the configuration is reloaded";
+        Logger::getInstance()->FnLog(oss.str(), "CENTRAL");
+
+        batchRejectedConfig_ = config;
+        sendBatchEventsSingly(config, batch);
+        return;
+    }
+
+    if (response.status != 200)
+    {
+        for (parkInOutEvent& event : batch)
+        {
+            report(event, response.ec, response.msg);
+        }
+        return;
+    }
+
+    std::size_t unacknowledged = 0;
+    for (parkInOutEvent& event : batch)
+    {
+        auto it = acks.find(event.id);
+        if (it == acks.end())
+        {
+            // Not part of the reply, the single send gets its own acknowledgement
+            unacknowledged++;
+            sendParkInParkOut(config, event.lot_no, event.lpn, event.lot_in_image, event.lot_out_image, event.lot_in_time, event.lot_out_time, std::move(event.callback));
+        }
+        else if (it->second)
+        {
+            report(event, boost::beast::error_code(), "");
+        }
+        else
+        {
+            report(event, boost::system::errc::make_error_code(boost::system::errc::bad_message), "Event Rejected");
+        }
+    }
+
+    if (unacknowledged > 0)
+    {
+        std::ostringstream oss;
+        oss << unacknowledged << " of " << batch.size() << " batched events not acknowledged, sent singly";
+        Logger::getInstance()->FnLog(oss.str(), "CENTRAL");
+    }
+}
+
+void Central::sendBatchEventsSingly(const IniConfig* config, parkInOutBatch& batch)
+{
+    for (parkInOutEvent& event : batch)
+    {
+        sendParkInParkOut(config, event.lot_no, event.lpn, event.lot_in_image, event.lot_out_image, event.lot_in_time, event.lot_out_time, std::move(event.callback));
+    }
 }
 
 void Central::FnSetCentralStatus(bool status)
@@ -7,18 +7,30 @@
 #include <boost/beast/version.hpp>
 #include <chrono>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <sstream>
+#include <vector>
+#include "central_client.h"
+#include "circuit_breaker.h"
+#include "handler_allocator.h"
+#include "ini_parser.h"
 #include "log.h"
+#include "payload_template.h"
+#include "service.h"
+#include "structure.h"
 
 class httpClientSession : public std::enable_shared_from_this<httpClientSession>
 {
 public:
-    // Objects are constructed with a strand to
-    // ensure that handlers do not execute concurrently.
-    explicit httpClientSession(boost::asio::io_context& ioc, boost::asio::strand<boost::asio::io_context::executor_type>& strand, std::function<void(boost::beast::error_code ec, const std::string& msg)> callback)
-        : resolver_(strand),
-        stream_(strand),
+    // Every session is constructed with its own strand to ensure that its
+    // handlers do not execute concurrently, while different sessions still
+    // complete in parallel on different threads.
+    explicit httpClientSession(boost::asio::io_context& ioc, std::function<void(boost::beast::error_code ec, const std::string& msg)> callback)
+        : strand_(boost::asio::make_strand(ioc)),
+        resolver_(strand_),
+        stream_(strand_),
         callback(callback)
     {
     }
@@ -37,10 +49,15 @@ public:
         req_.body() = jsonBody;
         req_.prepare_payload();
 
+        // The session is reused, start every read from an empty response
+        res_.clear();
+        res_.body().clear();
+
         // Look up the domain name
         resolver_.async_resolve(host, port, 
+                            make_custom_alloc_handler(handlerMemory_,
                             boost::beast::bind_front_handler(
-                            &httpClientSession::on_resolve, shared_from_this()));
+                                &httpClientSession::on_resolve, shared_from_this())));
     }
 
     void on_resolve(boost::beast::error_code ec, 
@@ -56,8 +73,9 @@ public:
 
         // Make the connection on the IP address we get from a lookup
         stream_.async_connect(results,
+                        make_custom_alloc_handler(handlerMemory_,
                         boost::beast::bind_front_handler(
-                        &httpClientSession::on_connect, shared_from_this()));
+                            &httpClientSession::on_connect, shared_from_this())));
     }
 
     void on_connect(boost::beast::error_code ec, boost::asio::ip::tcp::resolver::results_type::endpoint_type)
@@ -75,8 +93,9 @@ public:
 
         // Send the HTTP request to the remote host
         boost::beast::http::async_write(stream_, req_,
+                                make_custom_alloc_handler(handlerMemory_,
                                 boost::beast::bind_front_handler(
-                                &httpClientSession::on_write, shared_from_this()));
+                                    &httpClientSession::on_write, shared_from_this())));
     }
 
     void on_write(boost::beast::error_code ec, std::size_t bytes_transferred)
@@ -89,8 +108,9 @@ public:
         }
 
         boost::beast::http::async_read(stream_, buffer_, res_,
+                                make_custom_alloc_handler(handlerMemory_,
                                 boost::beast::bind_front_handler(
-                                &httpClientSession::on_read, shared_from_this()));
+                                    &httpClientSession::on_read, shared_from_this())));
     }
 
     void on_read(boost::beast::error_code ec, std::size_t bytes_transferred)
@@ -126,12 +146,18 @@ public:
     }
 
 private:
-    boost::asio::ip::tcp::resolver resolver_;
-    boost::beast::tcp_stream stream_;
+    // Concrete strand type rather than any_io_executor, copies of a
+    // type-erased strand allocate on every composed operation
+    typedef boost::asio::strand<boost::asio::io_context::executor_type> strand_type;
+
+    strand_type strand_;
+    boost::asio::ip::basic_resolver<boost::asio::ip::tcp, strand_type> resolver_;
+    boost::beast::basic_stream<boost::asio::ip::tcp, strand_type> stream_;
     boost::beast::flat_buffer buffer_; // (Must persist between reads)
     boost::beast::http::request<boost::beast::http::string_body> req_;
     boost::beast::http::response<boost::beast::http::string_body> res_;
     std::function<void(boost::beast::error_code ec, const std::string& msg)> callback;
+    handler_memory handlerMemory_;
 };
 
 
@@ -143,20 +169,27 @@ public:
     static const std::string ERROR_CODE_CAMERA;
     static const std::string ERROR_CODE_IPC;
 
+    // Outcome of one send, reported after Central's own handling of it
+    typedef std::function<void(boost::beast::error_code ec, const std::string& msg)> send_callback;
+
     const std::string USERNAME = "testuser";
     const std::string PASSWORD = "testpassword";
 
     static Central* getInstance();
 
-    void FnCentralInitialization(boost::asio::io_context& io_context, boost::asio::strand<boost::asio::io_context::executor_type>& strand);
+    void FnCentralInitialization(boost::asio::io_context& io_context);
     void FnSendHeartbeatUpdate();
-    void FnSendDeviceStatusUpdate(const std::string& device_ip, const std::string& error_code);
+    void FnSendDeviceStatusUpdate(const std::string& device_ip, const std::string& error_code, send_callback callback = nullptr);
     void FnSendParkInParkOutInfo(const std::string& lot_no,
                                 const std::string& lpn,
                                 const std::string& lot_in_image,
                                 const std::string& lot_out_image,
                                 const std::string& lot_in_time,
-                                const std::string& lot_out_time);
+                                const std::string& lot_out_time,
+                                send_callback callback = nullptr);
+    // Park record as sent to Central, its images read and base64 encoded
+    void FnSendParkInParkOutInfo(const parking_lot_t& lot, send_callback callback = nullptr);
+    void FnSendHoggingEvent(const lot_hogging_t& hogging, send_callback callback = nullptr);
 
     void FnSetCentralStatus(bool status);
     bool FnGetCentralStatus();
@@ -172,17 +205,83 @@ public:
     void operator=(const Central &) = delete;
 
 private:
-    static Central* central_;
-    static std::mutex mutex_;
+    static ServiceInstance<Central> instance_;
     Central();
+    // Follows the circuit breaker, true while the circuit is closed
     std::atomic<bool> centralStatus_;
-    std::string centralServerIp_;
-    int centralServerPort_;
-    std::shared_ptr<httpClientSession> pSendDeviceStatusSession_;
-    std::shared_ptr<httpClientSession> pSendHeartbeatSession_;
-    std::shared_ptr<httpClientSession> pSendParkInParkOutSession_;
+    boost::asio::io_context* pIoContext_;
+    std::shared_ptr<coroutineHttpClient> pCentralClient_;
+    CircuitBreaker circuitBreaker_;
+
+    // Payload templates rendered for one configuration snapshot
+    struct centralPayloads
+    {
+        const IniConfig* config;
+        PayloadTemplate heartbeat;
+        PayloadTemplate deviceStatus;
+        PayloadTemplate parkInOut;
+        PayloadTemplate parkInOutEvent;
+        PayloadTemplate parkInOutBatch;
+        PayloadTemplate hogging;
+    };
+
+    // Park event waiting in the current batch
+    struct parkInOutEvent
+    {
+        std::string id;
+        std::string lot_no;
+        std::string lpn;
+        std::string lot_in_image;
+        std::string lot_out_image;
+        std::string lot_in_time;
+        std::string lot_out_time;
+        send_callback callback;
+    };
+    typedef std::vector<parkInOutEvent> parkInOutBatch;
+
+    std::atomic<const centralPayloads*> payloads_;
+    // Like configuration snapshots, replaced templates stay alive for readers still using them
+    std::vector<std::unique_ptr<const centralPayloads>> payloadsHistory_;
+    std::mutex payloadsMutex_;
+
+    // Batch state is only touched on the batch strand
+    std::unique_ptr<boost::asio::strand<boost::asio::io_context::executor_type>> pBatchStrand_;
+    std::unique_ptr<boost::asio::steady_timer> pBatchTimer_;
+    parkInOutBatch batchEvents_;
+    // Bumped by every flush, a timer that already fired for an earlier batch is ignored
+    std::size_t batchGeneration_;
+    // Configuration snapshot under which Central refused batches, singles are sent until a reload
+    const IniConfig* batchRejectedConfig_;
+    std::atomic<unsigned long> nextBatchEventId_;
+
+    static centralRequestPolicy requestPolicy(const IniConfig& config);
+    static std::shared_ptr<boost::asio::ssl::context> createTlsContext(const IniConfig& config);
+    static circuitBreakerPolicy breakerPolicy(const IniConfig& config);
+    const centralPayloads* getPayloads(const IniConfig* config);
+    std::unique_ptr<const centralPayloads> buildPayloads(const IniConfig* config) const;
+
+    // Every request to Central goes through the circuit breaker here. Heartbeats
+    // are the probes, the other requests fail fast while the circuit is not closed.
+    void postToCentral(const IniConfig* config, const std::string& target, std::string body, bool isProbe,
+                    coroutineHttpClient::response_callback_type callback);
+    // Feeds the circuit breaker, halfOpenProbe set for the probe of a half-open circuit
+    void recordOutcome(const IniConfig* config, const centralResponse& response, bool halfOpenProbe);
 
     void onSendHeartbeatUpdateCallbackHandler(boost::beast::error_code ec, const std::string& msg);
     void onSendDeviceStatusUpdateCallbackHandler(boost::beast::error_code ec, const std::string& msg);
     void onSendParkInParkOutCallbackHandler(boost::beast::error_code ec, const std::string& msg);
+    void onSendHoggingEventCallbackHandler(boost::beast::error_code ec, const std::string& msg);
+
+    void sendParkInParkOut(const IniConfig* config,
+                        const std::string& lot_no,
+                        const std::string& lpn,
+                        const std::string& lot_in_image,
+                        const std::string& lot_out_image,
+                        const std::string& lot_in_time,
+                        const std::string& lot_out_time,
+                        send_callback callback);
+    void queueBatchEvent(const IniConfig* config, parkInOutEvent& event);
+    void flushBatch(const IniConfig* config);
+    void onSendBatchResponse(const IniConfig* config, parkInOutBatch& batch, const centralResponse& response);
+    void sendBatchEventsSingly(const IniConfig* config, parkInOutBatch& batch);
 };
\ No newline at end of file
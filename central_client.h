@@ -0,0 +1,973 @@
+#pragma once
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/version.hpp>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "body_compression.h"
+#include "handler_allocator.h"
+#include "log.h"
+
+// Timeouts per stage and retry behaviour of one Central request
+struct centralRequestPolicy
+{
+    std::chrono::milliseconds connectTimeout{std::chrono::seconds(5)};
+    std::chrono::milliseconds writeTimeout{std::chrono::seconds(10)};
+    std::chrono::milliseconds readTimeout{std::chrono::seconds(10)};
+    int maxAttempts = 3;
+    // Delay before the second attempt, doubled for every further attempt
+    std::chrono::milliseconds retryDelay{std::chrono::milliseconds(500)};
+    // Bodies of at least compressionMinBytes are sent with this Content-Encoding
+    contentEncoding compression = contentEncoding::Identity;
+    int compressionLevel = 1;
+    compressionStrategy deflateStrategy = compressionStrategy::HuffmanOnly;
+    std::size_t compressionMinBytes = 1024;
+    // HTTPS, needs a client constructed with a TLS context
+    bool tls = false;
+    // Offer the last session of the host again, an abbreviated handshake
+    bool tlsSessionResumption = true;
+    // Keep the connection open for the next request if Central allows it
+    bool keepAlive = false;
+    std::chrono::milliseconds keepAliveIdleTimeout{std::chrono::seconds(15)};
+};
+
+struct centralConnectionStats
+{
+    std::atomic<std::size_t> connects{0};
+    std::atomic<std::size_t> reusedConnections{0};
+    std::atomic<std::size_t> tlsHandshakes{0};
+    std::atomic<std::size_t> tlsResumed{0};
+};
+
+struct centralResponse
+{
+    boost::beast::error_code ec;
+    std::string msg;
+    unsigned int status = 0;
+    std::string body;
+    int attempts = 0;
+};
+
+/*
+ * Coroutine frames of the Central client come from the client's
+ * handler_memory. The owning memory is stored in front of the frame, since
+ * operator delete of a promise does not see the coroutine arguments.
+ */
+struct centralFrameAllocation
+{
+    static constexpr std::size_t HEADER_SIZE = alignof(std::max_align_t);
+
+    static void* allocate(handler_memory* memory, std::size_t size)
+    {
+        void* block = memory ? memory->allocate(size + HEADER_SIZE) : ::operator new(size + HEADER_SIZE);
+        *static_cast<handler_memory**>(block) = memory;
+        return static_cast<char*>(block) + HEADER_SIZE;
+    }
+
+    static void deallocate(void* frame)
+    {
+        void* block = static_cast<char*>(frame) - HEADER_SIZE;
+        handler_memory* memory = *static_cast<handler_memory**>(block);
+        if (memory)
+        {
+            memory->deallocate(block);
+        }
+        else
+        {
+            ::operator delete(block);
+        }
+    }
+};
+
+struct centralPromiseBase
+{
+    // Member coroutines of the client receive it as first argument
+    template <typename Client, typename... Args>
+    static void* operator new(std::size_t size, Client& client, Args&&...)
+    {
+        return centralFrameAllocation::allocate(&client.frameMemory(), size);
+    }
+
+    static void* operator new(std::size_t size)
+    {
+        return centralFrameAllocation::allocate(nullptr, size);
+    }
+
+    static void operator delete(void* frame)
+    {
+        centralFrameAllocation::deallocate(frame);
+    }
+};
+
+/*
+ * Lazily started coroutine returning T. Awaiting it starts it, and it
+ * resumes the awaiting coroutine directly when it finishes.
+ */
+template <typename T>
+class centralTask
+{
+public:
+    struct promise_type : centralPromiseBase
+    {
+        T value;
+        std::exception_ptr exception;
+        std::coroutine_handle<> continuation;
+
+        centralTask get_return_object()
+        {
+            return centralTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        auto final_suspend() noexcept
+        {
+            struct finalAwaiter
+            {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                {
+                    std::coroutine_handle<> continuation = handle.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            return finalAwaiter{};
+        }
+
+        void return_value(T result)
+        {
+            value = std::move(result);
+        }
+
+        void unhandled_exception()
+        {
+            exception = std::current_exception();
+        }
+    };
+
+    centralTask(centralTask&& other) noexcept
+        : handle_(std::exchange(other.handle_, nullptr))
+    {
+    }
+
+    centralTask(const centralTask&) = delete;
+    centralTask& operator=(const centralTask&) = delete;
+
+    ~centralTask()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+    {
+        handle_.promise().continuation = continuation;
+        return handle_;
+    }
+
+    T await_resume()
+    {
+        if (handle_.promise().exception)
+        {
+            std::rethrow_exception(handle_.promise().exception);
+        }
+        return std::move(handle_.promise().value);
+    }
+
+private:
+    explicit centralTask(std::coroutine_handle<promise_type> handle)
+        : handle_(handle)
+    {
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+/*
+ * Fire-and-forget coroutine, resumed once by its creator and freed when it
+ * returns. Its frame comes from the global heap: the frame may hold the last
+ * reference to the client, which is gone by the time the frame is freed.
+ */
+struct centralDetachedTask
+{
+    struct promise_type
+    {
+        static void* operator new(std::size_t size)
+        {
+            return ::operator new(size);
+        }
+
+        static void operator delete(void* frame)
+        {
+            ::operator delete(frame);
+        }
+
+        centralDetachedTask get_return_object()
+        {
+            return centralDetachedTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {
+        }
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+/*
+ * Awaits one Asio operation. The completion handler is allocated from the
+ * given handler_memory and resumes the coroutine on the I/O object's
+ * executor, so the coroutine keeps running on the client strand.
+ */
+template <typename Result, typename Initiation>
+class centralOperation
+{
+public:
+    centralOperation(handler_memory& memory, Initiation initiation, Result* result)
+        : memory_(memory),
+        initiation_(std::move(initiation)),
+        result_(result)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        initiation_(make_custom_alloc_handler(memory_, resumeHandler{this, handle}));
+    }
+
+    boost::system::error_code await_resume() const noexcept
+    {
+        return ec_;
+    }
+
+private:
+    struct resumeHandler
+    {
+        centralOperation* operation;
+        std::coroutine_handle<> handle;
+
+        void operator()(boost::system::error_code ec)
+        {
+            operation->ec_ = ec;
+            handle.resume();
+        }
+
+        template <typename Value>
+        void operator()(boost::system::error_code ec, Value&& value)
+        {
+            operation->ec_ = ec;
+            if constexpr (std::is_assignable<Result&, Value&&>::value)
+            {
+                if (operation->result_)
+                {
+                    *operation->result_ = std::forward<Value>(value);
+                }
+            }
+            handle.resume();
+        }
+    };
+
+    handler_memory& memory_;
+    Initiation initiation_;
+    Result* result_;
+    boost::system::error_code ec_;
+};
+
+template <typename Result = std::size_t, typename Initiation>
+centralOperation<Result, Initiation> awaitOperation(handler_memory& memory, Initiation initiation, Result* result = nullptr)
+{
+    return centralOperation<Result, Initiation>(memory, std::move(initiation), result);
+}
+
+/*
+ * Coroutine implementation of the Central HTTP sender.
+ * One request is one coroutine: connect, write and read are awaited in a
+ * plain retry loop, each stage with its own timeout, instead of a chain of
+ * callbacks each holding a shared_ptr copy. Requests run on the client's
+ * strand, every request has its own connection slot so they can overlap.
+ *
+ * Frames, connection slots and operation handlers are recycled, a request
+ * on a warm client only allocates what Beast allocates for the messages.
+ *
+ * HTTPS uses one shared ssl::context. The last session per host is offered
+ * on the next connection so repeated connections take the abbreviated
+ * handshake, and with keep-alive idle connections are pooled in the slots.
+ */
+class coroutineHttpClient : public std::enable_shared_from_this<coroutineHttpClient>
+{
+public:
+    typedef boost::asio::strand<boost::asio::io_context::executor_type> strand_type;
+    typedef boost::beast::basic_stream<boost::asio::ip::tcp, strand_type> stream_type;
+    typedef boost::beast::ssl_stream<stream_type> tls_stream_type;
+    typedef boost::asio::basic_waitable_timer<std::chrono::steady_clock, boost::asio::wait_traits<std::chrono::steady_clock>, strand_type> timer_type;
+    typedef boost::asio::ip::basic_resolver<boost::asio::ip::tcp, strand_type> resolver_type;
+    typedef std::function<void(boost::beast::error_code ec, const std::string& msg)> callback_type;
+    typedef std::function<void(const centralResponse& response)> response_callback_type;
+
+    // tlsContext is shared with the caller and only needed for TLS requests
+    explicit coroutineHttpClient(boost::asio::io_context& ioc, std::shared_ptr<boost::asio::ssl::context> tlsContext = nullptr)
+        : strand_(boost::asio::make_strand(ioc)),
+        tlsContext_(std::move(tlsContext)),
+        cancelGeneration_(0)
+    {
+    }
+
+    // Start a POST request, callback is invoked once with the final outcome
+    void post(const std::string& host, const std::string& port,
+            const std::string& target, std::string body,
+            const centralRequestPolicy& policy, callback_type callback)
+    {
+        // Compressed here, on the caller's thread, so the client strand only does I/O
+        contentEncoding encoding = compressBody(target, body, policy);
+        centralDetachedTask task = run(shared_from_this(), request(host, port, target, std::move(body), policy, encoding), std::move(callback));
+        boost::asio::dispatch(strand_, make_custom_alloc_handler(frameMemory_, [handle = task.handle]() {
+            handle.resume();
+        }));
+    }
+
+    // Same, for callers that need the status and body of the response
+    void post(const std::string& host, const std::string& port,
+            const std::string& target, std::string body,
+            const centralRequestPolicy& policy, response_callback_type callback)
+    {
+        // Compressed here, on the caller's thread, so the client strand only does I/O
+        contentEncoding encoding = compressBody(target, body, policy);
+        centralDetachedTask task = run(shared_from_this(), request(host, port, target, std::move(body), policy, encoding), std::move(callback));
+        boost::asio::dispatch(strand_, make_custom_alloc_handler(frameMemory_, [handle = task.handle]() {
+            handle.resume();
+        }));
+    }
+
+    // Awaitable form, for callers that are coroutines on the client strand.
+    // The body is sent as is, encoding names how it was already compressed.
+    centralTask<centralResponse> request(std::string host, std::string port,
+                                        std::string target, std::string body,
+                                        centralRequestPolicy policy,
+                                        contentEncoding encoding = contentEncoding::Identity)
+    {
+        std::size_t generation = cancelGeneration_;
+
+        connectionSlot* slot = acquireSlot(host, port, policy);
+        struct release
+        {
+            coroutineHttpClient& client;
+            connectionSlot* slot;
+            ~release() { client.releaseSlot(slot); }
+        } guard{*this, slot};
+
+        boost::beast::http::request<boost::beast::http::string_body>& req = slot->req;
+        req.version(11);
+        req.method(boost::beast::http::verb::post);
+        req.target(target);
+        req.set(boost::beast::http::field::host, host);
+        req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+        req.set(boost::beast::http::field::content_type, "application/json");
+        // Slots are recycled, a previous request may have left the header set
+        if (encoding != contentEncoding::Identity)
+        {
+            req.set(boost::beast::http::field::content_encoding, BodyCompressor::FnGetEncodingName(encoding));
+        }
+        else
+        {
+            req.erase(boost::beast::http::field::content_encoding);
+        }
+        req.keep_alive(policy.keepAlive);
+        req.body() = std::move(body);
+        req.prepare_payload();
+
+        centralResponse response;
+        std::chrono::milliseconds delay = policy.retryDelay;
+
+        for (int attempt = 1; attempt <= std::max(policy.maxAttempts, 1); attempt++)
+        {
+            response = co_await exchange(host, port, *slot, policy, generation);
+            response.attempts = attempt;
+
+            if (!shouldRetry(response) || generation != cancelGeneration_ || attempt >= policy.maxAttempts)
+            {
+                break;
+            }
+
+            logRetry(target, attempt, response, delay);
+
+            slot->retryTimer.expires_after(delay);
+            co_await awaitOperation(slot->handlerMemory, [&](auto handler) {
+                slot->retryTimer.async_wait(std::move(handler));
+            });
+            delay *= 2;
+
+            if (generation != cancelGeneration_)
+            {
+                break;
+            }
+        }
+
+        co_return response;
+    }
+
+    // Abort every request in flight, new requests are not affected
+    void cancel()
+    {
+        boost::asio::dispatch(strand_, [self = shared_from_this()]() {
+            self->cancelGeneration_++;
+            for (const std::unique_ptr<connectionSlot>& slot : self->slots_)
+            {
+                if (slot->inUse)
+                {
+                    slot->stream.cancel();
+                    if (slot->tlsStream)
+                    {
+                        boost::beast::get_lowest_layer(*slot->tlsStream).cancel();
+                    }
+                    slot->retryTimer.cancel();
+                }
+            }
+        });
+    }
+
+    handler_memory& frameMemory()
+    {
+        return frameMemory_;
+    }
+
+    const centralConnectionStats& connectionStats() const
+    {
+        return connectionStats_;
+    }
+
+private:
+    // Stream, buffers, messages and handler memory of one request, recycled
+    // once the request completes so steady traffic does not allocate them again.
+    // With keep-alive the connection stays open in the idle slot, for the
+    // next request to the same host, port and scheme.
+    struct connectionSlot
+    {
+        explicit connectionSlot(const strand_type& strand)
+            : stream(strand),
+            retryTimer(strand)
+        {
+        }
+
+        stream_type stream;
+        // Per TLS connection, an SSL object cannot be reused for the next one
+        std::optional<tls_stream_type> tlsStream;
+        timer_type retryTimer;
+        boost::beast::flat_buffer buffer;
+        boost::beast::http::request<boost::beast::http::string_body> req;
+        boost::beast::http::response<boost::beast::http::string_body> res;
+        handler_memory handlerMemory;
+        bool inUse = false;
+
+        bool connected = false;
+        std::string connectedHost;
+        std::string connectedPort;
+        bool connectedTls = false;
+        std::chrono::steady_clock::time_point idleSince;
+    };
+
+    struct sslSessionDeleter
+    {
+        void operator()(SSL_SESSION* session) const
+        {
+            SSL_SESSION_free(session);
+        }
+    };
+
+    strand_type strand_;
+    std::shared_ptr<boost::asio::ssl::context> tlsContext_;
+    handler_memory frameMemory_;
+    std::vector<std::unique_ptr<connectionSlot>> slots_;
+    std::vector<connectionSlot*> idleSlots_;
+    std::size_t cancelGeneration_;
+    // Last resumable TLS session per "host:port"
+    std::map<std::string, std::unique_ptr<SSL_SESSION, sslSessionDeleter>> tlsSessions_;
+    centralConnectionStats connectionStats_;
+
+    static bool isConnectedTo(const connectionSlot& slot, const std::string& host, const std::string& port, bool tls)
+    {
+        return slot.connected && (slot.connectedTls == tls) && (slot.connectedHost == host) && (slot.connectedPort == port);
+    }
+
+    connectionSlot* acquireSlot(const std::string& host, const std::string& port, const centralRequestPolicy& policy)
+    {
+        // Central closes idle connections on its own schedule, ours are dropped first
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (connectionSlot* idle : idleSlots_)
+        {
+            if (idle->connected && (now - idle->idleSince >= policy.keepAliveIdleTimeout))
+            {
+                closeConnection(*idle, true);
+            }
+        }
+
+        // Most recently used matching connection, then a slot without a connection,
+        // then the oldest idle connection, then a new slot
+        auto match = std::find_if(idleSlots_.rbegin(), idleSlots_.rend(), [&](connectionSlot* idle) {
+            return isConnectedTo(*idle, host, port, policy.tls);
+        });
+        std::vector<connectionSlot*>::iterator it;
+        if (match != idleSlots_.rend())
+        {
+            it = std::next(match).base();
+        }
+        else
+        {
+            it = std::find_if(idleSlots_.begin(), idleSlots_.end(), [](connectionSlot* idle) {
+                return !idle->connected;
+            });
+            if ((it == idleSlots_.end()) && !idleSlots_.empty())
+            {
+                it = idleSlots_.begin();
+            }
+        }
+
+        connectionSlot* slot;
+        if (it == idleSlots_.end())
+        {
+            slots_.push_back(std::make_unique<connectionSlot>(strand_));
+            slot = slots_.back().get();
+        }
+        else
+        {
+            slot = *it;
+            idleSlots_.erase(it);
+            if (!isConnectedTo(*slot, host, port, policy.tls))
+            {
+                closeConnection(*slot, true);
+            }
+        }
+        slot->inUse = true;
+        return slot;
+    }
+
+    void releaseSlot(connectionSlot* slot)
+    {
+        // exchange() leaves only reusable connections open
+        slot->buffer.clear();
+        slot->req.body().clear();
+        slot->res.clear();
+        slot->res.body().clear();
+        slot->idleSince = std::chrono::steady_clock::now();
+        slot->inUse = false;
+        idleSlots_.push_back(slot);
+    }
+
+    // keepSession after a completed exchange. OpenSSL drops the session of a
+    // connection freed without a shutdown, as if it had failed, and Central's
+    // client does not wait for close_notify, so the shutdown is only marked.
+    static void closeConnection(connectionSlot& slot, bool keepSession = false)
+    {
+        boost::system::error_code ec;
+        slot.stream.socket().close(ec);
+        if (slot.tlsStream)
+        {
+            if (keepSession)
+            {
+                SSL_set_shutdown(slot.tlsStream->native_handle(), SSL_SENT_SHUTDOWN);
+            }
+            boost::beast::get_lowest_layer(*slot.tlsStream).socket().close(ec);
+            slot.tlsStream.reset();
+        }
+        slot.connected = false;
+    }
+
+    // Compress body in place as the policy asks, returns the encoding it ended up with
+    static contentEncoding compressBody(const std::string& target, std::string& body, const centralRequestPolicy& policy)
+    {
+        if ((policy.compression == contentEncoding::Identity) || (body.size() < policy.compressionMinBytes))
+        {
+            return contentEncoding::Identity;
+        }
+
+        std::string compressed;
+        if (!BodyCompressor::FnCompress(policy.compression, policy.compressionLevel, policy.deflateStrategy, body, compressed))
+        {
+            Logger::getInstance()->FnLog(target + " body compression failed, sent uncompressed", "CENTRAL");
+            return contentEncoding::Identity;
+        }
+
+        // Already compressed content is not worth the server's inflate
+        if (compressed.size() >= body.size())
+        {
+            return contentEncoding::Identity;
+        }
+
+        body.swap(compressed);
+        return policy.compression;
+    }
+
+    static bool shouldRetry(const centralResponse& response)
+    {
+        if (response.ec == boost::asio::error::operation_aborted)
+        {
+            return false;
+        }
+        if (response.ec)
+        {
+            return true;
+        }
+        // Server errors are retried, client errors would fail again
+        return response.status >= 500;
+    }
+
+    // Kept out of the request coroutine so the stream is not part of its frame
+    static void logRetry(const std::string& target, int attempt, const centralResponse& response, std::chrono::milliseconds delay)
+    {
+        std::ostringstream oss;
+        oss << target << " attempt " << attempt << " failed, " << response.msg << " :" << response.ec.message() << ", retry in " << delay.count() << " ms";
+        Logger::getInstance()->FnLog(oss.str(), "CENTRAL");
+    }
+
+    static void complete(callback_type& callback, const centralResponse& response)
+    {
+        callback(response.ec, response.msg);
+    }
+
+    static void complete(response_callback_type& callback, const centralResponse& response)
+    {
+        callback(response);
+    }
+
+    // Keeps the client alive until the request has reported its outcome
+    template <typename Callback>
+    centralDetachedTask run(std::shared_ptr<coroutineHttpClient> self, centralTask<centralResponse> task, Callback callback)
+    {
+        centralResponse response;
+        try
+        {
+            response = co_await std::move(task);
+        }
+        catch (const std::exception& ex)
+        {
+            std::ostringstream oss;
+            oss << "Central request Exception :" << ex.what();
+            Logger::getInstance()->FnLog(oss.str(), "CENTRAL");
+            // A failed request, not a cancelled one
+            response.ec = boost::system::errc::make_error_code(boost::system::errc::io_error);
+            response.msg = "Exception";
+        }
+        complete(callback, response);
+
+        // Parameters go in reverse order, task and its frames from frameMemory_ before self
+        static_cast<void>(self);
+    }
+
+    centralTask<centralResponse> exchange(const std::string& host, const std::string& port,
+                                        connectionSlot& slot,
+                                        const centralRequestPolicy& policy, std::size_t generation)
+    {
+        centralResponse response;
+
+        if (generation != cancelGeneration_)
+        {
+            response.ec = boost::asio::error::operation_aborted;
+            response.msg = "Cancelled";
+            co_return response;
+        }
+
+        // A pooled connection may have been closed by Central while it was
+        // idle. That failure gets one fresh connection, it is not an attempt.
+        bool reused = slot.connected;
+        for (;;)
+        {
+            slot.buffer.clear();
+            slot.res.clear();
+            slot.res.body().clear();
+
+            if (slot.connected)
+            {
+                connectionStats_.reusedConnections.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                response = co_await connect(host, port, slot, policy);
+                if (response.ec)
+                {
+                    closeConnection(slot);
+                    co_return response;
+                }
+            }
+
+            if (slot.tlsStream)
+            {
+                response = co_await transfer(*slot.tlsStream, slot, policy);
+            }
+            else
+            {
+                response = co_await transfer(slot.stream, slot, policy);
+            }
+
+            if (response.ec && reused && (response.ec != boost::beast::error::timeout) && (response.ec != boost::asio::error::operation_aborted))
+            {
+                closeConnection(slot);
+                reused = false;
+                continue;
+            }
+            break;
+        }
+
+        if (response.ec)
+        {
+            closeConnection(slot);
+            co_return response;
+        }
+
+        boost::beast::http::response<boost::beast::http::string_body>& res = slot.res;
+
+        // Log the response
+        Logger::getInstance()->FnLog(res.body(), "CENTRAL");
+
+        if (slot.tlsStream)
+        {
+            // TLS 1.3 tickets arrive after the handshake, the session is taken once a response was read
+            storeTlsSession(host, port, *slot.tlsStream);
+        }
+
+        if (policy.keepAlive && res.keep_alive())
+        {
+            slot.connected = true;
+        }
+        else if (slot.tlsStream)
+        {
+            closeConnection(slot, true);
+        }
+        else
+        {
+            // Gracefully close the socket
+            boost::beast::error_code ec;
+            slot.stream.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+            closeConnection(slot);
+
+            // not_connected happens sometimes so don't bother reporting it.
+            if (ec && ec != boost::beast::errc::not_connected)
+            {
+                response.ec = ec;
+                response.msg = "Shutdown Error";
+                co_return response;
+            }
+        }
+
+        response.status = res.result_int();
+        response.body = std::move(res.body());
+        if (res.result() != boost::beast::http::status::ok)
+        {
+            response.msg = "Status Not Ok";
+        }
+
+        co_return response;
+    }
+
+    // TCP connect, then the TLS handshake when the policy asks for TLS
+    centralTask<centralResponse> connect(const std::string& host, const std::string& port,
+                                        connectionSlot& slot, const centralRequestPolicy& policy)
+    {
+        centralResponse response;
+        boost::beast::error_code ec;
+
+        if (policy.tls && !tlsContext_)
+        {
+            response.ec = boost::asio::error::no_protocol_option;
+            response.msg = "TLS Not Configured";
+            co_return response;
+        }
+
+        // Central is normally configured by IP, skip the resolver for that
+        boost::asio::ip::tcp::endpoint endpoint;
+        boost::asio::ip::address address = boost::asio::ip::make_address(host, ec);
+        if (!ec)
+        {
+            endpoint = boost::asio::ip::tcp::endpoint(address, static_cast<unsigned short>(std::stoi(port)));
+        }
+        else
+        {
+            resolver_type resolver(strand_);
+            resolver_type::results_type results;
+            ec = co_await awaitOperation(slot.handlerMemory, [&](auto handler) {
+                resolver.async_resolve(host, port, std::move(handler));
+            }, &results);
+            if (ec || results.empty())
+            {
+                response.ec = ec ? ec : boost::asio::error::host_not_found;
+                response.msg = "Resolve Error";
+                co_return response;
+            }
+            endpoint = results.begin()->endpoint();
+        }
+
+        if (policy.tls)
+        {
+            slot.tlsStream.emplace(strand_, *tlsContext_);
+        }
+        stream_type& stream = slot.tlsStream ? boost::beast::get_lowest_layer(*slot.tlsStream) : slot.stream;
+
+        stream.expires_after(policy.connectTimeout);
+        ec = co_await awaitOperation(slot.handlerMemory, [&](auto handler) {
+            stream.async_connect(endpoint, std::move(handler));
+        });
+        if (ec)
+        {
+            response.ec = ec;
+            response.msg = "Connect Error";
+            co_return response;
+        }
+        connectionStats_.connects.fetch_add(1, std::memory_order_relaxed);
+
+        // Handshake messages and the request are separate small writes, Nagle
+        // would hold the request back for the delayed ACK of the previous one
+        stream.socket().set_option(boost::asio::ip::tcp::no_delay(true), ec);
+
+        if (slot.tlsStream)
+        {
+            prepareTls(host, port, policy, *slot.tlsStream);
+
+            stream.expires_after(policy.connectTimeout);
+            ec = co_await awaitOperation(slot.handlerMemory, [&](auto handler) {
+                slot.tlsStream->async_handshake(boost::asio::ssl::stream_base::client, std::move(handler));
+            });
+            if (ec)
+            {
+                // A session the server no longer accepts is not offered again
+                tlsSessions_.erase(host + ":" + port);
+                response.ec = ec;
+                response.msg = "Handshake Error";
+                co_return response;
+            }
+
+            connectionStats_.tlsHandshakes.fetch_add(1, std::memory_order_relaxed);
+            if (SSL_session_reused(slot.tlsStream->native_handle()))
+            {
+                connectionStats_.tlsResumed.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        slot.connected = true;
+        slot.connectedHost = host;
+        slot.connectedPort = port;
+        slot.connectedTls = policy.tls;
+        co_return response;
+    }
+
+    // Write the slot's request and read the response, on a plain or TLS stream
+    template <typename Stream>
+    centralTask<centralResponse> transfer(Stream& stream, connectionSlot& slot, const centralRequestPolicy& policy)
+    {
+        centralResponse response;
+        boost::beast::error_code ec;
+
+        boost::beast::get_lowest_layer(stream).expires_after(policy.writeTimeout);
+        ec = co_await awaitOperation(slot.handlerMemory, [&](auto handler) {
+            boost::beast::http::async_write(stream, slot.req, std::move(handler));
+        });
+        if (ec)
+        {
+            response.ec = ec;
+            response.msg = "Write Error";
+            co_return response;
+        }
+
+        boost::beast::get_lowest_layer(stream).expires_after(policy.readTimeout);
+        ec = co_await awaitOperation(slot.handlerMemory, [&](auto handler) {
+            boost::beast::http::async_read(stream, slot.buffer, slot.res, std::move(handler));
+        });
+        if (ec)
+        {
+            response.ec = ec;
+            response.msg = "Read Error";
+            co_return response;
+        }
+
+        co_return response;
+    }
+
+    // SNI, peer name check and the session to resume, before the handshake
+    void prepareTls(const std::string& host, const std::string& port, const centralRequestPolicy& policy, tls_stream_type& stream)
+    {
+        SSL* ssl = stream.native_handle();
+
+        // Only checked when the context verifies the peer
+        boost::system::error_code ec;
+        boost::asio::ip::make_address(host, ec);
+        if (ec)
+        {
+            SSL_set_tlsext_host_name(ssl, host.c_str());
+            SSL_set1_host(ssl, host.c_str());
+        }
+        else
+        {
+            X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl), host.c_str());
+        }
+
+        if (policy.tlsSessionResumption)
+        {
+            auto it = tlsSessions_.find(host + ":" + port);
+            if (it != tlsSessions_.end())
+            {
+                SSL_set_session(ssl, it->second.get());
+            }
+        }
+    }
+
+    void storeTlsSession(const std::string& host, const std::string& port, tls_stream_type& stream)
+    {
+        SSL_SESSION* session = SSL_get1_session(stream.native_handle());
+        if (session && SSL_SESSION_is_resumable(session))
+        {
+            tlsSessions_[host + ":" + port].reset(session);
+        }
+        else if (session)
+        {
+            SSL_SESSION_free(session);
+        }
+    }
+};
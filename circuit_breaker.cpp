@@ -0,0 +1,138 @@
+#include <algorithm>
+#include "circuit_breaker.h"
+
+CircuitBreaker::CircuitBreaker()
+    : state_(circuitState::Closed),
+    consecutiveFailures_(0),
+    consecutiveOpens_(0),
+    openDelay_(0),
+    random_(std::random_device{}())
+{
+}
+
+bool CircuitBreaker::FnAllowRequest(bool isProbe, bool* halfOpenProbe)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (halfOpenProbe != nullptr)
+    {
+        *halfOpenProbe = false;
+    }
+
+    switch (state_)
+    {
+        case circuitState::Closed:
+            return true;
+        case circuitState::Open:
+            if (isProbe && (std::chrono::steady_clock::now() >= openUntil_))
+            {
+                state_ = circuitState::HalfOpen;
+                if (halfOpenProbe != nullptr)
+                {
+                    *halfOpenProbe = true;
+                }
+                return true;
+            }
+            return false;
+        default:
+            // Only the one probe is in flight while half-open
+            return false;
+    }
+}
+
+bool CircuitBreaker::FnRecordSuccess(bool halfOpenProbe)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    consecutiveFailures_ = 0;
+    if ((state_ == circuitState::Closed) || ((state_ == circuitState::HalfOpen) && !halfOpenProbe))
+    {
+        return false;
+    }
+
+    // Also a request sent before the circuit opened, the service answered
+    state_ = circuitState::Closed;
+    consecutiveOpens_ = 0;
+    return true;
+}
+
+bool CircuitBreaker::FnRecordFailure(const circuitBreakerPolicy& policy, bool halfOpenProbe)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    consecutiveFailures_++;
+    if (((state_ == circuitState::HalfOpen) && halfOpenProbe) ||
+        ((state_ == circuitState::Closed) && (consecutiveFailures_ >= std::max(policy.failureThreshold, 1))))
+    {
+        open(policy);
+        return true;
+    }
+    return false;
+}
+
+bool CircuitBreaker::FnRecordAborted(bool halfOpenProbe)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if ((state_ != circuitState::HalfOpen) || !halfOpenProbe)
+    {
+        return false;
+    }
+
+    // The probe said nothing about the service, the next probe may go right away
+    state_ = circuitState::Open;
+    openUntil_ = std::chrono::steady_clock::now();
+    return true;
+}
+
+circuitState CircuitBreaker::FnGetState() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return state_;
+}
+
+std::chrono::milliseconds CircuitBreaker::FnGetOpenDelay() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return openDelay_;
+}
+
+int CircuitBreaker::FnGetConsecutiveFailures() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return consecutiveFailures_;
+}
+
+const char* CircuitBreaker::FnGetStateName(circuitState state)
+{
+    switch (state)
+    {
+        case circuitState::Closed:
+            return "closed";
+        case circuitState::Open:
+            return "open";
+        default:
+            return "half-open";
+    }
+}
+
+void CircuitBreaker::open(const circuitBreakerPolicy& policy)
+{
+    // base * 2^opens, capped, without overflowing the shift
+    long long baseMs = std::max<long long>(policy.openBaseDelay.count(), 1);
+    long long maxMs = std::max<long long>(policy.openMaxDelay.count(), baseMs);
+    long long delayMs = baseMs;
+    for (int i = 0; (i < consecutiveOpens_) && (delayMs < maxMs); i++)
+    {
+        delayMs *= 2;
+    }
+    delayMs = std::min(delayMs, maxMs);
+
+    // Upper half jitter, controllers that lost Central together do not probe together
+    std::uniform_int_distribution<long long> jitter(delayMs / 2, delayMs);
+    openDelay_ = std::chrono::milliseconds(jitter(random_));
+    openUntil_ = std::chrono::steady_clock::now() + openDelay_;
+
+    state_ = circuitState::Open;
+    consecutiveOpens_++;
+}
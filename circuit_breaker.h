@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <random>
+
+enum class circuitState
+{
+    Closed,     // requests are sent
+    Open,       // requests fail fast until the open delay has passed
+    HalfOpen    // one probe is in flight, its outcome closes or reopens the circuit
+};
+
+struct circuitBreakerPolicy
+{
+    // Consecutive failed requests that open the circuit
+    int failureThreshold = 5;
+    // Open delay after the first trip, doubled on every failed probe up to openMaxDelay.
+    // The delay is jittered over its upper half.
+    std::chrono::milliseconds openBaseDelay{5000};
+    std::chrono::milliseconds openMaxDelay{300000};
+};
+
+/*
+ * Circuit breaker of one remote service, safe to use from any thread.
+ * Only a request marked as probe can move an open circuit to half-open, so
+ * the caller decides which traffic tests the service (Central's heartbeat).
+ */
+class CircuitBreaker
+{
+public:
+    CircuitBreaker();
+
+    /*
+     * True if a request may be sent now. While open, a probe is let through
+     * once the open delay has passed and the circuit turns half-open;
+     * halfOpenProbe, if given, tells whether this request is that probe.
+     */
+    bool FnAllowRequest(bool isProbe, bool* halfOpenProbe = nullptr);
+
+    /*
+     * Outcome of a sent request, true if it changed the state. While half-open
+     * only the outcome of the probe counts, halfOpenProbe as FnAllowRequest
+     * returned it; a request sent before the circuit opened does not decide.
+     */
+    bool FnRecordSuccess(bool halfOpenProbe);
+    bool FnRecordFailure(const circuitBreakerPolicy& policy, bool halfOpenProbe);
+    // A request that ended without an outcome; a cancelled probe reopens the circuit for the next one
+    bool FnRecordAborted(bool halfOpenProbe);
+
+    circuitState FnGetState() const;
+    // Delay of the current or last opening
+    std::chrono::milliseconds FnGetOpenDelay() const;
+    int FnGetConsecutiveFailures() const;
+
+    static const char* FnGetStateName(circuitState state);
+
+private:
+    void open(const circuitBreakerPolicy& policy);
+
+    mutable std::mutex mutex_;
+    circuitState state_;
+    int consecutiveFailures_;
+    // Openings since the circuit was last closed, the backoff exponent
+    int consecutiveOpens_;
+    std::chrono::milliseconds openDelay_;
+    std::chrono::steady_clock::time_point openUntil_;
+    std::mt19937 random_;
+};
@@ -1,34 +1,34 @@
 #include <arpa/inet.h>
 #include <boost/asio.hpp>
-#include <boost/archive/iterators/base64_from_binary.hpp>
-#include <boost/archive/iterators/transform_width.hpp>
 #include <chrono>
+#include <cstring>
 #include <ctime>
-#include <fstream>
 #include <ifaddrs.h>
 #include <iomanip>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
 #include <string>
 #include <sstream>
 #include "common.h"
+#include "image_source.h"
+#include "ini_parser.h"
 #include "version.h"
 #include "log.h"
 
-Common* Common::common_ = nullptr;
-std::mutex Common::mutex_;
+ServiceInstance<Common> Common::instance_;
 
 Common::Common()
+    : localIPv4Address_(0),
+    networkInterface_("eth0"),
+    networkInterfaceIndex_(0)
 {
 
 }
 
 Common* Common::getInstance()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (common_ == nullptr)
-    {
-        common_ = new Common();
-    }
-    return common_;
+    return instance_.get([]() { return new Common(); });
 }
 
 std::string Common::FnGetFileName(const std::string& str)
@@ -86,9 +86,72 @@ std::string Common::FnGetDateTimeFormat_YYYY_MM_DD_HH_MM_SS()
     return oss.str();
 }
 
-std::string Common::FnGetLocalIPAddress()
+std::string Common::FnFormatDateTime_YYYY_MM_DD_HH_MM_SS(std::chrono::system_clock::time_point time)
 {
-    std::string ipv4Address = "";
+    if (time == std::chrono::system_clock::time_point())
+    {
+        return "";
+    }
+
+    auto timer = std::chrono::system_clock::to_time_t(time);
+    struct tm timeinfo = {};
+    localtime_r(&timer, &timeinfo);
+
+    char buffer[20];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    return buffer;
+}
+
+std::chrono::system_clock::time_point Common::FnParseDateTime_YYYY_MM_DD_HH_MM_SS(const std::string& text)
+{
+    struct tm timeinfo = {};
+    std::istringstream iss(text);
+    iss >> std::get_time(&timeinfo, "%Y-%m-%d %H:%M:%S");
+    if (text.empty() || iss.fail() || (iss.peek() != std::char_traits<char>::eof()))
+    {
+        return std::chrono::system_clock::time_point();
+    }
+
+    timeinfo.tm_isdst = -1;
+    return std::chrono::system_clock::from_time_t(std::mktime(&timeinfo));
+}
+
+void Common::FnLocalIPAddressInitialization(boost::asio::io_context& io_context)
+{
+    std::string networkInterface = IniParser::getInstance()->FnGetNetworkInterface();
+    if (!networkInterface.empty())
+    {
+        networkInterface_ = networkInterface;
+    }
+    networkInterfaceIndex_ = if_nametoindex(networkInterface_.c_str());
+
+    // Populate the cache once, netlink keeps it up to date afterwards
+    refreshLocalIPAddress();
+
+    try
+    {
+        boost::asio::generic::raw_protocol protocol(AF_NETLINK, NETLINK_ROUTE);
+        pNetlinkSocket_ = std::make_unique<boost::asio::generic::raw_protocol::socket>(io_context, protocol);
+
+        struct sockaddr_nl addr = {};
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = RTMGRP_IPV4_IFADDR;
+        pNetlinkSocket_->bind(boost::asio::generic::raw_protocol::endpoint(&addr, sizeof(addr), NETLINK_ROUTE));
+
+        startNetlinkReceive();
+    }
+    catch (const boost::system::system_error& e)
+    {
+        std::ostringstream oss;
+        oss << "Netlink socket Exception :" << e.what();
+        Logger::getInstance()->FnLog(oss.str(), "COMMON");
+        pNetlinkSocket_.reset();
+    }
+}
+
+void Common::refreshLocalIPAddress()
+{
+    std::uint32_t ipv4Address = 0;
     struct ifaddrs *interfaces = NULL;
     struct ifaddrs *tempAddr = NULL;
     int success = 0;
@@ -98,58 +161,167 @@ std::string Common::FnGetLocalIPAddress()
         // Loop through linked list of interfaces
         tempAddr = interfaces;
         while(tempAddr != NULL) {
-            if(tempAddr->ifa_addr->sa_family == AF_INET) {
-                // Check if interface is "en0" which is the common name for Ethernet or Wi-Fi on macOS
-                if(strcmp(tempAddr->ifa_name, "eth0") == 0) {
-                    ipv4Address = inet_ntoa(((struct sockaddr_in*)tempAddr->ifa_addr)->sin_addr);
+            if(tempAddr->ifa_addr != NULL && tempAddr->ifa_addr->sa_family == AF_INET) {
+                if(networkInterface_ == tempAddr->ifa_name) {
+                    ipv4Address = ((struct sockaddr_in*)tempAddr->ifa_addr)->sin_addr.s_addr;
                     break; // Exit the loop after finding the IPv4 address
                 }
             }
             tempAddr = tempAddr->ifa_next;
         }
+        // Free memory
+        freeifaddrs(interfaces);
     }
-    // Free memory
-    freeifaddrs(interfaces);
-    return ipv4Address;
+    localIPv4Address_.store(ipv4Address, std::memory_order_release);
+
+    std::ostringstream oss;
+    oss << "Local IP address of " << networkInterface_ << " :" << FnGetLocalIPAddress();
+    Logger::getInstance()->FnLog(oss.str(), "COMMON");
 }
 
-std::string Common::FnConvertImageToBase64String(const std::string& image_path)
+void Common::startNetlinkReceive()
+{
+    pNetlinkSocket_->async_receive(boost::asio::buffer(netlinkBuffer_),
+                                std::bind(&Common::onNetlinkReceive, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void Common::onNetlinkReceive(const boost::system::error_code& ec, std::size_t bytes_transferred)
 {
-    std::ifstream imageFile(image_path, std::ios::binary | std::ios::ate);
+    if (ec)
+    {
+        if (ec != boost::asio::error::operation_aborted)
+        {
+            std::ostringstream oss;
+            oss << "Netlink receive Exception :" << ec.message();
+            Logger::getInstance()->FnLog(oss.str(), "COMMON");
+
+            // After an overrun (ENOBUFS) the kernel has dropped events, the cache is read anew
+            networkInterfaceIndex_ = if_nametoindex(networkInterface_.c_str());
+            refreshLocalIPAddress();
+            startNetlinkReceive();
+        }
+        return;
+    }
 
-    if (!imageFile.is_open())
+    int len = static_cast<int>(bytes_transferred);
+    for (struct nlmsghdr* nh = reinterpret_cast<struct nlmsghdr*>(netlinkBuffer_.data()); NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
     {
+        if (nh->nlmsg_type == NLMSG_DONE || nh->nlmsg_type == NLMSG_ERROR)
+        {
+            break;
+        }
+
+        if (nh->nlmsg_type != RTM_NEWADDR && nh->nlmsg_type != RTM_DELADDR)
+        {
+            continue;
+        }
+
+        struct ifaddrmsg* ifa = reinterpret_cast<struct ifaddrmsg*>(NLMSG_DATA(nh));
+        if (ifa->ifa_family != AF_INET)
+        {
+            continue;
+        }
+
+        if ((ifa->ifa_index != networkInterfaceIndex_) && (nh->nlmsg_type == RTM_NEWADDR))
+        {
+            // The interface may have appeared, or been re-created with another index, since it was resolved
+            networkInterfaceIndex_ = if_nametoindex(networkInterface_.c_str());
+        }
+        if (ifa->ifa_index != networkInterfaceIndex_)
+        {
+            continue;
+        }
+
+        std::uint32_t address = 0;
+        int rtaLen = IFA_PAYLOAD(nh);
+        for (struct rtattr* rta = IFA_RTA(ifa); RTA_OK(rta, rtaLen); rta = RTA_NEXT(rta, rtaLen))
+        {
+            // IFA_LOCAL is the interface address, IFA_ADDRESS only differs on point-to-point links
+            if (rta->rta_type == IFA_LOCAL || (rta->rta_type == IFA_ADDRESS && address == 0))
+            {
+                std::memcpy(&address, RTA_DATA(rta), sizeof(address));
+            }
+        }
+
+        if (nh->nlmsg_type == RTM_NEWADDR)
+        {
+            localIPv4Address_.store(address, std::memory_order_release);
+        }
+        else
+        {
+            std::uint32_t expected = address;
+            localIPv4Address_.compare_exchange_strong(expected, 0, std::memory_order_acq_rel);
+        }
+
         std::ostringstream oss;
-        oss << "Error opening the image file :" << image_path;
+        oss << (nh->nlmsg_type == RTM_NEWADDR ? "Address added on " : "Address removed on ") << networkInterface_ << ", local IP address :" << FnGetLocalIPAddress();
         Logger::getInstance()->FnLog(oss.str(), "COMMON");
+    }
+
+    startNetlinkReceive();
+}
+
+std::string Common::FnGetLocalIPAddress()
+{
+    struct in_addr addr = {};
+    addr.s_addr = localIPv4Address_.load(std::memory_order_acquire);
+    if (addr.s_addr == 0)
+    {
         return "";
     }
 
-    std::streamsize size = imageFile.tellg();
-    imageFile.seekg(0, std::ios::beg);
+    char buffer[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &addr, buffer, sizeof(buffer));
+    return buffer;
+}
 
-    std::string buffer(size, ' ');
-    if (!imageFile.read(&buffer[0], size))
+std::string Common::FnConvertImageToBase64String(const std::string& image_path)
+{
+    ImageSource image;
+
+    if (!image.FnOpen(image_path))
     {
-        std::ostringstream oss;
-        oss << "Error reading the image file :" << image_path;
-        Logger::getInstance()->FnLog(oss.str(), "COMMON");
         return "";
     }
 
-    imageFile.close();
+    return FnEncodeBase64(image.FnGetBuffer());
+}
 
-    using namespace boost::archive::iterators;
+std::string Common::FnEncodeBase64(boost::asio::const_buffer data)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-    // Create a base64 encoder using Boost.Archive
-    typedef base64_from_binary<transform_width<std::string::const_iterator, 6, 8>> base64_text;
+    const unsigned char* in = static_cast<const unsigned char*>(data.data());
+    std::size_t size = data.size();
 
-    std::stringstream encoded;
-    std::copy(base64_text(buffer.begin()), base64_text(buffer.end()), std::ostream_iterator<char>(encoded));
+    std::string encoded;
+    encoded.resize(((size + 2) / 3) * 4);
+    char* out = &encoded[0];
+
+    std::size_t i = 0;
+    for (; i + 3 <= size; i += 3)
+    {
+        std::uint32_t triple = (static_cast<std::uint32_t>(in[i]) << 16) | (static_cast<std::uint32_t>(in[i + 1]) << 8) | in[i + 2];
+        *out++ = table[(triple >> 18) & 0x3F];
+        *out++ = table[(triple >> 12) & 0x3F];
+        *out++ = table[(triple >> 6) & 0x3F];
+        *out++ = table[triple & 0x3F];
+    }
 
     // Append padding characters if needed
-    size_t padding = (3 - buffer.size() % 3) % 3;
-    encoded.write("===", padding);
+    std::size_t remaining = size - i;
+    if (remaining > 0)
+    {
+        std::uint32_t triple = static_cast<std::uint32_t>(in[i]) << 16;
+        if (remaining == 2)
+        {
+            triple |= static_cast<std::uint32_t>(in[i + 1]) << 8;
+        }
+        *out++ = table[(triple >> 18) & 0x3F];
+        *out++ = table[(triple >> 12) & 0x3F];
+        *out++ = (remaining == 2) ? table[(triple >> 6) & 0x3F] : '=';
+        *out++ = '=';
+    }
 
-    return encoded.str();
-}
\ No newline at end of file
+    return encoded;
+}
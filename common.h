@@ -1,8 +1,16 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <linux/netlink.h>
+#include <memory>
 #include <string>
 #include <mutex>
+#include "service.h"
 
 class Common
 {
@@ -13,8 +21,14 @@ public:
     std::string FnGetDateTime();
     std::string FnGetDateTimeFormat_yymmdd();
     std::string FnGetDateTimeFormat_YYYY_MM_DD_HH_MM_SS();
+    // Local time as YYYY-MM-DD HH:MM:SS, "" for the epoch (not set)
+    std::string FnFormatDateTime_YYYY_MM_DD_HH_MM_SS(std::chrono::system_clock::time_point time);
+    // The epoch (not set) if text is empty or not YYYY-MM-DD HH:MM:SS
+    std::chrono::system_clock::time_point FnParseDateTime_YYYY_MM_DD_HH_MM_SS(const std::string& text);
+    void FnLocalIPAddressInitialization(boost::asio::io_context& io_context);
     std::string FnGetLocalIPAddress();
     std::string FnConvertImageToBase64String(const std::string& image_path);
+    std::string FnEncodeBase64(boost::asio::const_buffer data);
 
     /*
      * Singleton Common should not be cloneable
@@ -27,7 +41,19 @@ public:
     void operator=(const Common&) = delete;
 
 private:
-    static Common* common_;
-    static std::mutex mutex_;
+    static ServiceInstance<Common> instance_;
     Common();
+
+    // Local IPv4 address of the configured interface, network byte order (0 = none).
+    // Refreshed from netlink RTM_NEWADDR / RTM_DELADDR notifications.
+    std::atomic<std::uint32_t> localIPv4Address_;
+    std::string networkInterface_;
+    unsigned int networkInterfaceIndex_;
+    std::unique_ptr<boost::asio::generic::raw_protocol::socket> pNetlinkSocket_;
+    // Read as a sequence of nlmsghdr, aligned like one
+    alignas(struct nlmsghdr) std::array<char, 8192> netlinkBuffer_;
+
+    void refreshLocalIPAddress();
+    void startNetlinkReceive();
+    void onNetlinkReceive(const boost::system::error_code& ec, std::size_t bytes_transferred);
 };
\ No newline at end of file
@@ -1,28 +1,61 @@
+#include <cstdlib>
+#include <iomanip>
+#include <random>
+#include "common.h"
 #include "database.h"
+#include "ini_parser.h"
 #include "log.h"
 
-MariaDB* MariaDB::mariaDb_ = nullptr;
-std::mutex MariaDB::mutex_;
+ServiceInstance<MariaDB> MariaDB::instance_;
+
+namespace
+{
+
+// In the order selectEvLotTransRecords reads them
+const std::string EV_LOT_TRANS_COLUMNS = "id, location_code, lot_no, lpn, lot_in_image, lot_out_image, lot_in_dt, lot_out_dt,"
+                                         " add_dt, update_dt, lot_in_central_sent_dt, lot_out_central_sent_dt";
+
+}
 
 MariaDB::MariaDB()
     : databaseStatus_(false),
-    databaseRecoveryFlag_(false)
+    databaseRecoveryFlag_(false),
+    reconnectDelay_(0),
+    unsentEvLotStatusCount_(0),
+    unsentEvLotTransCount_(0),
+    unsentEvLotHoggingCount_(0),
+    idempotencySequence_(0)
 {
-
+    // Keys of this run, a sequence number is appended per insert
+    std::random_device random;
+    std::ostringstream prefix;
+    prefix << std::hex << std::setfill('0') << std::setw(8) << random() << std::setw(8) << random();
+    idempotencyPrefix_ = prefix.str();
 }
 
 MariaDB* MariaDB::getInstance()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (mariaDb_ == nullptr)
-    {
-        mariaDb_ = new MariaDB();
-    }
-    return mariaDb_;
+    return instance_.get([]() { return new MariaDB(); });
 }
 
 void MariaDB::FnConnectMariaLocalDatabase()
 {
+    // Opened first, writes are kept even if the database is not there at startup
+    const IniConfig* config = IniParser::getInstance()->FnGetConfig();
+    if (!journal_.FnIsOpen())
+    {
+        if (journal_.FnOpen(config->databaseJournalFile, static_cast<std::size_t>(std::max(config->databaseJournalCapacityMb, 1)) * 1024 * 1024))
+        {
+            std::ostringstream oss;
+            oss << "Write journal " << config->databaseJournalFile << " opened, " << journal_.FnGetPendingCount() << " writes pending.";
+            Logger::getInstance()->FnLog(oss.str(), "DB");
+        }
+        else
+        {
+            Logger::getInstance()->FnLog("Failed to open write journal " + config->databaseJournalFile + ", writes are lost while the database is unavailable.", "DB");
+        }
+    }
+
     if (!mariaDatabase_)
     {
         mariaDatabase_ = std::make_unique<OdbcDatabase>();
@@ -34,6 +67,7 @@ void MariaDB::FnConnectMariaLocalDatabase()
         {
             Logger::getInstance()->FnLog("Successful connected to ev_charging_database.", "DB");
             FnSetDatabaseStatus(true);
+            FnRefreshUnsentCounts();
         }
         else
         {
@@ -43,16 +77,9 @@ void MariaDB::FnConnectMariaLocalDatabase()
     }
 }
 
-bool MariaDB::FnIsConnected()
+bool MariaDB::FnIsConnected() const
 {
-    bool ret = false;
-
-    if (mariaDatabase_)
-    {
-        ret = mariaDatabase_->is_connected();
-    }
-
-    return ret; 
+    return mariaDatabase_ && mariaDatabase_->is_connected();
 }
 
 void MariaDB::FnSetDatabaseStatus(bool status)
@@ -81,17 +108,18 @@ bool MariaDB::FnReconnectMariaLocalDatabase()
     {
         Logger::getInstance()->FnLog("Attempting to reconnect to ev_charging_database...", "DB");
 
-        // Reset the unique_ptr to release the current connection
-        mariaDatabase_.reset();
-
-        // Create a new instance and attempt reconnect
-        mariaDatabase_ = std::make_unique<OdbcDatabase>();
+        // Reconnected in place, other threads may be inside the current instance
+        if (!mariaDatabase_)
+        {
+            mariaDatabase_ = std::make_unique<OdbcDatabase>();
+        }
 
         if (mariaDatabase_->connect(DB_DRIVER, DB_SERVER, DB_PORT, DB_NAME, DB_USERNAME, DB_PASSWORD, 2))
         {
             Logger::getInstance()->FnLog("Reconnected to ev_charging_database successfully.", "DB");
             FnSetDatabaseStatus(true);
             FnSetDatabaseRecoveryFlag(false);
+            FnRefreshUnsentCounts();
             return true;
         }
         else
@@ -106,20 +134,13 @@ bool MariaDB::FnReconnectMariaLocalDatabase()
     return true;
 }
 
-bool MariaDB::FnInsertEvLotStatusRecord(const std::string& carpark_code, const std::string& device_ip, const std::string& error_code)
+bool MariaDB::FnInsertEvLotStatusRecord(const std::string& carpark_code, const std::string& device_ip, const std::string& error_code, std::string* idempotency_key)
 {
     bool ret = false;
     Logger::getInstance()->FnLog(__func__, "DB");
 
-    if (!FnIsConnected())
-    {
-        FnSetDatabaseStatus(false);
-        Logger::getInstance()->FnLog("Database is not connected.", "DB");
-        return ret;
-    }
-
     std::ostringstream query;
-    query << "INSERT INTO tbl_ev_lot_status (location_code, device_ip, error_code) VALUES (";
+    query << "INSERT INTO tbl_ev_lot_status (location_code, device_ip, error_code, add_dt, idempotency_key) VALUES (";
     
     if (carpark_code.empty())
     {
@@ -141,18 +162,29 @@ bool MariaDB::FnInsertEvLotStatusRecord(const std::string& carpark_code, const s
 
     if (error_code.empty())
     {
-        query << "NULL)";
+        query << "NULL, ";
     }
     else
     {
-        query << "'" << error_code << "')";
+        query << "'" << error_code << "', ";
     }
 
-    bool result = mariaDatabase_->execute_non_query(query.str());
+    // Time of the event rather than of a journal replay, retention goes by it
+    query << "'" << Common::getInstance()->FnGetDateTimeFormat_YYYY_MM_DD_HH_MM_SS() << "', ";
+
+    std::string key = newIdempotencyKey();
+    query << "'" << key << "') ON DUPLICATE KEY UPDATE id = id";
+
+    bool result = executeWrite(query.str());
 
     if (result)
     {
         Logger::getInstance()->FnLog(query.str(), "DB");
+        if (idempotency_key != nullptr)
+        {
+            *idempotency_key = key;
+        }
+        unsentEvLotStatusCount_.fetch_add(1, std::memory_order_relaxed);
         ret = true;
     }
     else
@@ -190,26 +222,27 @@ bool MariaDB::FnIsEvLotStatusTableEmpty()
         return ret;
     }
 
-    std::string query = "SELECT COUNT(*) FROM tbl_ev_lot_status";
-    int result = mariaDatabase_->select_count(query);
+    // Stops at the first row, a COUNT(*) would scan the whole table
+    std::string query = "SELECT 1 FROM tbl_ev_lot_status";
+    int result = mariaDatabase_->exists(query);
 
     if (result == 0)
     {
         std::stringstream ss;
-        ss << query << ", result: " << result;
+        ss << query << ", exists: " << result;
         Logger::getInstance()->FnLog(ss.str(), "DB");
         ret = true;
     }
     else if (result > 0)
     {
         std::stringstream ss;
-        ss << query << ", result: " << result;
+        ss << query << ", exists: " << result;
         Logger::getInstance()->FnLog(ss.str(), "DB");
         ret = false;
     }
     else
     {
-        Logger::getInstance()->FnLog("Failed to select count query: " + query, "DB");
+        Logger::getInstance()->FnLog("Failed to select exists query: " + query, "DB");
         ret = false;
     }
 
@@ -220,15 +253,8 @@ void MariaDB::FnRemoveAllRecordFromEvLotStatusTable()
 {
     Logger::getInstance()->FnLog(__func__, "DB");
 
-    if (!FnIsConnected())
-    {
-        FnSetDatabaseStatus(false);
-        Logger::getInstance()->FnLog("Database is not connected.", "DB");
-        return;
-    }
-
     std::string query = "DELETE FROM tbl_ev_lot_status";
-    bool result = mariaDatabase_->execute_non_query(query);
+    bool result = executeWrite(query);
 
     if (result)
     {
@@ -240,137 +266,310 @@ void MariaDB::FnRemoveAllRecordFromEvLotStatusTable()
     }
 }
 
-bool MariaDB::FnInsertEvLotTransRecord(const parking_lot_t& lot)
+std::vector<ev_lot_status_record_t> MariaDB::FnSelectUnsentEvLotStatusRecords(int limit, int minAgeSec)
 {
-    bool ret = false;
+    std::vector<ev_lot_status_record_t> records;
     Logger::getInstance()->FnLog(__func__, "DB");
 
     if (!FnIsConnected())
     {
         FnSetDatabaseStatus(false);
         Logger::getInstance()->FnLog("Database is not connected.", "DB");
-        return ret;
+        return records;
     }
 
+    // Range on idx_lot_status_unsent, already in id order. Recent rows are
+    // left alone, their live send may still be in flight.
     std::ostringstream query;
-    query << "INSERT INTO tbl_ev_lot_trans (location_code, lot_no, lpn, lot_in_image, lot_out_image, lot_in_dt, lot_out_dt, add_dt, update_dt, lot_in_central_sent_dt, lot_out_central_sent_dt) VALUES (";
-    
-    if (lot.location_code.empty())
-    {
-        query << "NULL, ";
-    }
-    else
+    query << "SELECT id, location_code, device_ip, error_code FROM tbl_ev_lot_status"
+          << " WHERE central_sent_dt IS NULL AND (add_dt IS NULL OR add_dt < NOW() - INTERVAL " << minAgeSec << " SECOND)"
+          << " ORDER BY id LIMIT " << limit;
+
+    std::vector<std::vector<std::string>> rows = mariaDatabase_->select(query.str());
+    for (const std::vector<std::string>& row : rows)
     {
-        query << "'" << lot.location_code << "', ";
+        if (row.size() < 4)
+        {
+            continue;
+        }
+        records.push_back(ev_lot_status_record_t{std::atoi(row[0].c_str()), row[1], row[2], row[3]});
     }
 
-    if (lot.lot_no.empty())
+    std::stringstream ss;
+    ss << query.str() << ", result: " << records.size();
+    Logger::getInstance()->FnLog(ss.str(), "DB");
+
+    return records;
+}
+
+bool MariaDB::FnMarkEvLotStatusCentralSent(int id)
+{
+    bool ret = false;
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    std::ostringstream query;
+    query << "UPDATE tbl_ev_lot_status SET central_sent_dt = NOW() WHERE id = " << id << " AND central_sent_dt IS NULL";
+
+    long stamped = -1;
+    bool result = executeWrite(query.str(), &stamped);
+
+    if (result)
     {
-        query << "NULL, ";
+        Logger::getInstance()->FnLog(query.str(), "DB");
+        // A row the other send stamped first changes nothing, a journaled stamp is left to the recount after the replay
+        decrementCount(unsentEvLotStatusCount_, std::max(stamped, 0L));
+        ret = true;
     }
     else
     {
-        query << "'" << lot.lot_no << "', ";
+        Logger::getInstance()->FnLog("Failed to execute update query: " + query.str(), "DB");
+        ret = false;
     }
 
-    if (lot.lpn.empty())
+    return ret;
+}
+
+bool MariaDB::FnMarkEvLotStatusCentralSent(const std::string& idempotency_key)
+{
+    bool ret = false;
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    // On uq_lot_status_idempotency_key; journaled behind the insert if that is still waiting
+    std::ostringstream query;
+    query << "UPDATE tbl_ev_lot_status SET central_sent_dt = NOW() WHERE idempotency_key = " << sqlString(idempotency_key) << " AND central_sent_dt IS NULL";
+
+    long stamped = -1;
+    bool result = executeWrite(query.str(), &stamped);
+
+    if (result)
     {
-        query << "NULL, ";
+        Logger::getInstance()->FnLog(query.str(), "DB");
+        decrementCount(unsentEvLotStatusCount_, std::max(stamped, 0L));
+        ret = true;
     }
     else
     {
-        query << "'" << lot.lpn << "', ";
+        Logger::getInstance()->FnLog("Failed to execute update query: " + query.str(), "DB");
+        ret = false;
     }
 
-    if (lot.lot_in_image_path.empty())
+    return ret;
+}
+
+bool MariaDB::FnInsertEvLotTransRecord(const parking_lot_t& lot)
+{
+    bool ret = false;
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    std::ostringstream query;
+    query << "INSERT INTO tbl_ev_lot_trans (location_code, lot_no, lpn, lot_in_image, lot_out_image, lot_in_dt, lot_out_dt, add_dt, update_dt, lot_in_central_sent_dt, lot_out_central_sent_dt, idempotency_key) VALUES (";
+    query << sqlString(lot.location_code.str()) << ", " << sqlString(lot.lot_no.view()) << ", " << sqlString(lot.lpn.view()) << ", "
+          << sqlString(lot.lot_in_image_path) << ", " << sqlString(lot.lot_out_image_path) << ", ";
+
+    // Retention goes by add_dt, a row always has one
+    query << sqlDateTime(lot.lot_in_dt) << ", " << sqlDateTime(lot.lot_out_dt) << ", "
+          << sqlDateTime(isLotTimeSet(lot.add_dt) ? lot.add_dt : std::chrono::system_clock::now()) << ", " << sqlDateTime(lot.update_dt) << ", "
+          << sqlDateTime(lot.lot_in_central_sent_dt) << ", " << sqlDateTime(lot.lot_out_central_sent_dt) << ", ";
+    query << "'" << newIdempotencyKey() << "') ON DUPLICATE KEY UPDATE id = id";
+
+    bool result = executeWrite(query.str());
+
+    if (result)
     {
-        query << "NULL, ";
+        Logger::getInstance()->FnLog(query.str(), "DB");
+        long unsent = ((isLotTimeSet(lot.lot_in_dt) && !isLotTimeSet(lot.lot_in_central_sent_dt)) ? 1 : 0) +
+                      ((isLotTimeSet(lot.lot_out_dt) && !isLotTimeSet(lot.lot_out_central_sent_dt)) ? 1 : 0);
+        unsentEvLotTransCount_.fetch_add(unsent, std::memory_order_relaxed);
+        ret = true;
     }
     else
     {
-        query << "'" << lot.lot_in_image_path << "', ";
+        Logger::getInstance()->FnLog("Failed to execute insert query: " + query.str(), "DB");
+        ret = false;
     }
 
-    if (lot.lot_out_image_path.empty())
-    {
-        query << "NULL, ";
-    }
-    else
+    return ret;
+}
+
+int MariaDB::FnGetLastInsertedIDFromEvLotTransRecord()
+{
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    if (!FnIsConnected())
     {
-        query << "'" << lot.lot_out_image_path << "', ";
+        FnSetDatabaseStatus(false);
+        Logger::getInstance()->FnLog("Database is not connected.", "DB");
+        return -1;
     }
 
-    if (lot.lot_in_dt.empty())
+    return mariaDatabase_->get_last_inserted_id("tbl_ev_lot_trans");
+}
+
+bool MariaDB::FnIsEvLotTransTableEmpty()
+{
+    bool ret = false;
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    if (!FnIsConnected())
     {
-        query << "NULL, ";
+        FnSetDatabaseStatus(false);
+        Logger::getInstance()->FnLog("Database is not connected.", "DB");
+        return ret;
     }
-    else
+
+    // Stops at the first row, a COUNT(*) would scan the whole table
+    std::string query = "SELECT 1 FROM tbl_ev_lot_trans";
+    int result = mariaDatabase_->exists(query);
+
+    if (result == 0)
     {
-        query << "'" << lot.lot_in_dt << "', ";
+        std::stringstream ss;
+        ss << query << ", exists: " << result;
+        Logger::getInstance()->FnLog(ss.str(), "DB");
+        ret = true;
     }
-
-    if (lot.lot_out_dt.empty())
+    else if (result > 0)
     {
-        query << "NULL, ";
+        std::stringstream ss;
+        ss << query << ", exists: " << result;
+        Logger::getInstance()->FnLog(ss.str(), "DB");
+        ret = false;
     }
     else
     {
-        query << "'" << lot.lot_out_dt << "', ";
+        Logger::getInstance()->FnLog("Failed to select exists query: " + query, "DB");
+        ret = false;
     }
 
-    if (lot.add_dt.empty())
+    return ret;
+}
+
+void MariaDB::FnRemoveAllRecordFromEvLotTransTable()
+{
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    std::string query = "DELETE FROM tbl_ev_lot_trans";
+    bool result = executeWrite(query);
+
+    if (result)
     {
-        query << "NULL, ";
+        Logger::getInstance()->FnLog(query, "DB");
     }
     else
     {
-        query << "'" << lot.add_dt << "', ";
+        Logger::getInstance()->FnLog("Failed to delete all query: " + query, "DB");
     }
+}
 
-    if (lot.update_dt.empty())
-    {
-        query << "NULL, ";
-    }
-    else
+std::vector<ev_lot_trans_record_t> MariaDB::FnSelectUnsentEvLotTransRecords(int limit, int minAgeSec)
+{
+    std::vector<ev_lot_trans_record_t> records;
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    if (!FnIsConnected())
     {
-        query << "'" << lot.update_dt << "', ";
+        FnSetDatabaseStatus(false);
+        Logger::getInstance()->FnLog("Database is not connected.", "DB");
+        return records;
     }
 
-    if (lot.lot_in_central_sent_dt.empty())
+    // One branch per sent column so each is a range on its own index
+    // (idx_lot_trans_in_unsent, idx_lot_trans_out_unsent). Recent rows are
+    // left alone, their live send may still be in flight.
+    const std::string columns = "SELECT " + EV_LOT_TRANS_COLUMNS + " FROM tbl_ev_lot_trans";
+    std::ostringstream settled;
+    settled << " AND (COALESCE(update_dt, add_dt) IS NULL OR COALESCE(update_dt, add_dt) < NOW() - INTERVAL " << minAgeSec << " SECOND)";
+
+    std::ostringstream query;
+    query << "(" << columns << " WHERE lot_in_central_sent_dt IS NULL AND lot_in_dt IS NOT NULL" << settled.str() << " ORDER BY id LIMIT " << limit << ")"
+          << " UNION "
+          << "(" << columns << " WHERE lot_out_central_sent_dt IS NULL AND lot_out_dt IS NOT NULL" << settled.str() << " ORDER BY id LIMIT " << limit << ")"
+          << " ORDER BY id LIMIT " << limit;
+
+    records = selectEvLotTransRecords(query.str());
+
+    std::stringstream ss;
+    ss << "Unsent tbl_ev_lot_trans rows, result: " << records.size();
+    Logger::getInstance()->FnLog(ss.str(), "DB");
+
+    return records;
+}
+
+bool MariaDB::FnMarkEvLotTransCentralSent(int id, bool lotIn, bool lotOut)
+{
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    // One statement per column, so the rows changed tell which of them this
+    // stamp sent first. An already stamped column keeps the time of its first
+    // successful send.
+    std::vector<const char*> columns;
+    if (lotIn)
     {
-        query << "NULL, ";
+        columns.push_back("lot_in");
     }
-    else
+    if (lotOut)
     {
-        query << "'" << lot.lot_in_central_sent_dt << "', ";
+        columns.push_back("lot_out");
     }
 
-    if (lot.lot_out_central_sent_dt.empty())
+    for (const char* column : columns)
     {
-        query << "NULL)";
+        std::ostringstream query;
+        query << "UPDATE tbl_ev_lot_trans SET " << column << "_central_sent_dt = NOW() WHERE id = " << id
+              << " AND " << column << "_central_sent_dt IS NULL";
+
+        long stamped = -1;
+        if (!executeWrite(query.str(), &stamped))
+        {
+            Logger::getInstance()->FnLog("Failed to execute update query: " + query.str(), "DB");
+            return false;
+        }
+
+        Logger::getInstance()->FnLog(query.str(), "DB");
+        decrementCount(unsentEvLotTransCount_, std::max(stamped, 0L));
     }
-    else
+
+    return true;
+}
+
+bool MariaDB::FnMarkEvLotTransCentralSent(const std::string& location_code, const std::string& lot_no, lotEvent event, lot_time_t event_dt)
+{
+    bool ret = false;
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    if (!isLotTimeSet(event_dt))
     {
-        query << "'" << lot.lot_out_central_sent_dt << "')";
+        Logger::getInstance()->FnLog("Live send without its event time, left to the resend.", "DB");
+        return false;
     }
 
-    bool result = mariaDatabase_->execute_non_query(query.str());
+    // On idx_lot_trans_lot_session; journaled behind the insert or close if that is still waiting
+    const char* column = (event == lotEvent::ParkOut) ? "lot_out" : "lot_in";
+    std::ostringstream query;
+    query << "UPDATE tbl_ev_lot_trans SET " << column << "_central_sent_dt = NOW()"
+          << " WHERE location_code <=> " << sqlString(location_code) << " AND lot_no <=> " << sqlString(lot_no)
+          << " AND " << column << "_dt = " << sqlDateTime(event_dt) << " AND " << column << "_central_sent_dt IS NULL";
+
+    long stamped = -1;
+    bool result = executeWrite(query.str(), &stamped);
 
     if (result)
     {
         Logger::getInstance()->FnLog(query.str(), "DB");
+        // No row when the resend stamped it first or the time did not match
+        decrementCount(unsentEvLotTransCount_, std::max(stamped, 0L));
         ret = true;
     }
     else
     {
-        Logger::getInstance()->FnLog("Failed to execute insert query: " + query.str(), "DB");
+        Logger::getInstance()->FnLog("Failed to execute update query: " + query.str(), "DB");
         ret = false;
     }
 
     return ret;
 }
 
-int MariaDB::FnGetLastInsertedIDFromEvLotTransRecord()
+bool MariaDB::FnSelectOpenEvLotTransRecord(const std::string& location_code, const std::string& lot_no, ev_lot_trans_record_t& record)
 {
     Logger::getInstance()->FnLog(__func__, "DB");
 
@@ -378,70 +577,837 @@ int MariaDB::FnGetLastInsertedIDFromEvLotTransRecord()
     {
         FnSetDatabaseStatus(false);
         Logger::getInstance()->FnLog("Database is not connected.", "DB");
-        return -1;
+        return false;
     }
 
-    return mariaDatabase_->get_last_inserted_id("tbl_ev_lot_trans");
+    // Equality on idx_lot_trans_lot_session, read backwards for the latest park in
+    std::ostringstream query;
+    query << "SELECT " << EV_LOT_TRANS_COLUMNS << " FROM tbl_ev_lot_trans"
+          << " WHERE location_code <=> " << sqlString(location_code) << " AND lot_no <=> " << sqlString(lot_no) << " AND lot_out_dt IS NULL"
+          << " ORDER BY lot_in_dt DESC LIMIT 1";
+
+    std::vector<ev_lot_trans_record_t> records = selectEvLotTransRecords(query.str());
+
+    std::stringstream ss;
+    ss << query.str() << ", result: " << records.size();
+    Logger::getInstance()->FnLog(ss.str(), "DB");
+
+    if (records.empty())
+    {
+        return false;
+    }
+    record = std::move(records.front());
+    return true;
 }
 
-bool MariaDB::FnIsEvLotTransTableEmpty()
+std::vector<ev_lot_trans_record_t> MariaDB::FnSelectOpenEvLotTransRecords(const std::string& location_code)
 {
-    bool ret = false;
+    std::vector<ev_lot_trans_record_t> records;
     Logger::getInstance()->FnLog(__func__, "DB");
 
     if (!FnIsConnected())
     {
         FnSetDatabaseStatus(false);
         Logger::getInstance()->FnLog("Database is not connected.", "DB");
-        return ret;
+        return records;
     }
 
-    std::string query = "SELECT COUNT(*) FROM tbl_ev_lot_trans";
-    int result = mariaDatabase_->select_count(query);
+    // Prefix of idx_lot_trans_lot_session, lot_out_dt IS NULL checked within the index
+    std::ostringstream query;
+    query << "SELECT " << EV_LOT_TRANS_COLUMNS << " FROM tbl_ev_lot_trans"
+          << " WHERE location_code <=> " << sqlString(location_code) << " AND lot_out_dt IS NULL AND lot_in_dt IS NOT NULL"
+          << " ORDER BY lot_in_dt";
+
+    records = selectEvLotTransRecords(query.str());
 
-    if (result == 0)
+    std::stringstream ss;
+    ss << query.str() << ", result: " << records.size();
+    Logger::getInstance()->FnLog(ss.str(), "DB");
+
+    return records;
+}
+
+bool MariaDB::FnSelectLatestEvLotTransRecordByLpn(const std::string& lpn, ev_lot_trans_record_t& record)
+{
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    if (!FnIsConnected())
     {
-        std::stringstream ss;
-        ss << query << ", result: " << result;
-        Logger::getInstance()->FnLog(ss.str(), "DB");
-        ret = true;
+        FnSetDatabaseStatus(false);
+        Logger::getInstance()->FnLog("Database is not connected.", "DB");
+        return false;
     }
-    else if (result > 0)
+
+    // Backwards on idx_lot_trans_lpn_in
+    std::ostringstream query;
+    query << "SELECT " << EV_LOT_TRANS_COLUMNS << " FROM tbl_ev_lot_trans"
+          << " WHERE lpn = " << sqlString(lpn) << " ORDER BY lot_in_dt DESC LIMIT 1";
+
+    std::vector<ev_lot_trans_record_t> records = selectEvLotTransRecords(query.str());
+
+    std::stringstream ss;
+    ss << query.str() << ", result: " << records.size();
+    Logger::getInstance()->FnLog(ss.str(), "DB");
+
+    if (records.empty())
     {
-        std::stringstream ss;
-        ss << query << ", result: " << result;
-        Logger::getInstance()->FnLog(ss.str(), "DB");
-        ret = false;
+        return false;
     }
-    else
+    record = std::move(records.front());
+    return true;
+}
+
+bool MariaDB::FnCloseEvLotTransRecord(const parking_lot_t& lot)
+{
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    if (!isLotTimeSet(lot.lot_out_dt))
     {
-        Logger::getInstance()->FnLog("Failed to select count query: " + query, "DB");
-        ret = false;
+        Logger::getInstance()->FnLog("Park out without lot_out_dt, not recorded.", "DB");
+        return false;
     }
 
-    return ret;
+    std::string lotOutDt = sqlDateTime(lot.lot_out_dt);
+    std::string locationCode = sqlString(lot.location_code.str());
+    std::string lotNo = sqlString(lot.lot_no.view());
+    std::string updateDt = sqlDateTime(isLotTimeSet(lot.update_dt) ? lot.update_dt : lot.lot_out_dt);
+    std::string addDt = sqlDateTime(isLotTimeSet(lot.add_dt) ? lot.add_dt : lot.lot_out_dt);
+
+    // The latest open session that began before this park out, found on
+    // idx_lot_trans_lot_session; only while no row of the lot holds this park
+    // out yet. A replay running it twice would otherwise close the next older
+    // stale session as well. The derived table (kept from merging by its
+    // LIMIT) lets the update read the table it changes.
+    std::ostringstream update;
+    update << "UPDATE tbl_ev_lot_trans SET lot_out_image = " << sqlString(lot.lot_out_image_path) << ", lot_out_dt = " << lotOutDt
+           << ", lpn = COALESCE(lpn, " << sqlString(lot.lpn.view()) << "), update_dt = " << updateDt
+           << " WHERE location_code <=> " << locationCode << " AND lot_no <=> " << lotNo << " AND lot_out_dt IS NULL AND lot_in_dt <= " << lotOutDt
+           << " AND NOT EXISTS (SELECT 1 FROM (SELECT id FROM tbl_ev_lot_trans WHERE location_code <=> " << locationCode << " AND lot_no <=> " << lotNo
+           << " AND lot_out_dt = " << lotOutDt << " LIMIT 1) closed)"
+           << " ORDER BY lot_in_dt DESC LIMIT 1";
+
+    // Only if the update found no session to close, decided by the
+    // database so it holds for journaled writes as well
+    std::ostringstream insert;
+    insert << "INSERT INTO tbl_ev_lot_trans (location_code, lot_no, lpn, lot_out_image, lot_out_dt, add_dt, idempotency_key)"
+           << " SELECT " << locationCode << ", " << lotNo << ", " << sqlString(lot.lpn.view()) << ", " << sqlString(lot.lot_out_image_path) << ", " << lotOutDt
+           << ", " << addDt << ", '" << newIdempotencyKey() << "' FROM DUAL"
+           << " WHERE NOT EXISTS (SELECT 1 FROM tbl_ev_lot_trans WHERE location_code <=> " << locationCode << " AND lot_no <=> " << lotNo
+           << " AND lot_out_dt = " << lotOutDt << ") ON DUPLICATE KEY UPDATE id = id";
+
+    if (!executeWrite(update.str()))
+    {
+        Logger::getInstance()->FnLog("Failed to execute update query: " + update.str(), "DB");
+        return false;
+    }
+    Logger::getInstance()->FnLog(update.str(), "DB");
+
+    if (!executeWrite(insert.str()))
+    {
+        Logger::getInstance()->FnLog("Failed to execute insert query: " + insert.str(), "DB");
+        return false;
+    }
+    Logger::getInstance()->FnLog(insert.str(), "DB");
+
+    // The park out to send, whichever row ended up holding it
+    unsentEvLotTransCount_.fetch_add(1, std::memory_order_relaxed);
+    return true;
 }
 
-void MariaDB::FnRemoveAllRecordFromEvLotTransTable()
+bool MariaDB::FnSelectEvLotTransImageReferences(const std::string& prefix, std::vector<std::pair<std::string, long>>& references)
 {
     Logger::getInstance()->FnLog(__func__, "DB");
+    references.clear();
 
     if (!FnIsConnected())
     {
         FnSetDatabaseStatus(false);
         Logger::getInstance()->FnLog("Database is not connected.", "DB");
-        return;
+        return false;
     }
 
-    std::string query = "DELETE FROM tbl_ev_lot_trans";
-    bool result = mariaDatabase_->execute_non_query(query);
+    if (prefix.empty())
+    {
+        return false;
+    }
 
-    if (result)
+    // Ranges on idx_lot_trans_in_image and idx_lot_trans_out_image, from the
+    // prefix up to the string right after every path starting with it
+    std::string upper = prefix;
+    upper.back()++;
+    std::string from = sqlString(prefix);
+    std::string to = sqlString(upper);
+
+    std::ostringstream query;
+    query << "SELECT image, COUNT(*) FROM ("
+          << "SELECT lot_in_image AS image FROM tbl_ev_lot_trans WHERE lot_in_image >= " << from << " AND lot_in_image < " << to
+          << " UNION ALL SELECT lot_out_image FROM tbl_ev_lot_trans WHERE lot_out_image >= " << from << " AND lot_out_image < " << to
+          << ") refs GROUP BY image";
+
+    // A failed select must not look like images nobody refers to
+    std::vector<std::vector<std::string>> rows;
+    if (!mariaDatabase_->select(query.str(), rows))
     {
-        Logger::getInstance()->FnLog(query, "DB");
+        Logger::getInstance()->FnLog("Failed to select the image references: " + query.str(), "DB");
+        return false;
     }
-    else
+
+    for (const std::vector<std::string>& row : rows)
     {
-        Logger::getInstance()->FnLog("Failed to delete all query: " + query, "DB");
+        if (row.size() < 2)
+        {
+            continue;
+        }
+        references.emplace_back(row[0], std::atol(row[1].c_str()));
+    }
+
+    std::stringstream ss;
+    ss << query.str() << ", result: " << references.size();
+    Logger::getInstance()->FnLog(ss.str(), "DB");
+    return true;
+}
+
+bool MariaDB::FnInsertEvLotHoggingRecord(const lot_hogging_t& hogging, bool* existed)
+{
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    // A session is flagged once, the unique session key drops a repeat after a restart or replay
+    std::ostringstream query;
+    query << "INSERT INTO tbl_ev_lot_hogging (location_code, lot_no, lpn, policy, reason, lot_in_dt, hogging_dt, add_dt) VALUES ("
+          << sqlString(hogging.location_code.str()) << ", " << sqlString(hogging.lot_no.view()) << ", " << sqlString(hogging.lpn.view()) << ", "
+          << sqlString(hogging.policy) << ", " << sqlString(hoggingReasonName(hogging.reason)) << ", "
+          << sqlDateTime(hogging.lot_in_dt) << ", " << sqlDateTime(hogging.hogging_dt) << ", " << sqlDateTime(hogging.hogging_dt)
+          << ") ON DUPLICATE KEY UPDATE id = id";
+
+    long inserted = -1;
+    if (!executeWrite(query.str(), &inserted))
+    {
+        Logger::getInstance()->FnLog("Failed to execute insert query: " + query.str(), "DB");
+        return false;
+    }
+
+    Logger::getInstance()->FnLog(query.str(), "DB");
+    if (existed != nullptr)
+    {
+        *existed = (inserted == 0);
+    }
+    // No row for a session flagged before, a journaled insert counts until the recount after the replay
+    unsentEvLotHoggingCount_.fetch_add((inserted < 0) ? 1 : inserted, std::memory_order_relaxed);
+    return true;
+}
+
+std::vector<ev_lot_hogging_record_t> MariaDB::FnSelectUnsentEvLotHoggingRecords(int limit, int minAgeSec)
+{
+    std::vector<ev_lot_hogging_record_t> records;
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    if (!FnIsConnected())
+    {
+        FnSetDatabaseStatus(false);
+        Logger::getInstance()->FnLog("Database is not connected.", "DB");
+        return records;
+    }
+
+    // Range on idx_lot_hogging_unsent, already in id order. Recent rows are
+    // left alone, their live send may still be in flight.
+    std::ostringstream query;
+    query << "SELECT id, location_code, lot_no, lpn, policy, reason, lot_in_dt, hogging_dt FROM tbl_ev_lot_hogging"
+          << " WHERE central_sent_dt IS NULL AND add_dt < NOW() - INTERVAL " << minAgeSec << " SECOND"
+          << " ORDER BY id LIMIT " << limit;
+
+    std::vector<std::vector<std::string>> rows = mariaDatabase_->select(query.str());
+    for (const std::vector<std::string>& row : rows)
+    {
+        if (row.size() < 8)
+        {
+            continue;
+        }
+
+        ev_lot_hogging_record_t record;
+        record.id = std::atoi(row[0].c_str());
+        lot_hogging_t& hogging = record.hogging;
+        hogging.location_code = LocationCode(row[1]);
+        hogging.lot_no = row[2];
+        hogging.lpn = row[3];
+        hogging.policy = row[4];
+        hogging.reason = hoggingReasonFromName(row[5]);
+        hogging.lot_in_dt = Common::getInstance()->FnParseDateTime_YYYY_MM_DD_HH_MM_SS(row[6]);
+        hogging.hogging_dt = Common::getInstance()->FnParseDateTime_YYYY_MM_DD_HH_MM_SS(row[7]);
+        records.push_back(std::move(record));
+    }
+
+    std::stringstream ss;
+    ss << query.str() << ", result: " << records.size();
+    Logger::getInstance()->FnLog(ss.str(), "DB");
+
+    return records;
+}
+
+bool MariaDB::FnMarkEvLotHoggingCentralSent(int id)
+{
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    std::ostringstream query;
+    query << "UPDATE tbl_ev_lot_hogging SET central_sent_dt = NOW() WHERE id = " << id << " AND central_sent_dt IS NULL";
+
+    long stamped = -1;
+    if (!executeWrite(query.str(), &stamped))
+    {
+        Logger::getInstance()->FnLog("Failed to execute update query: " + query.str(), "DB");
+        return false;
+    }
+
+    Logger::getInstance()->FnLog(query.str(), "DB");
+    decrementCount(unsentEvLotHoggingCount_, std::max(stamped, 0L));
+    return true;
+}
+
+bool MariaDB::FnMarkEvLotHoggingCentralSent(const std::string& location_code, const std::string& lot_no, lot_time_t lot_in_dt)
+{
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    // On uq_lot_hogging_session; journaled behind the insert if that is still waiting
+    std::ostringstream query;
+    query << "UPDATE tbl_ev_lot_hogging SET central_sent_dt = NOW()"
+          << " WHERE location_code <=> " << sqlString(location_code) << " AND lot_no <=> " << sqlString(lot_no)
+          << " AND lot_in_dt <=> " << sqlDateTime(lot_in_dt) << " AND central_sent_dt IS NULL";
+
+    long stamped = -1;
+    if (!executeWrite(query.str(), &stamped))
+    {
+        Logger::getInstance()->FnLog("Failed to execute update query: " + query.str(), "DB");
+        return false;
+    }
+
+    Logger::getInstance()->FnLog(query.str(), "DB");
+    decrementCount(unsentEvLotHoggingCount_, std::max(stamped, 0L));
+    return true;
+}
+
+bool MariaDB::FnUpsertEvLotStatsHourlyRecords(const std::string& location_code, const std::vector<lot_stats_hourly_t>& rows)
+{
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    if (rows.empty())
+    {
+        return true;
+    }
+
+    // One statement for the whole flush, totals make a repeated write harmless
+    std::ostringstream query;
+    query << "INSERT INTO tbl_ev_lot_stats_hourly (location_code, lot_no, hour_start, park_ins, park_outs, hoggings, occupied_sec,"
+          << " dwell_count, dwell_sum_sec, dwell_histogram, update_dt) VALUES ";
+    for (std::size_t i = 0; i < rows.size(); i++)
+    {
+        const lot_stats_hourly_t& row = rows[i];
+        std::ostringstream histogram;
+        for (std::size_t bucket = 0; bucket < row.dwell_histogram.size(); bucket++)
+        {
+            histogram << (bucket ? "," : "") << row.dwell_histogram[bucket];
+        }
+
+        query << (i ? ", (" : "(") << sqlString(location_code) << ", " << sqlString(row.lot_no.view()) << ", " << sqlDateTime(row.hour_start) << ", "
+              << row.park_ins << ", " << row.park_outs << ", " << row.hoggings << ", " << row.occupied_sec << ", "
+              << row.dwell_count << ", " << row.dwell_sum_sec << ", '" << histogram.str() << "', " << sqlDateTime(row.update_dt) << ")";
+    }
+    query << " ON DUPLICATE KEY UPDATE park_ins = VALUES(park_ins), park_outs = VALUES(park_outs), hoggings = VALUES(hoggings),"
+          << " occupied_sec = VALUES(occupied_sec), dwell_count = VALUES(dwell_count), dwell_sum_sec = VALUES(dwell_sum_sec),"
+          << " dwell_histogram = VALUES(dwell_histogram), update_dt = VALUES(update_dt)";
+
+    if (!executeWrite(query.str()))
+    {
+        Logger::getInstance()->FnLog("Failed to execute upsert of " + std::to_string(rows.size()) + " hourly lot statistics rows.", "DB");
+        return false;
+    }
+    return true;
+}
+
+std::vector<lot_stats_hourly_t> MariaDB::FnSelectEvLotStatsHourlyRecords(const std::string& location_code, const std::string& lot_no,
+                                                                        lot_time_t hourFrom, lot_time_t hourTo)
+{
+    std::vector<lot_stats_hourly_t> records;
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    if (!FnIsConnected())
+    {
+        FnSetDatabaseStatus(false);
+        Logger::getInstance()->FnLog("Database is not connected.", "DB");
+        return records;
     }
-}
\ No newline at end of file
+
+    std::ostringstream query;
+    query << "SELECT lot_no, hour_start, park_ins, park_outs, hoggings, occupied_sec, dwell_count, dwell_sum_sec, dwell_histogram, update_dt"
+          << " FROM tbl_ev_lot_stats_hourly WHERE location_code <=> " << sqlString(location_code);
+    if (!lot_no.empty())
+    {
+        query << " AND lot_no = " << sqlString(lot_no);
+    }
+    query << " AND hour_start BETWEEN " << sqlDateTime(hourFrom) << " AND " << sqlDateTime(hourTo) << " ORDER BY hour_start, lot_no";
+
+    std::vector<std::vector<std::string>> rows = mariaDatabase_->select(query.str());
+    for (const std::vector<std::string>& row : rows)
+    {
+        if (row.size() < 10)
+        {
+            continue;
+        }
+
+        lot_stats_hourly_t record;
+        record.lot_no = row[0];
+        record.hour_start = Common::getInstance()->FnParseDateTime_YYYY_MM_DD_HH_MM_SS(row[1]);
+        record.park_ins = static_cast<std::uint32_t>(std::strtoul(row[2].c_str(), nullptr, 10));
+        record.park_outs = static_cast<std::uint32_t>(std::strtoul(row[3].c_str(), nullptr, 10));
+        record.hoggings = static_cast<std::uint32_t>(std::strtoul(row[4].c_str(), nullptr, 10));
+        record.occupied_sec = static_cast<std::uint32_t>(std::strtoul(row[5].c_str(), nullptr, 10));
+        record.dwell_count = static_cast<std::uint32_t>(std::strtoul(row[6].c_str(), nullptr, 10));
+        record.dwell_sum_sec = std::strtoull(row[7].c_str(), nullptr, 10);
+        std::istringstream histogram(row[8]);
+        std::string count;
+        for (std::size_t bucket = 0; (bucket < record.dwell_histogram.size()) && std::getline(histogram, count, ','); bucket++)
+        {
+            record.dwell_histogram[bucket] = static_cast<std::uint32_t>(std::strtoul(count.c_str(), nullptr, 10));
+        }
+        record.update_dt = Common::getInstance()->FnParseDateTime_YYYY_MM_DD_HH_MM_SS(row[9]);
+        records.push_back(record);
+    }
+
+    std::stringstream ss;
+    ss << "Hourly lot statistics rows, result: " << records.size();
+    Logger::getInstance()->FnLog(ss.str(), "DB");
+    return records;
+}
+
+bool MariaDB::FnIsTablePartitioned(const std::string& table)
+{
+    if (!FnIsConnected())
+    {
+        FnSetDatabaseStatus(false);
+        Logger::getInstance()->FnLog("Database is not connected.", "DB");
+        return false;
+    }
+
+    std::string query = "SELECT COUNT(*) FROM information_schema.PARTITIONS"
+                        " WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = '" + table + "' AND PARTITION_NAME IS NOT NULL";
+    return mariaDatabase_->select_count(query) > 0;
+}
+
+bool MariaDB::FnMaintainMonthlyPartitions(const std::string& table, int retentionDays, int monthsAhead)
+{
+    Logger::getInstance()->FnLog(__func__, "DB");
+
+    if (!FnIsConnected())
+    {
+        FnSetDatabaseStatus(false);
+        Logger::getInstance()->FnLog("Database is not connected.", "DB");
+        return false;
+    }
+
+    const std::string partitions = "SELECT PARTITION_NAME, PARTITION_DESCRIPTION FROM information_schema.PARTITIONS"
+                                   " WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = '" + table + "' AND PARTITION_NAME IS NOT NULL";
+
+    // Partitions are ranges of TO_DAYS(add_dt), the catch-all MAXVALUE one is split to add a month
+    std::string maxPartition;
+    long highestBound = 0;
+    for (const std::vector<std::string>& row : mariaDatabase_->select(partitions))
+    {
+        if (row.size() < 2)
+        {
+            continue;
+        }
+        if (row[1] == "MAXVALUE")
+        {
+            maxPartition = row[0];
+        }
+        else
+        {
+            highestBound = std::max(highestBound, std::atol(row[1].c_str()));
+        }
+    }
+
+    for (int month = 0; month <= monthsAhead; month++)
+    {
+        // Name and bound from the server, the same calendar TO_DAYS(add_dt) uses
+        std::ostringstream bounds;
+        bounds << "SELECT DATE_FORMAT(NOW() + INTERVAL " << month << " MONTH, '%Y%m'),"
+               << " TO_DAYS(DATE_FORMAT(NOW() + INTERVAL " << (month + 1) << " MONTH, '%Y-%m-01'))";
+        std::vector<std::vector<std::string>> rows = mariaDatabase_->select(bounds.str());
+        if (rows.empty() || (rows.front().size() < 2))
+        {
+            Logger::getInstance()->FnLog("Failed to select partition bounds: " + bounds.str(), "DB");
+            return false;
+        }
+
+        long bound = std::atol(rows.front()[1].c_str());
+        if (bound <= highestBound)
+        {
+            continue;
+        }
+
+        std::ostringstream alter;
+        alter << "ALTER TABLE " << table;
+        if (maxPartition.empty())
+        {
+            alter << " ADD PARTITION (PARTITION p_" << rows.front()[0] << " VALUES LESS THAN (" << bound << "))";
+        }
+        else
+        {
+            alter << " REORGANIZE PARTITION " << maxPartition << " INTO (PARTITION p_" << rows.front()[0] << " VALUES LESS THAN (" << bound << "),"
+                  << " PARTITION " << maxPartition << " VALUES LESS THAN MAXVALUE)";
+        }
+
+        if (mariaDatabase_->execute_update(alter.str()) < 0)
+        {
+            Logger::getInstance()->FnLog("Failed to add partition: " + alter.str(), "DB");
+            return false;
+        }
+        Logger::getInstance()->FnLog(alter.str(), "DB");
+        highestBound = bound;
+    }
+
+    // A partition bounded at or before the cutoff holds expired rows only
+    std::ostringstream expired;
+    expired << partitions << " AND PARTITION_DESCRIPTION <> 'MAXVALUE'"
+            << " AND CAST(PARTITION_DESCRIPTION AS UNSIGNED) <= TO_DAYS(NOW() - INTERVAL " << retentionDays << " DAY)";
+    for (const std::vector<std::string>& row : mariaDatabase_->select(expired.str()))
+    {
+        if (row.empty())
+        {
+            continue;
+        }
+
+        std::string drop = "ALTER TABLE " + table + " DROP PARTITION " + row[0];
+        if (mariaDatabase_->execute_update(drop) < 0)
+        {
+            Logger::getInstance()->FnLog("Failed to drop partition: " + drop, "DB");
+            return false;
+        }
+        Logger::getInstance()->FnLog(drop, "DB");
+    }
+
+    return true;
+}
+
+long MariaDB::FnPurgeExpiredRecords(const std::string& table, const std::string& timeColumn, int retentionDays, int limit)
+{
+    if (!FnIsConnected())
+    {
+        FnSetDatabaseStatus(false);
+        Logger::getInstance()->FnLog("Database is not connected.", "DB");
+        return -1;
+    }
+
+    // A range on the (timeColumn, id) index, only the rows of this chunk are locked
+    std::ostringstream query;
+    query << "DELETE FROM " << table << " WHERE " << timeColumn << " < NOW() - INTERVAL " << retentionDays << " DAY ORDER BY "
+          << timeColumn << ", id LIMIT " << limit;
+
+    long deleted = mariaDatabase_->execute_update(query.str());
+    if (deleted < 0)
+    {
+        Logger::getInstance()->FnLog("Failed to execute purge query: " + query.str(), "DB");
+    }
+    return deleted;
+}
+
+long MariaDB::FnGetUnsentEvLotStatusCount() const
+{
+    return unsentEvLotStatusCount_.load(std::memory_order_relaxed);
+}
+
+long MariaDB::FnGetUnsentEvLotTransCount() const
+{
+    return unsentEvLotTransCount_.load(std::memory_order_relaxed);
+}
+
+long MariaDB::FnGetUnsentEvLotHoggingCount() const
+{
+    return unsentEvLotHoggingCount_.load(std::memory_order_relaxed);
+}
+
+void MariaDB::FnRefreshUnsentCounts()
+{
+    // Journaled writes were counted when made but are not in the tables yet,
+    // the replay recounts once the journal is drained
+    if (!FnIsConnected() || !journal_.FnIsEmpty())
+    {
+        return;
+    }
+
+    // Ranges on the unsent indexes, as small as the backlog
+    int status = mariaDatabase_->select_count("SELECT COUNT(*) FROM tbl_ev_lot_status WHERE central_sent_dt IS NULL");
+    int trans = mariaDatabase_->select_count("SELECT (SELECT COUNT(*) FROM tbl_ev_lot_trans WHERE lot_in_central_sent_dt IS NULL AND lot_in_dt IS NOT NULL)"
+                                             " + (SELECT COUNT(*) FROM tbl_ev_lot_trans WHERE lot_out_central_sent_dt IS NULL AND lot_out_dt IS NOT NULL)");
+    int hogging = mariaDatabase_->select_count("SELECT COUNT(*) FROM tbl_ev_lot_hogging WHERE central_sent_dt IS NULL");
+    if ((status < 0) || (trans < 0) || (hogging < 0))
+    {
+        Logger::getInstance()->FnLog("Failed to count the unsent rows.", "DB");
+        return;
+    }
+
+    unsentEvLotStatusCount_.store(status, std::memory_order_relaxed);
+    unsentEvLotTransCount_.store(trans, std::memory_order_relaxed);
+    unsentEvLotHoggingCount_.store(hogging, std::memory_order_relaxed);
+
+    std::ostringstream oss;
+    oss << "Unsent rows, tbl_ev_lot_status: " << status << ", tbl_ev_lot_trans: " << trans << ", tbl_ev_lot_hogging: " << hogging;
+    Logger::getInstance()->FnLog(oss.str(), "DB");
+}
+
+void MariaDB::decrementCount(std::atomic<long>& count, long by)
+{
+    // Never below zero, a stamp may cover a row counted before a refresh
+    long current = count.load(std::memory_order_relaxed);
+    while (!count.compare_exchange_weak(current, std::max(current - by, 0L), std::memory_order_relaxed))
+    {
+    }
+}
+
+std::size_t MariaDB::FnGetJournalPendingCount() const
+{
+    return journal_.FnGetPendingCount();
+}
+
+std::string MariaDB::newIdempotencyKey()
+{
+    return idempotencyPrefix_ + "-" + std::to_string(idempotencySequence_.fetch_add(1, std::memory_order_relaxed));
+}
+
+std::string MariaDB::sqlString(std::string_view value)
+{
+    if (value.empty())
+    {
+        return "NULL";
+    }
+
+    std::string literal = "'";
+    for (char c : value)
+    {
+        if ((c == '\'') || (c == '\\'))
+        {
+            literal += '\\';
+        }
+        literal += c;
+    }
+    literal += "'";
+    return literal;
+}
+
+std::string MariaDB::sqlDateTime(lot_time_t value)
+{
+    if (!isLotTimeSet(value))
+    {
+        return "NULL";
+    }
+    return "'" + Common::getInstance()->FnFormatDateTime_YYYY_MM_DD_HH_MM_SS(value) + "'";
+}
+
+std::vector<ev_lot_trans_record_t> MariaDB::selectEvLotTransRecords(const std::string& query)
+{
+    std::vector<ev_lot_trans_record_t> records;
+
+    std::vector<std::vector<std::string>> rows = mariaDatabase_->select(query);
+    for (const std::vector<std::string>& row : rows)
+    {
+        if (row.size() < 12)
+        {
+            continue;
+        }
+
+        ev_lot_trans_record_t record;
+        record.id = std::atoi(row[0].c_str());
+        parking_lot_t& lot = record.lot;
+        lot.location_code = LocationCode(row[1]);
+        lot.lot_no = row[2];
+        lot.lpn = row[3];
+        lot.lot_in_image_path = row[4];
+        lot.lot_out_image_path = row[5];
+        lot.lot_in_dt = Common::getInstance()->FnParseDateTime_YYYY_MM_DD_HH_MM_SS(row[6]);
+        lot.lot_out_dt = Common::getInstance()->FnParseDateTime_YYYY_MM_DD_HH_MM_SS(row[7]);
+        lot.add_dt = Common::getInstance()->FnParseDateTime_YYYY_MM_DD_HH_MM_SS(row[8]);
+        lot.update_dt = Common::getInstance()->FnParseDateTime_YYYY_MM_DD_HH_MM_SS(row[9]);
+        lot.lot_in_central_sent_dt = Common::getInstance()->FnParseDateTime_YYYY_MM_DD_HH_MM_SS(row[10]);
+        lot.lot_out_central_sent_dt = Common::getInstance()->FnParseDateTime_YYYY_MM_DD_HH_MM_SS(row[11]);
+        lot.event = isLotTimeSet(lot.lot_out_dt) ? lotEvent::ParkOut : lotEvent::ParkIn;
+        records.push_back(std::move(record));
+    }
+    return records;
+}
+
+bool MariaDB::executeWrite(const std::string& query, long* affectedRows)
+{
+    if (affectedRows != nullptr)
+    {
+        *affectedRows = -1;
+    }
+
+    // Behind journaled writes a new one waits its turn, the order is kept. The
+    // check and the execute or append go together, or a write could run
+    // directly while one before it is being journaled.
+    std::lock_guard<std::mutex> lock(writeOrderMutex_);
+    if (journal_.FnIsEmpty())
+    {
+        if (FnIsConnected())
+        {
+            long affected = mariaDatabase_->execute_update(query);
+            if (affected >= 0)
+            {
+                if (affectedRows != nullptr)
+                {
+                    *affectedRows = affected;
+                }
+                return true;
+            }
+
+            // The statement failed, not the connection
+            if (FnIsConnected())
+            {
+                return false;
+            }
+        }
+        FnSetDatabaseStatus(false);
+    }
+
+    if (journal_.FnAppend(query))
+    {
+        Logger::getInstance()->FnLog("Database is not available, write journaled: " + query, "DB");
+        return true;
+    }
+
+    Logger::getInstance()->FnLog("Database is not available and the write journal is full, write lost: " + query, "DB");
+    return false;
+}
+
+void MariaDB::FnDatabaseMonitorInitialization(boost::asio::io_context& io_context)
+{
+    pMonitorStrand_ = std::make_unique<boost::asio::strand<boost::asio::io_context::executor_type>>(io_context.get_executor());
+    pHealthTimer_ = std::make_unique<boost::asio::steady_timer>(*pMonitorStrand_);
+    pReplayTimer_ = std::make_unique<boost::asio::steady_timer>(*pMonitorStrand_);
+
+    boost::asio::post(*pMonitorStrand_, [this]() {
+        scheduleHealthCheck(std::chrono::milliseconds(0));
+        scheduleJournalReplay(std::chrono::milliseconds(0));
+    });
+}
+
+void MariaDB::scheduleHealthCheck(std::chrono::milliseconds delay)
+{
+    pHealthTimer_->expires_after(delay);
+    pHealthTimer_->async_wait(boost::asio::bind_executor(*pMonitorStrand_, [this](const boost::system::error_code& ec) {
+        if (ec)
+        {
+            return;
+        }
+        checkHealth();
+    }));
+}
+
+void MariaDB::checkHealth()
+{
+    const IniConfig* config = IniParser::getInstance()->FnGetConfig();
+    std::chrono::milliseconds reconnectBase(std::max(config->databaseReconnectBaseMs, 100));
+    std::chrono::milliseconds reconnectMax(std::max(config->databaseReconnectMaxMs, config->databaseReconnectBaseMs));
+
+    if (FnIsConnected())
+    {
+        // Statements keep the flag current while there is traffic, only an idle connection costs a round trip
+        if (std::chrono::steady_clock::now() - mariaDatabase_->last_success() >= std::chrono::milliseconds(config->databaseKeepaliveIntervalMs))
+        {
+            mariaDatabase_->ping();
+        }
+
+        if (FnIsConnected())
+        {
+            reconnectDelay_ = std::chrono::milliseconds(0);
+            scheduleHealthCheck(reconnectBase);
+            return;
+        }
+        FnSetDatabaseStatus(false);
+    }
+
+    if (FnReconnectMariaLocalDatabase())
+    {
+        reconnectDelay_ = std::chrono::milliseconds(0);
+        // Writes journaled during the outage go out now, not at the next replay interval
+        scheduleJournalReplay(std::chrono::milliseconds(0));
+        scheduleHealthCheck(reconnectBase);
+        return;
+    }
+
+    reconnectDelay_ = (reconnectDelay_.count() == 0) ? reconnectBase : std::min(reconnectDelay_ * 2, reconnectMax);
+    std::ostringstream oss;
+    oss << "Next reconnect attempt in " << reconnectDelay_.count() << " ms.";
+    Logger::getInstance()->FnLog(oss.str(), "DB");
+    scheduleHealthCheck(reconnectDelay_);
+}
+
+void MariaDB::scheduleJournalReplay(std::chrono::milliseconds delay)
+{
+    pReplayTimer_->expires_after(delay);
+    pReplayTimer_->async_wait(boost::asio::bind_executor(*pMonitorStrand_, [this](const boost::system::error_code& ec) {
+        if (ec)
+        {
+            return;
+        }
+        replayJournal();
+    }));
+}
+
+void MariaDB::replayJournal()
+{
+    const IniConfig* config = IniParser::getInstance()->FnGetConfig();
+    std::chrono::milliseconds interval(config->databaseJournalReplayIntervalMs);
+
+    if (journal_.FnIsEmpty())
+    {
+        scheduleJournalReplay(interval);
+        return;
+    }
+
+    // Reconnecting is left to the health check, it resumes the replay
+    if (!FnIsConnected())
+    {
+        scheduleJournalReplay(interval);
+        return;
+    }
+
+    std::vector<std::string> records = journal_.FnPeek(static_cast<std::size_t>(std::max(config->databaseJournalReplayBatch, 1)));
+    std::size_t applied = 0;
+    for (const std::string& query : records)
+    {
+        std::string sqlState;
+        if (!mariaDatabase_->execute_non_query(query, &sqlState))
+        {
+            if (!FnIsConnected())
+            {
+                break;
+            }
+
+            // Data (22), constraint (23) and syntax or access (42) errors fail
+            // the same way every time and would hold up the journal for good.
+            // Anything else, a lock wait timeout or deadlock among them, is
+            // retried with the rest of the batch at the next replay.
+            if ((sqlState.compare(0, 2, "22") != 0) && (sqlState.compare(0, 2, "23") != 0) && (sqlState.compare(0, 2, "42") != 0))
+            {
+                Logger::getInstance()->FnLog("Journaled write failed (SQL State: " + sqlState + "), retried at the next replay: " + query, "DB");
+                break;
+            }
+            Logger::getInstance()->FnLog("Journaled write rejected by the database (SQL State: " + sqlState + "), dropped: " + query, "DB");
+        }
+        applied++;
+    }
+    journal_.FnConsume(applied);
+
+    std::ostringstream oss;
+    oss << "Replayed " << applied << " journaled writes, " << journal_.FnGetPendingCount() << " pending.";
+    Logger::getInstance()->FnLog(oss.str(), "DB");
+
+    if (journal_.FnIsEmpty())
+    {
+        FnSetDatabaseStatus(true);
+        FnSetDatabaseRecoveryFlag(false);
+        FnRefreshUnsentCounts();
+    }
+
+    // Drained batch by batch without waiting, unless the connection went away again
+    scheduleJournalReplay(((applied == records.size()) && !journal_.FnIsEmpty()) ? std::chrono::milliseconds(0) : interval);
+}
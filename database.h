@@ -1,5 +1,9 @@
 #pragma once
 
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -7,14 +11,18 @@
 #include <sql.h>
 #include <sqlext.h>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include "log.h"
+#include "service.h"
 #include "structure.h"
+#include "write_journal.h"
 
 class OdbcDatabase
 {
 public:
-    OdbcDatabase() : hEnv_(NULL), hDbc_(NULL), hStmt_(NULL), connected_(false) {}
+    OdbcDatabase() : hEnv_(NULL), hDbc_(NULL), hStmt_(NULL), connected_(false), lastSuccessMs_(0) {}
 
     ~OdbcDatabase()
     {
@@ -24,6 +32,7 @@ public:
     bool connect(const std::string& driver, const std::string& server, const std::string& port, 
         const std::string& database, const std::string& user, const std::string& pass, int connTimeout)
     {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         disconnect(); // Ensure any previous connections are closed
 
         SQLRETURN ret;
@@ -59,11 +68,13 @@ public:
         }
 
         connected_ = true;
+        touch();
         return true;
     }
 
     void disconnect()
     {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         if (hStmt_)
         {
             SQLFreeHandle(SQL_HANDLE_STMT, hStmt_);
@@ -85,25 +96,41 @@ public:
         connected_ = false;
     }
 
-    bool is_connected()
+    // Health as of the last statement or probe, no round trip and no lock
+    bool is_connected() const
     {
+        return connected_.load(std::memory_order_acquire);
+    }
+
+    // Steady clock time of the last statement that succeeded
+    std::chrono::steady_clock::time_point last_success() const
+    {
+        return std::chrono::steady_clock::time_point(std::chrono::milliseconds(lastSuccessMs_.load(std::memory_order_relaxed)));
+    }
+
+    // Round trip to the server, a failure of any kind marks the connection dead
+    bool ping()
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         if (!connected_)
         {
             return false;
         }
 
-        SQLINTEGER connectionStatus = 0;
-        SQLRETURN ret = SQLGetConnectAttr(hDbc_, SQL_ATTR_CONNECTION_DEAD, &connectionStatus, 0, NULL);
-        if (!check_error(ret, SQL_HANDLE_DBC, hDbc_, "SQLGetConnectAttr SQL_ATTR_CONNECTION_DEAD"))
+        if (select_count("SELECT 1") != 1)
         {
+            Logger::getInstance()->FnLog("Keepalive probe failed, connection marked dead.", "ODBC");
+            connected_ = false;
             return false;
         }
-
-        return (connectionStatus == SQL_CD_FALSE);
+        return true;
     }
 
-    bool execute_non_query(const std::string& query)
+    // sqlState, if given, receives the SQLSTATE of a failed statement, empty if there was none
+    bool execute_non_query(const std::string& query, std::string* sqlState = nullptr)
     {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        lastSqlState_.clear();
         if (!connected_)
         {
             return false;
@@ -112,7 +139,7 @@ public:
         SQLRETURN ret;
 
         ret = SQLAllocHandle(SQL_HANDLE_STMT, hDbc_, &hStmt_);
-        if (!check_error(ret, SQL_HANDLE_STMT, hStmt_, "SQLAllocHandle STMT"))
+        if (!check_error(ret, SQL_HANDLE_DBC, hDbc_, "SQLAllocHandle STMT"))
         {
             hStmt_ = NULL;
             return false;
@@ -121,6 +148,10 @@ public:
         ret = SQLExecDirect(hStmt_, (SQLCHAR*)query.c_str(), SQL_NTS);
         if (!check_error(ret, SQL_HANDLE_STMT, hStmt_, "SQLExecDirect"))
         {
+            if (sqlState != nullptr)
+            {
+                *sqlState = lastSqlState_;
+            }
             SQLFreeHandle(SQL_HANDLE_STMT, hStmt_);
             hStmt_ = NULL;
             return false;
@@ -128,12 +159,54 @@ public:
 
         SQLFreeHandle(SQL_HANDLE_STMT, hStmt_);
         hStmt_ = NULL;
+        touch();
 
         return true;
     }
 
+    // Rows affected by the statement, -1 if it failed
+    long execute_update(const std::string& query)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        if (!connected_)
+        {
+            return -1;
+        }
+
+        SQLRETURN ret;
+
+        ret = SQLAllocHandle(SQL_HANDLE_STMT, hDbc_, &hStmt_);
+        if (!check_error(ret, SQL_HANDLE_DBC, hDbc_, "SQLAllocHandle STMT"))
+        {
+            hStmt_ = NULL;
+            return -1;
+        }
+
+        ret = SQLExecDirect(hStmt_, (SQLCHAR*)query.c_str(), SQL_NTS);
+        if (!check_error(ret, SQL_HANDLE_STMT, hStmt_, "SQLExecDirect"))
+        {
+            SQLFreeHandle(SQL_HANDLE_STMT, hStmt_);
+            hStmt_ = NULL;
+            return -1;
+        }
+
+        SQLLEN rowCount = 0;
+        ret = SQLRowCount(hStmt_, &rowCount);
+        if (!check_error(ret, SQL_HANDLE_STMT, hStmt_, "SQLRowCount"))
+        {
+            rowCount = -1;
+        }
+
+        SQLFreeHandle(SQL_HANDLE_STMT, hStmt_);
+        hStmt_ = NULL;
+        touch();
+
+        return static_cast<long>(rowCount);
+    }
+
     int get_last_inserted_id(const std::string& tableName)
     {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         if (!connected_)
         {
             return -1;
@@ -143,7 +216,7 @@ public:
         SQLINTEGER lastInsertedID = 0;
 
         ret = SQLAllocHandle(SQL_HANDLE_STMT, hDbc_, &hStmt_);
-        if (!check_error(ret, SQL_HANDLE_STMT, hStmt_, "SQLAllocHandle STMT"))
+        if (!check_error(ret, SQL_HANDLE_DBC, hDbc_, "SQLAllocHandle STMT"))
         {
             hStmt_ = NULL;
             return -1;
@@ -172,12 +245,14 @@ public:
 
         SQLFreeHandle(SQL_HANDLE_STMT, hStmt_);
         hStmt_ = NULL;
+        touch();
 
         return static_cast<int>(lastInsertedID);
     }
 
     int select_count(const std::string& query)
     {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
         int count = -1;
         if (!connected_)
         {
@@ -186,7 +261,7 @@ public:
 
         SQLRETURN ret;
         ret = SQLAllocHandle(SQL_HANDLE_STMT, hDbc_, &hStmt_);
-        if (!check_error(ret, SQL_HANDLE_STMT, hStmt_, "SQLAllocHandle STMT"))
+        if (!check_error(ret, SQL_HANDLE_DBC, hDbc_, "SQLAllocHandle STMT"))
         {
             hStmt_ = NULL;
             return count;
@@ -212,24 +287,40 @@ public:
 
         SQLFreeHandle(SQL_HANDLE_STMT, hStmt_);
         hStmt_ = NULL;
+        touch();
 
         return count;
     }
 
+    // 1 if the query returns a row, 0 if not, -1 on failure; stops at the first row
+    int exists(const std::string& query)
+    {
+        return select_count("SELECT EXISTS(" + query + " LIMIT 1)");
+    }
+
     std::vector<std::vector<std::string>> select(const std::string& query)
     {
         std::vector<std::vector<std::string>> results;
+        select(query, results);
+        return results;
+    }
+
+    // Rows of the query into results, false if it failed; an empty result is no rows
+    bool select(const std::string& query, std::vector<std::vector<std::string>>& results)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex_);
+        results.clear();
         if (!connected_)
         {
-            return results;
+            return false;
         }
 
         SQLRETURN ret;
         ret = SQLAllocHandle(SQL_HANDLE_STMT, hDbc_, &hStmt_);
-        if (!check_error(ret, SQL_HANDLE_STMT, hStmt_, "SQLAllocHandle STMT"))
+        if (!check_error(ret, SQL_HANDLE_DBC, hDbc_, "SQLAllocHandle STMT"))
         {
             hStmt_ = NULL;
-            return results;
+            return false;
         }
 
         ret = SQLExecDirect(hStmt_, (SQLCHAR*)query.c_str(), SQL_NTS);
@@ -237,7 +328,7 @@ public:
         {
             SQLFreeHandle(SQL_HANDLE_STMT, hStmt_);
             hStmt_ = NULL;
-            return results;
+            return false;
         }
 
         SQLSMALLINT columns;
@@ -246,7 +337,7 @@ public:
         {
             SQLFreeHandle(SQL_HANDLE_STMT, hStmt_);
             hStmt_ = NULL;
-            return results;
+            return false;
         }
 
         while (SQLFetch(hStmt_) == SQL_SUCCESS)
@@ -270,27 +361,56 @@ public:
 
         SQLFreeHandle(SQL_HANDLE_STMT, hStmt_);
         hStmt_ = NULL;
+        touch();
 
-        return results;
+        return true;
     }
 
 private:
     SQLHENV hEnv_;
     SQLHDBC hDbc_;
     SQLHSTMT hStmt_;
-    bool connected_;
+    // Cleared by a statement that fails for the connection, set by connect()
+    std::atomic<bool> connected_;
+    std::atomic<std::int64_t> lastSuccessMs_;
+    // One statement handle per connection, calls from different threads take turns
+    std::recursive_mutex mutex_;
+    // SQLSTATE of the last failed call, read under mutex_
+    std::string lastSqlState_;
+
+    void touch()
+    {
+        lastSuccessMs_.store(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(),
+            std::memory_order_relaxed);
+    }
+
+    // SQLSTATE class 08 is a connection exception, 2006 and 2013 are the
+    // server gone away and lost during query errors of the MariaDB client
+    static bool is_connection_error(const SQLCHAR* sqlState, SQLINTEGER nativeError)
+    {
+        return ((sqlState[0] == '0') && (sqlState[1] == '8')) || (nativeError == 2006) || (nativeError == 2013);
+    }
 
     bool check_error(SQLRETURN ret, SQLSMALLINT handleType, SQLHANDLE handle, const std::string& msg)
     {
         if (ret != SQL_SUCCESS && ret != SQL_SUCCESS_WITH_INFO)
         {
-            SQLCHAR sqlState[1024];
+            SQLCHAR sqlState[6] = {0};
+            SQLINTEGER nativeError = 0;
             SQLCHAR message[1024];
-            if (SQLGetDiagRec(handleType, handle, 1, sqlState, NULL, message, 1024, NULL))
+            SQLRETURN diagRet = SQLGetDiagRec(handleType, handle, 1, sqlState, &nativeError, message, sizeof(message), NULL);
+            if (diagRet == SQL_SUCCESS || diagRet == SQL_SUCCESS_WITH_INFO)
             {
+                lastSqlState_ = reinterpret_cast<const char*>(sqlState);
                 std::stringstream ss;
                 ss << msg << " - Error: " << message << " (SQL State: " << sqlState << ")";
                 Logger::getInstance()->FnLog(ss.str(), "ODBC");
+
+                if (connected_ && is_connection_error(sqlState, nativeError))
+                {
+                    Logger::getInstance()->FnLog("Connection lost, marked dead.", "ODBC");
+                    connected_ = false;
+                }
             }
             else
             {
@@ -318,7 +438,11 @@ public:
 
     static MariaDB* getInstance();
     void FnConnectMariaLocalDatabase();
-    bool FnIsConnected();
+    // Starts the connection monitor and the replay of the write journal, on a strand of io_context
+    void FnDatabaseMonitorInitialization(boost::asio::io_context& io_context);
+    std::size_t FnGetJournalPendingCount() const;
+    // Reads the health flag only, the monitor and failed statements keep it current
+    bool FnIsConnected() const;
     void FnSetDatabaseStatus(bool status);
     bool FnGetDatabaseStatus();
     void FnSetDatabaseRecoveryFlag(bool flag);
@@ -326,16 +450,69 @@ public:
     bool FnReconnectMariaLocalDatabase();
 
     // Table --> tbl_ev_lot_status
-    bool FnInsertEvLotStatusRecord(const std::string& carpark_code, const std::string& device_ip, const std::string& error_code);
+    // idempotency_key, if given, receives the key of the row for its live send to stamp it
+    bool FnInsertEvLotStatusRecord(const std::string& carpark_code, const std::string& device_ip, const std::string& error_code, std::string* idempotency_key = nullptr);
     int FnGetLastInsertedIDFromEvLotStatusRecord();
     bool FnIsEvLotStatusTableEmpty();
     void FnRemoveAllRecordFromEvLotStatusTable();
+    // Rows not sent to Central, added more than minAgeSec ago
+    std::vector<ev_lot_status_record_t> FnSelectUnsentEvLotStatusRecords(int limit, int minAgeSec);
+    bool FnMarkEvLotStatusCentralSent(int id);
+    // Stamp of a live send, the row found by the key it was inserted with
+    bool FnMarkEvLotStatusCentralSent(const std::string& idempotency_key);
+    // Rows not sent to Central, kept in memory
+    long FnGetUnsentEvLotStatusCount() const;
+
+    // Retention, for the transaction, status, hogging and statistics tables
+    bool FnIsTablePartitioned(const std::string& table);
+    // Adds the monthly partitions up to monthsAhead and drops those entirely older than retentionDays
+    bool FnMaintainMonthlyPartitions(const std::string& table, int retentionDays, int monthsAhead);
+    // Deletes at most limit rows whose timeColumn is older than retentionDays, oldest first; -1 on failure
+    long FnPurgeExpiredRecords(const std::string& table, const std::string& timeColumn, int retentionDays, int limit);
+
+    // Recount the unsent rows, the in-memory counts drift when rows go away behind their back
+    void FnRefreshUnsentCounts();
 
     // Table --> tbl_ev_lot_trans
     bool FnInsertEvLotTransRecord(const parking_lot_t& lot);
     int FnGetLastInsertedIDFromEvLotTransRecord();
     bool FnIsEvLotTransTableEmpty();
     void FnRemoveAllRecordFromEvLotTransTable();
+    // Rows with a park in or park out not sent to Central, untouched for minAgeSec
+    std::vector<ev_lot_trans_record_t> FnSelectUnsentEvLotTransRecords(int limit, int minAgeSec);
+    bool FnMarkEvLotTransCentralSent(int id, bool lotIn, bool lotOut);
+    // Stamp of a live send, the park in or park out found by the lot and its time (lot_in_dt or lot_out_dt)
+    bool FnMarkEvLotTransCentralSent(const std::string& location_code, const std::string& lot_no, lotEvent event, lot_time_t event_dt);
+    // Park ins and park outs not sent to Central, kept in memory
+    long FnGetUnsentEvLotTransCount() const;
+    // Open session of a lot, its latest park in without a park out
+    bool FnSelectOpenEvLotTransRecord(const std::string& location_code, const std::string& lot_no, ev_lot_trans_record_t& record);
+    // Every open session of the location, oldest park in first
+    std::vector<ev_lot_trans_record_t> FnSelectOpenEvLotTransRecords(const std::string& location_code);
+    // Latest park in of a vehicle
+    bool FnSelectLatestEvLotTransRecordByLpn(const std::string& lpn, ev_lot_trans_record_t& record);
+    // Park out, closes the open session of the lot; without one the park out gets a row of its own
+    bool FnCloseEvLotTransRecord(const parking_lot_t& lot);
+    // Image paths starting with prefix and the number of row columns referring to each; false if the select failed
+    bool FnSelectEvLotTransImageReferences(const std::string& prefix, std::vector<std::pair<std::string, long>>& references);
+
+    // Table --> tbl_ev_lot_hogging
+    // existed, if given, is set when the session already had its row, flagged before a restart
+    bool FnInsertEvLotHoggingRecord(const lot_hogging_t& hogging, bool* existed = nullptr);
+    // Flagged sessions not sent to Central, added more than minAgeSec ago
+    std::vector<ev_lot_hogging_record_t> FnSelectUnsentEvLotHoggingRecords(int limit, int minAgeSec);
+    bool FnMarkEvLotHoggingCentralSent(int id);
+    // Stamp of a live send, the row found by its session (lot and lot_in_dt)
+    bool FnMarkEvLotHoggingCentralSent(const std::string& location_code, const std::string& lot_no, lot_time_t lot_in_dt);
+    // Flagged sessions not sent to Central, kept in memory
+    long FnGetUnsentEvLotHoggingCount() const;
+
+    // Table --> tbl_ev_lot_stats_hourly
+    // Rows are written as totals, a lot and hour written again is overwritten
+    bool FnUpsertEvLotStatsHourlyRecords(const std::string& location_code, const std::vector<lot_stats_hourly_t>& rows);
+    // Rollups of the hours from hourFrom to hourTo, both included; of every lot for an empty lot_no
+    std::vector<lot_stats_hourly_t> FnSelectEvLotStatsHourlyRecords(const std::string& location_code, const std::string& lot_no,
+                                                                    lot_time_t hourFrom, lot_time_t hourTo);
 
     /*
      * Singleton MariaDB cannot be cloneable
@@ -348,11 +525,58 @@ public:
     void operator=(const MariaDB &) = delete;
 
 private:
-    static MariaDB* mariaDb_;
-    static std::mutex mutex_;
+    static ServiceInstance<MariaDB> instance_;
     MariaDB();
 
     std::unique_ptr<OdbcDatabase> mariaDatabase_;
-    bool databaseStatus_;
-    bool databaseRecoveryFlag_;
+    std::atomic<bool> databaseStatus_;
+    std::atomic<bool> databaseRecoveryFlag_;
+
+    /*
+     * Connection monitor. A connection that fell idle for keepaliveIntervalMs
+     * is probed, a dead one is reconnected with a delay doubling from
+     * reconnectBaseMs up to reconnectMaxMs between failed attempts. Shares
+     * the strand with the journal replay, which starts right after a
+     * reconnect.
+     */
+    std::unique_ptr<boost::asio::strand<boost::asio::io_context::executor_type>> pMonitorStrand_;
+    std::unique_ptr<boost::asio::steady_timer> pHealthTimer_;
+    std::chrono::milliseconds reconnectDelay_;
+
+    /*
+     * Unsent rows, counted once from the unsent indexes on connect and then
+     * kept by the inserts and sent stamps made here, so a status check does
+     * not touch the tables. A tbl_ev_lot_trans row counts once per unsent
+     * park in and park out.
+     */
+    std::atomic<long> unsentEvLotStatusCount_;
+    std::atomic<long> unsentEvLotTransCount_;
+    std::atomic<long> unsentEvLotHoggingCount_;
+    static void decrementCount(std::atomic<long>& count, long by);
+
+    /*
+     * Writes made while the database is unavailable, or while earlier ones
+     * still wait in the journal, are journaled and replayed in order once it
+     * is back. Inserts carry an idempotency key in a unique column, a record
+     * replayed twice after a crash does not add a second row.
+     */
+    WriteJournal journal_;
+    // Held by executeWrite from the journal check to the execute or append
+    std::mutex writeOrderMutex_;
+    std::string idempotencyPrefix_;
+    std::atomic<unsigned long> idempotencySequence_;
+    std::unique_ptr<boost::asio::steady_timer> pReplayTimer_;
+
+    std::string newIdempotencyKey();
+    // SQL literals, NULL for an empty string or a time not set
+    static std::string sqlString(std::string_view value);
+    static std::string sqlDateTime(lot_time_t value);
+    std::vector<ev_lot_trans_record_t> selectEvLotTransRecords(const std::string& query);
+    // Execute or journal a write, false only if the write is lost. affectedRows
+    // receives the rows the statement changed, -1 if it was journaled.
+    bool executeWrite(const std::string& query, long* affectedRows = nullptr);
+    void scheduleHealthCheck(std::chrono::milliseconds delay);
+    void checkHealth();
+    void scheduleJournalReplay(std::chrono::milliseconds delay);
+    void replayJournal();
 };
\ No newline at end of file
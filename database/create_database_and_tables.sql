@@ -14,10 +14,11 @@ CREATE TABLE IF NOT EXISTS tbl_ev_lot_trans (
     lot_out_image VARCHAR(200),
     lot_in_dt DATETIME,
     lot_out_dt DATETIME,
-    add_dt DATETIME,
+    add_dt DATETIME NOT NULL DEFAULT CURRENT_TIMESTAMP,
     update_dt DATETIME,
     lot_in_central_sent_dt DATETIME,
-    lot_out_central_sent_dt DATETIME
+    lot_out_central_sent_dt DATETIME,
+    idempotency_key VARCHAR(40)
 );
 
 -- Create a table in the database
@@ -26,9 +27,77 @@ CREATE TABLE IF NOT EXISTS tbl_ev_lot_status (
     location_code VARCHAR(10),
     device_ip VARCHAR(20),
     error_code VARCHAR(10),
-    central_sent_dt DATETIME
+    central_sent_dt DATETIME,
+    add_dt DATETIME NOT NULL DEFAULT CURRENT_TIMESTAMP,
+    idempotency_key VARCHAR(40)
 );
 
+-- Inserts replayed from the write journal are recognised by their key
+ALTER TABLE tbl_ev_lot_trans ADD COLUMN IF NOT EXISTS idempotency_key VARCHAR(40);
+ALTER TABLE tbl_ev_lot_status ADD COLUMN IF NOT EXISTS idempotency_key VARCHAR(40);
+CREATE UNIQUE INDEX IF NOT EXISTS uq_lot_trans_idempotency_key ON tbl_ev_lot_trans (idempotency_key);
+CREATE UNIQUE INDEX IF NOT EXISTS uq_lot_status_idempotency_key ON tbl_ev_lot_status (idempotency_key);
+
+-- Rows not yet sent to Central, read by the resend sweeper in id order
+CREATE INDEX IF NOT EXISTS idx_lot_trans_in_unsent ON tbl_ev_lot_trans (lot_in_central_sent_dt, id);
+CREATE INDEX IF NOT EXISTS idx_lot_trans_out_unsent ON tbl_ev_lot_trans (lot_out_central_sent_dt, id);
+CREATE INDEX IF NOT EXISTS idx_lot_status_unsent ON tbl_ev_lot_status (central_sent_dt, id);
+
+-- Open session of a lot (lot_out_dt IS NULL), latest park in first, and the
+-- park out closing it; latest entry of a vehicle
+CREATE INDEX IF NOT EXISTS idx_lot_trans_lot_session ON tbl_ev_lot_trans (location_code, lot_no, lot_out_dt, lot_in_dt);
+CREATE INDEX IF NOT EXISTS idx_lot_trans_lpn_in ON tbl_ev_lot_trans (lpn, lot_in_dt);
+
+-- Rows referring to each stored image, counted by the image store evictor
+CREATE INDEX IF NOT EXISTS idx_lot_trans_in_image ON tbl_ev_lot_trans (lot_in_image);
+CREATE INDEX IF NOT EXISTS idx_lot_trans_out_image ON tbl_ev_lot_trans (lot_out_image);
+
+-- Retention goes by add_dt, expired rows are purged oldest first in chunks
+ALTER TABLE tbl_ev_lot_status ADD COLUMN IF NOT EXISTS add_dt DATETIME NOT NULL DEFAULT CURRENT_TIMESTAMP AFTER central_sent_dt;
+UPDATE tbl_ev_lot_trans SET add_dt = COALESCE(lot_in_dt, lot_out_dt, NOW()) WHERE add_dt IS NULL;
+CREATE INDEX IF NOT EXISTS idx_lot_trans_add_dt ON tbl_ev_lot_trans (add_dt, id);
+CREATE INDEX IF NOT EXISTS idx_lot_status_add_dt ON tbl_ev_lot_status (add_dt, id);
+
+-- Sessions flagged by the hogging rule engine, at most one row per session
+CREATE TABLE IF NOT EXISTS tbl_ev_lot_hogging (
+    id INT AUTO_INCREMENT PRIMARY KEY,
+    location_code VARCHAR(10),
+    lot_no VARCHAR(10),
+    lpn VARCHAR(10),
+    policy VARCHAR(20),
+    reason VARCHAR(10),
+    lot_in_dt DATETIME,
+    hogging_dt DATETIME,
+    central_sent_dt DATETIME,
+    add_dt DATETIME NOT NULL DEFAULT CURRENT_TIMESTAMP
+);
+ALTER TABLE tbl_ev_lot_hogging ADD COLUMN IF NOT EXISTS central_sent_dt DATETIME AFTER hogging_dt;
+CREATE UNIQUE INDEX IF NOT EXISTS uq_lot_hogging_session ON tbl_ev_lot_hogging (location_code, lot_no, lot_in_dt);
+CREATE INDEX IF NOT EXISTS idx_lot_hogging_add_dt ON tbl_ev_lot_hogging (add_dt, id);
+CREATE INDEX IF NOT EXISTS idx_lot_hogging_unsent ON tbl_ev_lot_hogging (central_sent_dt, id);
+
+-- Hourly rollups per lot, kept by LotStatistics so reports never read
+-- tbl_ev_lot_trans. dwell_histogram holds the park outs per dwell bucket:
+-- under 15, 30, 60, 120, 240, 480 minutes and 480 or more.
+CREATE TABLE IF NOT EXISTS tbl_ev_lot_stats_hourly (
+    id INT AUTO_INCREMENT PRIMARY KEY,
+    location_code VARCHAR(10),
+    lot_no VARCHAR(10),
+    hour_start DATETIME NOT NULL,
+    park_ins INT NOT NULL DEFAULT 0,
+    park_outs INT NOT NULL DEFAULT 0,
+    hoggings INT NOT NULL DEFAULT 0,
+    occupied_sec INT NOT NULL DEFAULT 0,
+    dwell_count INT NOT NULL DEFAULT 0,
+    dwell_sum_sec BIGINT NOT NULL DEFAULT 0,
+    dwell_histogram VARCHAR(80),
+    update_dt DATETIME
+);
+CREATE UNIQUE INDEX IF NOT EXISTS uq_lot_stats_hourly ON tbl_ev_lot_stats_hourly (location_code, lot_no, hour_start);
+CREATE INDEX IF NOT EXISTS idx_lot_stats_hourly_hour ON tbl_ev_lot_stats_hourly (location_code, hour_start);
+-- Rollups expire by hour_start, purged oldest first in chunks
+CREATE INDEX IF NOT EXISTS idx_lot_stats_hourly_retention ON tbl_ev_lot_stats_hourly (hour_start, id);
+
 -- Create a new user and grant privileges
 CREATE USER IF NOT EXISTS 'evcharging'@'localhost' IDENTIFIED BY 'SJ2001';
 GRANT ALL PRIVILEGES ON ev_charging_database.* TO 'evcharging'@'localhost';
@@ -0,0 +1,34 @@
+-- partition_tables.sql
+-- Converts tbl_ev_lot_trans and tbl_ev_lot_status to monthly RANGE partitions
+-- on add_dt, so retention drops whole months instead of deleting rows.
+-- Run once, after create_database_and_tables.sql, in a maintenance window:
+-- both tables are rebuilt. The application adds the monthly partitions from
+-- then on (retentionMonthsAhead) by splitting p_max, and drops expired ones.
+
+USE ev_charging_database;
+
+-- The partitioning column has to be part of every unique key
+UPDATE tbl_ev_lot_trans SET add_dt = COALESCE(lot_in_dt, lot_out_dt, NOW()) WHERE add_dt IS NULL;
+ALTER TABLE tbl_ev_lot_trans
+    MODIFY add_dt DATETIME NOT NULL DEFAULT CURRENT_TIMESTAMP,
+    DROP PRIMARY KEY,
+    ADD PRIMARY KEY (id, add_dt),
+    DROP INDEX uq_lot_trans_idempotency_key,
+    ADD UNIQUE INDEX uq_lot_trans_idempotency_key (idempotency_key, add_dt);
+
+ALTER TABLE tbl_ev_lot_status
+    DROP PRIMARY KEY,
+    ADD PRIMARY KEY (id, add_dt),
+    DROP INDEX uq_lot_status_idempotency_key,
+    ADD UNIQUE INDEX uq_lot_status_idempotency_key (idempotency_key, add_dt);
+
+-- Existing rows go to the current month when the application first splits
+-- p_max; the expired ones among them are purged in chunks. Inserts carry
+-- their add_dt, so a replayed insert still meets its idempotency key.
+ALTER TABLE tbl_ev_lot_trans PARTITION BY RANGE (TO_DAYS(add_dt)) (
+    PARTITION p_max VALUES LESS THAN MAXVALUE
+);
+
+ALTER TABLE tbl_ev_lot_status PARTITION BY RANGE (TO_DAYS(add_dt)) (
+    PARTITION p_max VALUES LESS THAN MAXVALUE
+);
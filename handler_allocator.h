@@ -0,0 +1,162 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Recycling storage for the asynchronous operations of one connection.
+ * A connection only ever has a few operations in flight (read or write plus
+ * the stream timer), so a handful of fixed blocks owned by the connection
+ * serve every composed operation after the first, without malloc/free.
+ * Larger or additional requests fall back to operator new.
+ *
+ * Blocks are claimed and released with atomics: Asio frees operation memory
+ * on the completing thread before the handler is dispatched to the strand.
+ */
+class handler_memory
+{
+public:
+    static constexpr std::size_t BLOCK_SIZE = 1024;
+    static constexpr std::size_t BLOCK_COUNT = 4;
+
+    handler_memory()
+    {
+        for (auto& inUse : inUse_)
+        {
+            inUse.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    /*
+     * handler_memory is referenced by in-flight operations, it should not be cloneable
+     */
+    handler_memory(const handler_memory&) = delete;
+
+    /*
+     * handler_memory is referenced by in-flight operations, it should not be assignable
+     */
+    handler_memory& operator=(const handler_memory&) = delete;
+
+    void* allocate(std::size_t size)
+    {
+        if (size <= BLOCK_SIZE)
+        {
+            for (std::size_t i = 0; i < BLOCK_COUNT; i++)
+            {
+                bool expected = false;
+                if (inUse_[i].compare_exchange_strong(expected, true, std::memory_order_acquire))
+                {
+                    return &storage_[i];
+                }
+            }
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* pointer)
+    {
+        for (std::size_t i = 0; i < BLOCK_COUNT; i++)
+        {
+            if (pointer == &storage_[i])
+            {
+                inUse_[i].store(false, std::memory_order_release);
+                return;
+            }
+        }
+        ::operator delete(pointer);
+    }
+
+private:
+    std::array<typename std::aligned_storage<BLOCK_SIZE, alignof(std::max_align_t)>::type, BLOCK_COUNT> storage_;
+    std::array<std::atomic<bool>, BLOCK_COUNT> inUse_;
+};
+
+/*
+ * Minimal allocator over handler_memory, picked up by Asio through the
+ * handler's allocator_type / get_allocator() (associated_allocator).
+ */
+template <typename T>
+class handler_allocator
+{
+public:
+    using value_type = T;
+
+    explicit handler_allocator(handler_memory& memory)
+        : memory_(memory)
+    {
+    }
+
+    template <typename U>
+    handler_allocator(const handler_allocator<U>& other) noexcept
+        : memory_(other.memory_)
+    {
+    }
+
+    bool operator==(const handler_allocator& other) const noexcept
+    {
+        return &memory_ == &other.memory_;
+    }
+
+    bool operator!=(const handler_allocator& other) const noexcept
+    {
+        return &memory_ != &other.memory_;
+    }
+
+    T* allocate(std::size_t n) const
+    {
+        return static_cast<T*>(memory_.allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T* pointer, std::size_t /*n*/) const
+    {
+        return memory_.deallocate(pointer);
+    }
+
+private:
+    template <typename>
+    friend class handler_allocator;
+
+    handler_memory& memory_;
+};
+
+/*
+ * Wraps a completion handler so that the operation it completes allocates
+ * from the connection's handler_memory.
+ */
+template <typename Handler>
+class custom_alloc_handler
+{
+public:
+    using allocator_type = handler_allocator<Handler>;
+
+    custom_alloc_handler(handler_memory& memory, Handler handler)
+        : memory_(memory),
+        handler_(std::move(handler))
+    {
+    }
+
+    allocator_type get_allocator() const noexcept
+    {
+        return allocator_type(memory_);
+    }
+
+    template <typename... Args>
+    void operator()(Args&&... args)
+    {
+        handler_(std::forward<Args>(args)...);
+    }
+
+private:
+    handler_memory& memory_;
+    Handler handler_;
+};
+
+template <typename Handler>
+inline custom_alloc_handler<typename std::decay<Handler>::type> make_custom_alloc_handler(handler_memory& memory, Handler&& handler)
+{
+    return custom_alloc_handler<typename std::decay<Handler>::type>(memory, std::forward<Handler>(handler));
+}
@@ -0,0 +1,532 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <ctime>
+#include <sstream>
+#include "central.h"
+#include "common.h"
+#include "database.h"
+#include "hogging_engine.h"
+#include "log.h"
+#include "lot_occupancy.h"
+#include "lot_statistics.h"
+
+namespace
+{
+
+const int MINUTES_PER_DAY = 24 * 60;
+
+std::string trim(const std::string& str)
+{
+    std::size_t first = str.find_first_not_of(" \t");
+    if (first == std::string::npos)
+    {
+        return "";
+    }
+    return str.substr(first, str.find_last_not_of(" \t") - first + 1);
+}
+
+bool parseInt(std::string_view str, int& value)
+{
+    const char* end = str.data() + str.size();
+    std::from_chars_result result = std::from_chars(str.data(), end, value);
+    return (result.ec == std::errc()) && (result.ptr == end);
+}
+
+}
+
+ServiceInstance<HoggingEngine> HoggingEngine::instance_;
+
+HoggingEngine::HoggingEngine()
+    : armedDeadline_(lot_time_t::max()),
+    hoggingCount_(0)
+{
+
+}
+
+HoggingEngine* HoggingEngine::getInstance()
+{
+    return instance_.get([]() { return new HoggingEngine(); });
+}
+
+void HoggingEngine::FnHoggingEngineInitialization(boost::asio::io_context& io_context, const ServiceContext& services)
+{
+    services_ = services;
+    pStrand_ = std::make_unique<boost::asio::strand<boost::asio::io_context::executor_type>>(io_context.get_executor());
+    pTimer_ = std::make_unique<boost::asio::system_timer>(*pStrand_);
+    sessions_.assign(services_.lotOccupancy->FnGetLotCount(), lotSession{});
+
+    boost::asio::post(*pStrand_, [this]() {
+        refreshTable();
+
+        std::size_t open = 0;
+        for (std::size_t lot = 0; lot < sessions_.size(); lot++)
+        {
+            lotOccupancy occupancy;
+            if (services_.lotOccupancy->FnGetLot(std::to_string(lot + 1), occupancy) && (occupancy.state == lotState::Occupied))
+            {
+                lotSession& session = sessions_[lot];
+                session.occupied = true;
+                session.lpn = occupancy.lpn;
+                session.lotInTime = std::chrono::system_clock::from_time_t(occupancy.lotInTime);
+                open++;
+            }
+        }
+        reschedule();
+
+        std::ostringstream oss;
+        oss << "Hogging engine started, " << table_->rules.size() << " policies, " << open << " open sessions, "
+            << deadlines_.size() << " deadlines.";
+        services_.logger->FnLog(oss.str(), "HOGGING");
+    });
+}
+
+void HoggingEngine::FnOnParkIn(std::string_view lot_no, std::string_view lpn, lot_time_t lotInTime)
+{
+    if (!pStrand_)
+    {
+        return;
+    }
+
+    long lot = services_.lotOccupancy->FnGetLotIndex(lot_no);
+    if (lot < 0)
+    {
+        return;
+    }
+
+    boost::asio::post(*pStrand_, [this, lot, lpn = InlineString<10>(lpn), lotInTime]() {
+        onParkIn(static_cast<std::size_t>(lot), lpn, lotInTime);
+    });
+}
+
+void HoggingEngine::FnOnParkOut(std::string_view lot_no)
+{
+    if (!pStrand_)
+    {
+        return;
+    }
+
+    long lot = services_.lotOccupancy->FnGetLotIndex(lot_no);
+    if (lot < 0)
+    {
+        return;
+    }
+
+    boost::asio::post(*pStrand_, [this, lot]() {
+        onParkOut(static_cast<std::size_t>(lot));
+    });
+}
+
+void HoggingEngine::FnOnChargingChanged(std::string_view lot_no, bool charging, lot_time_t time)
+{
+    if (!pStrand_)
+    {
+        return;
+    }
+
+    long lot = services_.lotOccupancy->FnGetLotIndex(lot_no);
+    if (lot < 0)
+    {
+        return;
+    }
+
+    boost::asio::post(*pStrand_, [this, lot, charging, time]() {
+        onChargingChanged(static_cast<std::size_t>(lot), charging, time);
+    });
+}
+
+std::size_t HoggingEngine::FnGetHoggingCount() const
+{
+    return hoggingCount_.load(std::memory_order_relaxed);
+}
+
+std::unique_ptr<const HoggingEngine::ruleTable> HoggingEngine::compile(const IniConfig* config, std::size_t lotCount) const
+{
+    std::unique_ptr<ruleTable> table = std::make_unique<ruleTable>();
+    table->config = config;
+    table->lotRules.assign(lotCount, NO_RULE);
+
+    if (!config->hoggingEnabled)
+    {
+        return table;
+    }
+
+    for (const hoggingPolicyConfig& policy : config->hoggingPolicies)
+    {
+        if (table->rules.size() >= NO_RULE)
+        {
+            services_.logger->FnLog("Too many hogging policies, " + policy.name + " and the rest ignored.", "HOGGING");
+            break;
+        }
+
+        // Without its windows the policy would be enforced all day, it is left out and its lots stay uncovered
+        std::vector<ruleWindow> windows;
+        if (!parseWindows(policy.windows, windows))
+        {
+            services_.logger->FnLog("Hogging policy " + policy.name + " skipped, invalid windows: " + policy.windows, "HOGGING");
+            continue;
+        }
+
+        hoggingRule rule;
+        rule.maxDwellSec = std::max(policy.maxDwellMin, 0) * 60;
+        rule.idleMaxSec = std::max(policy.idleMaxMin, 0) * 60;
+        rule.graceSec = std::max(policy.graceMin, 0) * 60;
+        rule.windowOffset = static_cast<std::uint16_t>(table->windows.size());
+        rule.windowCount = static_cast<std::uint16_t>(windows.size());
+        table->windows.insert(table->windows.end(), windows.begin(), windows.end());
+        table->rules.push_back(rule);
+        table->names.push_back(policy.name);
+    }
+
+    auto ruleOf = [&table](const std::string& name) -> std::uint8_t {
+        auto it = std::find(table->names.begin(), table->names.end(), name);
+        return (it == table->names.end()) ? NO_RULE : static_cast<std::uint8_t>(it - table->names.begin());
+    };
+
+    if (!config->hoggingDefaultPolicy.empty())
+    {
+        std::uint8_t rule = ruleOf(config->hoggingDefaultPolicy);
+        if (rule == NO_RULE)
+        {
+            services_.logger->FnLog("Unknown default hogging policy " + config->hoggingDefaultPolicy + ".", "HOGGING");
+        }
+        std::fill(table->lotRules.begin(), table->lotRules.end(), rule);
+    }
+
+    // first-last:policy or lot:policy, later entries override earlier ones
+    std::istringstream iss(config->hoggingLotPolicies);
+    std::string item;
+    while (std::getline(iss, item, ','))
+    {
+        item = trim(item);
+        if (item.empty())
+        {
+            continue;
+        }
+
+        std::size_t colon = item.find(':');
+        std::string range = trim(item.substr(0, colon));
+        std::string name = (colon == std::string::npos) ? "" : trim(item.substr(colon + 1));
+        std::size_t dash = range.find('-');
+        int first = 0;
+        int last = 0;
+        bool valid = parseInt(std::string_view(range).substr(0, dash), first);
+        if (dash == std::string::npos)
+        {
+            last = first;
+        }
+        else
+        {
+            valid = valid && parseInt(std::string_view(range).substr(dash + 1), last);
+        }
+        std::uint8_t rule = ruleOf(name);
+        if (!valid || (first < 1) || (last < first) || (rule == NO_RULE))
+        {
+            services_.logger->FnLog("Invalid hogging lot policy skipped: " + item, "HOGGING");
+            continue;
+        }
+
+        for (std::size_t lot = static_cast<std::size_t>(first - 1); (lot < static_cast<std::size_t>(last)) && (lot < lotCount); lot++)
+        {
+            table->lotRules[lot] = rule;
+        }
+    }
+
+    return table;
+}
+
+bool HoggingEngine::parseWindows(const std::string& windows, std::vector<ruleWindow>& compiled)
+{
+    bool valid = true;
+    std::istringstream iss(windows);
+    std::string item;
+    while (std::getline(iss, item, ','))
+    {
+        item = trim(item);
+        if (item.empty())
+        {
+            continue;
+        }
+
+        int startHour, startMinute, endHour, endMinute;
+        int consumed = 0;
+        if ((std::sscanf(item.c_str(), "%d:%d-%d:%d%n", &startHour, &startMinute, &endHour, &endMinute, &consumed) != 4) ||
+            (static_cast<std::size_t>(consumed) != item.size()))
+        {
+            valid = false;
+            continue;
+        }
+
+        int start = startHour * 60 + startMinute;
+        int end = endHour * 60 + endMinute;
+        if ((startMinute < 0) || (startMinute >= 60) || (endMinute < 0) || (endMinute >= 60) ||
+            (start < 0) || (start >= MINUTES_PER_DAY) || (end < 0) || (end > MINUTES_PER_DAY))
+        {
+            valid = false;
+            continue;
+        }
+
+        // A window crossing midnight is two, one ending at midnight and one starting there
+        if (start < end)
+        {
+            compiled.push_back(ruleWindow{static_cast<std::uint16_t>(start), static_cast<std::uint16_t>(end)});
+        }
+        else
+        {
+            compiled.push_back(ruleWindow{static_cast<std::uint16_t>(start), static_cast<std::uint16_t>(MINUTES_PER_DAY)});
+            if (end > 0)
+            {
+                compiled.push_back(ruleWindow{0, static_cast<std::uint16_t>(end)});
+            }
+        }
+    }
+
+    std::sort(compiled.begin(), compiled.end(), [](const ruleWindow& a, const ruleWindow& b) { return a.startMin < b.startMin; });
+    return valid;
+}
+
+lot_time_t HoggingEngine::enforcedFrom(lot_time_t time, const hoggingRule& rule) const
+{
+    if (rule.windowCount == 0)
+    {
+        return time;
+    }
+
+    std::time_t timer = std::chrono::system_clock::to_time_t(time);
+    struct tm local;
+    localtime_r(&timer, &local);
+    int second = local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+
+    const ruleWindow* windows = table_->windows.data() + rule.windowOffset;
+    for (std::uint16_t i = 0; i < rule.windowCount; i++)
+    {
+        if ((windows[i].startMin * 60 <= second) && (second < windows[i].endMin * 60))
+        {
+            return time;
+        }
+    }
+
+    // Start of the next window, today or else the first one tomorrow
+    lot_time_t startOfSecond = std::chrono::floor<std::chrono::seconds>(time);
+    for (std::uint16_t i = 0; i < rule.windowCount; i++)
+    {
+        if (windows[i].startMin * 60 > second)
+        {
+            return startOfSecond + std::chrono::seconds(windows[i].startMin * 60 - second);
+        }
+    }
+    return startOfSecond + std::chrono::seconds(MINUTES_PER_DAY * 60 - second + windows[0].startMin * 60);
+}
+
+bool HoggingEngine::refreshTable()
+{
+    const IniConfig* config = services_.iniParser->FnGetConfig();
+    if (table_ && (table_->config == config))
+    {
+        return false;
+    }
+
+    table_ = compile(config, sessions_.size());
+
+    std::size_t covered = static_cast<std::size_t>(std::count_if(table_->lotRules.begin(), table_->lotRules.end(),
+                                                                [](std::uint8_t rule) { return rule != NO_RULE; }));
+    std::ostringstream oss;
+    oss << "Hogging rules compiled, " << table_->rules.size() << " policies, " << table_->windows.size() << " windows, "
+        << covered << " of " << sessions_.size() << " lots covered.";
+    services_.logger->FnLog(oss.str(), "HOGGING");
+    return true;
+}
+
+void HoggingEngine::reschedule()
+{
+    deadlines_ = decltype(deadlines_)();
+    for (std::size_t lot = 0; lot < sessions_.size(); lot++)
+    {
+        sessions_[lot].generation++;
+        schedule(lot);
+    }
+
+    armedDeadline_ = lot_time_t::max();
+    pTimer_->cancel();
+    armTimer();
+}
+
+void HoggingEngine::transition(std::size_t lot)
+{
+    sessions_[lot].generation++;
+
+    // Deadlines of earlier transitions are dropped in one go once they outnumber the lots
+    if (refreshTable() || (deadlines_.size() > 2 * sessions_.size() + 64))
+    {
+        reschedule();
+        return;
+    }
+
+    schedule(lot);
+    armTimer();
+}
+
+void HoggingEngine::schedule(std::size_t lot)
+{
+    const lotSession& session = sessions_[lot];
+    std::uint8_t ruleIndex = table_->lotRules[lot];
+    if (!session.occupied || session.flagged || (ruleIndex == NO_RULE))
+    {
+        return;
+    }
+
+    const hoggingRule& rule = table_->rules[ruleIndex];
+    lot_time_t deadline = lot_time_t::max();
+    hoggingReason reason = hoggingReason::MaxDwell;
+    if (rule.maxDwellSec > 0)
+    {
+        deadline = session.lotInTime + std::chrono::seconds(rule.maxDwellSec + rule.graceSec);
+    }
+    if ((rule.idleMaxSec > 0) && isLotTimeSet(session.chargingEndTime))
+    {
+        lot_time_t idleDeadline = session.chargingEndTime + std::chrono::seconds(rule.idleMaxSec + rule.graceSec);
+        if (idleDeadline < deadline)
+        {
+            deadline = idleDeadline;
+            reason = hoggingReason::Idle;
+        }
+    }
+
+    if (deadline == lot_time_t::max())
+    {
+        return;
+    }
+    deadlines_.push(lotDeadline{enforcedFrom(deadline, rule), static_cast<std::uint32_t>(lot), session.generation, reason});
+}
+
+void HoggingEngine::armTimer()
+{
+    // Already waiting for this deadline or an earlier one
+    if (deadlines_.empty() || (deadlines_.top().deadline >= armedDeadline_))
+    {
+        return;
+    }
+
+    armedDeadline_ = deadlines_.top().deadline;
+    pTimer_->expires_at(armedDeadline_);
+    pTimer_->async_wait(boost::asio::bind_executor(*pStrand_, [this](const boost::system::error_code& ec) {
+        if (ec)
+        {
+            return;
+        }
+        onTimer();
+    }));
+}
+
+void HoggingEngine::onTimer()
+{
+    armedDeadline_ = lot_time_t::max();
+
+    if (refreshTable())
+    {
+        reschedule();
+        return;
+    }
+
+    lot_time_t now = std::chrono::system_clock::now();
+    while (!deadlines_.empty() && (deadlines_.top().deadline <= now))
+    {
+        lotDeadline due = deadlines_.top();
+        deadlines_.pop();
+
+        const lotSession& session = sessions_[due.lot];
+        if ((due.generation != session.generation) || !session.occupied || session.flagged)
+        {
+            continue;
+        }
+        flag(due.lot, due.reason, now);
+    }
+
+    armTimer();
+}
+
+void HoggingEngine::flag(std::size_t lot, hoggingReason reason, lot_time_t now)
+{
+    lotSession& session = sessions_[lot];
+    session.flagged = true;
+    hoggingCount_.fetch_add(1, std::memory_order_relaxed);
+
+    lot_hogging_t hogging;
+    hogging.location_code = table_->config->parkingLotLocationCode;
+    hogging.lot_no = std::to_string(lot + 1);
+    hogging.lpn = session.lpn;
+    hogging.policy = table_->names[table_->lotRules[lot]];
+    hogging.reason = reason;
+    hogging.lot_in_dt = session.lotInTime;
+    hogging.hogging_dt = now;
+
+    std::ostringstream oss;
+    oss << "Lot " << hogging.lot_no.view() << " (" << hogging.lpn.view() << ") hogging, " << hoggingReasonName(reason)
+        << " of policy " << hogging.policy << ", parked since " << services_.common->FnFormatDateTime_YYYY_MM_DD_HH_MM_SS(session.lotInTime);
+    services_.logger->FnLog(oss.str(), "HOGGING");
+
+    // A session flagged before a restart was sent then, or is left to the resend sweeper
+    bool existed = false;
+    services_.mariaDb->FnInsertEvLotHoggingRecord(hogging, &existed);
+    if (existed)
+    {
+        services_.logger->FnLog("Lot " + hogging.lot_no.str() + " hogging already recorded, not sent again.", "HOGGING");
+        return;
+    }
+    services_.lotStatistics->FnOnHogging(hogging.lot_no.view());
+
+    // Stamped once Central has it, an unstamped row is left to the resend sweeper
+    services_.central->FnSendHoggingEvent(hogging,
+        [mariaDb = services_.mariaDb, locationCode = hogging.location_code.str(), lotNo = hogging.lot_no.str(), lotInDt = hogging.lot_in_dt]
+        (boost::beast::error_code ec, const std::string& msg) {
+            if (!ec && msg.empty())
+            {
+                mariaDb->FnMarkEvLotHoggingCentralSent(locationCode, lotNo, lotInDt);
+            }
+        });
+}
+
+void HoggingEngine::onParkIn(std::size_t lot, InlineString<10> lpn, lot_time_t lotInTime)
+{
+    lotSession& session = sessions_[lot];
+    if (session.flagged)
+    {
+        hoggingCount_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    session.occupied = true;
+    session.flagged = false;
+    session.lpn = lpn;
+    session.lotInTime = lotInTime;
+    session.chargingEndTime = lot_time_t();
+    transition(lot);
+}
+
+void HoggingEngine::onParkOut(std::size_t lot)
+{
+    lotSession& session = sessions_[lot];
+    if (!session.occupied)
+    {
+        return;
+    }
+    if (session.flagged)
+    {
+        hoggingCount_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    session.occupied = false;
+    session.flagged = false;
+    transition(lot);
+}
+
+void HoggingEngine::onChargingChanged(std::size_t lot, bool charging, lot_time_t time)
+{
+    lotSession& session = sessions_[lot];
+    if (!session.occupied || session.flagged)
+    {
+        return;
+    }
+
+    session.chargingEndTime = charging ? lot_time_t() : time;
+    transition(lot);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/asio/system_timer.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ini_parser.h"
+#include "service.h"
+#include "structure.h"
+
+/*
+ * Flags vehicles hogging their lot, fed by the park in, park out and charging
+ * events of each lot.
+ * The policies of the configuration snapshot are compiled into a rule table:
+ * one small fixed-size rule per policy, its enforcement windows in a shared
+ * array, and the rule index of every lot. Each transition of a lot computes
+ * when its session goes past a limit and pushes that one deadline onto a
+ * min-heap; a single timer waits for the earliest. Nothing is scanned
+ * periodically, a lot costs work only when it changes or its deadline comes.
+ * Deadlines of an earlier transition are left in the heap and skipped when
+ * they come up.
+ * A flagged session is written to tbl_ev_lot_hogging and sent to Central
+ * once; the row is stamped when Central has it, or else resent by
+ * ResendSweeper. A restart flags the sessions already over their limit again;
+ * the row is unique per session, and a session that already had its row is
+ * not sent to Central again.
+ * State is only touched on the engine strand. A reloaded configuration is
+ * compiled at the next event or deadline and every open session rescheduled.
+ */
+class HoggingEngine
+{
+public:
+    static HoggingEngine* getInstance();
+    // After LotOccupancy, whose occupied lots are the sessions to start with
+    void FnHoggingEngineInitialization(boost::asio::io_context& io_context, const ServiceContext& services);
+
+    void FnOnParkIn(std::string_view lot_no, std::string_view lpn, lot_time_t lotInTime);
+    void FnOnParkOut(std::string_view lot_no);
+    // Charging state reported for the vehicle in the lot, idle time counts from the end of charging
+    void FnOnChargingChanged(std::string_view lot_no, bool charging, lot_time_t time);
+
+    // Open sessions flagged as hogging
+    std::size_t FnGetHoggingCount() const;
+
+    /*
+     * Singleton HoggingEngine cannot be cloneable
+     */
+    HoggingEngine(HoggingEngine& hoggingEngine) = delete;
+
+    /*
+     * Singleton HoggingEngine cannot be assignable
+     */
+    void operator=(const HoggingEngine&) = delete;
+
+private:
+    static ServiceInstance<HoggingEngine> instance_;
+    ServiceContext services_;
+    HoggingEngine();
+
+    static constexpr std::uint8_t NO_RULE = 0xFF;
+
+    // Compiled policy, limits in seconds (0 = not checked)
+    struct hoggingRule
+    {
+        std::int32_t maxDwellSec;
+        std::int32_t idleMaxSec;
+        std::int32_t graceSec;
+        std::uint16_t windowOffset;
+        // 0 = enforced all day
+        std::uint16_t windowCount;
+    };
+
+    // Minutes of the day [startMin, endMin), sorted by start within a rule
+    struct ruleWindow
+    {
+        std::uint16_t startMin;
+        std::uint16_t endMin;
+    };
+
+    struct ruleTable
+    {
+        const IniConfig* config;
+        std::vector<hoggingRule> rules;
+        std::vector<ruleWindow> windows;
+        std::vector<std::string> names;
+        // Rule of every lot, NO_RULE for a lot nothing applies to
+        std::vector<std::uint8_t> lotRules;
+    };
+
+    struct lotSession
+    {
+        // Bumped by every transition, a deadline pushed before it is stale
+        std::uint32_t generation;
+        bool occupied;
+        bool flagged;
+        InlineString<10> lpn;
+        lot_time_t lotInTime;
+        // Not set while charging or if charging was never reported
+        lot_time_t chargingEndTime;
+    };
+
+    struct lotDeadline
+    {
+        lot_time_t deadline;
+        std::uint32_t lot;
+        std::uint32_t generation;
+        hoggingReason reason;
+
+        bool operator>(const lotDeadline& other) const { return deadline > other.deadline; }
+    };
+
+    std::unique_ptr<boost::asio::strand<boost::asio::io_context::executor_type>> pStrand_;
+    std::unique_ptr<boost::asio::system_timer> pTimer_;
+
+    // Engine state, only touched on the strand
+    std::unique_ptr<const ruleTable> table_;
+    std::vector<lotSession> sessions_;
+    std::priority_queue<lotDeadline, std::vector<lotDeadline>, std::greater<lotDeadline>> deadlines_;
+    // Deadline the timer waits for, max while it waits for nothing
+    lot_time_t armedDeadline_;
+    std::atomic<std::size_t> hoggingCount_;
+
+    std::unique_ptr<const ruleTable> compile(const IniConfig* config, std::size_t lotCount) const;
+    static bool parseWindows(const std::string& windows, std::vector<ruleWindow>& compiled);
+    // First moment from time on that falls inside a window of rule
+    lot_time_t enforcedFrom(lot_time_t time, const hoggingRule& rule) const;
+
+    // Recompile after a configuration reload, true if the table changed
+    bool refreshTable();
+    // Every open session anew, after a reload or once stale deadlines piled up
+    void reschedule();
+    // The lot changed, its earlier deadline no longer counts
+    void transition(std::size_t lot);
+    void schedule(std::size_t lot);
+    void armTimer();
+    void onTimer();
+    void flag(std::size_t lot, hoggingReason reason, lot_time_t now);
+
+    void onParkIn(std::size_t lot, InlineString<10> lpn, lot_time_t lotInTime);
+    void onParkOut(std::size_t lot);
+    void onChargingChanged(std::size_t lot, bool charging, lot_time_t time);
+};
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "image_source.h"
+#include "log.h"
+
+ImageSource::ImageSource()
+    : mapping_(nullptr),
+    size_(0),
+    isOpen_(false)
+{
+
+}
+
+ImageSource::~ImageSource()
+{
+    FnClose();
+}
+
+ImageSource::ImageSource(ImageSource&& other) noexcept
+    : mapping_(other.mapping_),
+    buffer_(std::move(other.buffer_)),
+    size_(other.size_),
+    isOpen_(other.isOpen_)
+{
+    other.mapping_ = nullptr;
+    other.size_ = 0;
+    other.isOpen_ = false;
+}
+
+ImageSource& ImageSource::operator=(ImageSource&& other) noexcept
+{
+    if (this != &other)
+    {
+        FnClose();
+        mapping_ = other.mapping_;
+        buffer_ = std::move(other.buffer_);
+        size_ = other.size_;
+        isOpen_ = other.isOpen_;
+        other.mapping_ = nullptr;
+        other.size_ = 0;
+        other.isOpen_ = false;
+    }
+    return *this;
+}
+
+bool ImageSource::FnOpen(const std::string& image_path)
+{
+    FnClose();
+
+    int fd = open(image_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        std::ostringstream oss;
+        oss << "Error opening the image file :" << image_path << ", " << std::strerror(errno);
+        Logger::getInstance()->FnLog(oss.str(), "IMAGE");
+        return false;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0)
+    {
+        std::ostringstream oss;
+        oss << "Error stat the image file :" << image_path << ", " << std::strerror(errno);
+        Logger::getInstance()->FnLog(oss.str(), "IMAGE");
+        close(fd);
+        return false;
+    }
+
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+
+    if (size >= MMAP_THRESHOLD)
+    {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            close(fd);
+            mapping_ = mapping;
+            size_ = size;
+            isOpen_ = true;
+            return true;
+        }
+
+        std::ostringstream oss;
+        oss << "Error mapping the image file :" << image_path << ", " << std::strerror(errno) << ", fall back to read";
+        Logger::getInstance()->FnLog(oss.str(), "IMAGE");
+    }
+
+    // Not value-initialised, pread fills every byte
+    std::unique_ptr<unsigned char[]> buffer(new unsigned char[size > 0 ? size : 1]);
+    std::size_t offset = 0;
+    while (offset < size)
+    {
+        std::size_t chunk = std::min(READ_CHUNK_SIZE, size - offset);
+        ssize_t n = pread(fd, buffer.get() + offset, chunk, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            std::ostringstream oss;
+            oss << "Error reading the image file :" << image_path;
+            Logger::getInstance()->FnLog(oss.str(), "IMAGE");
+            close(fd);
+            return false;
+        }
+        offset += static_cast<std::size_t>(n);
+    }
+
+    close(fd);
+    buffer_ = std::move(buffer);
+    size_ = size;
+    isOpen_ = true;
+    return true;
+}
+
+void ImageSource::FnClose()
+{
+    if (mapping_ != nullptr)
+    {
+        munmap(mapping_, size_);
+        mapping_ = nullptr;
+    }
+    buffer_.reset();
+    size_ = 0;
+    isOpen_ = false;
+}
+
+bool ImageSource::FnIsOpen() const
+{
+    return isOpen_;
+}
+
+bool ImageSource::FnIsMapped() const
+{
+    return mapping_ != nullptr;
+}
+
+const unsigned char* ImageSource::FnGetData() const
+{
+    return (mapping_ != nullptr) ? static_cast<const unsigned char*>(mapping_) : buffer_.get();
+}
+
+std::size_t ImageSource::FnGetSize() const
+{
+    return size_;
+}
+
+boost::asio::const_buffer ImageSource::FnGetBuffer() const
+{
+    return boost::asio::const_buffer(FnGetData(), size_);
+}
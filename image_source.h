@@ -0,0 +1,51 @@
+#pragma once
+
+#include <boost/asio/buffer.hpp>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/*
+ * Read-only view of an image file.
+ * Large files are mmap'd (MADV_SEQUENTIAL) so their bytes stay in the page
+ * cache and are never copied to the heap. Small files are read with pread in
+ * chunks into an uninitialised buffer, where a mapping would cost more than
+ * the copy.
+ */
+class ImageSource
+{
+public:
+    static constexpr std::size_t MMAP_THRESHOLD = 64 * 1024;
+    static constexpr std::size_t READ_CHUNK_SIZE = 16 * 1024;
+
+    ImageSource();
+    ~ImageSource();
+
+    ImageSource(ImageSource&& other) noexcept;
+    ImageSource& operator=(ImageSource&& other) noexcept;
+
+    /*
+     * ImageSource owns a mapping, it should not be cloneable
+     */
+    ImageSource(const ImageSource&) = delete;
+
+    /*
+     * ImageSource owns a mapping, it should not be assignable
+     */
+    ImageSource& operator=(const ImageSource&) = delete;
+
+    bool FnOpen(const std::string& image_path);
+    void FnClose();
+    bool FnIsOpen() const;
+    bool FnIsMapped() const;
+
+    const unsigned char* FnGetData() const;
+    std::size_t FnGetSize() const;
+    boost::asio::const_buffer FnGetBuffer() const;
+
+private:
+    void* mapping_;
+    std::unique_ptr<unsigned char[]> buffer_;
+    std::size_t size_;
+    bool isOpen_;
+};
@@ -0,0 +1,566 @@
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <unistd.h>
+#include "database.h"
+#include "image_source.h"
+#include "image_store.h"
+#include "ini_parser.h"
+#include "log.h"
+
+namespace
+{
+
+// A run over quota evicts down to this share of it, not just below it
+const std::uint64_t EVICT_TARGET_PERCENT = 90;
+// Files removed per turn on the strand
+const std::size_t EVICT_BATCH = 256;
+const std::size_t HASH_DIGITS = 16;
+const std::size_t MAX_EXTENSION_SIZE = 7;
+// Left behind by a copy across file systems that did not finish
+const std::string TEMP_SUFFIX = ".tmp";
+
+const std::uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+const std::uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+const std::uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+const std::uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+const std::uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+inline std::uint64_t rotl64(std::uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline std::uint64_t read64(const unsigned char* p)
+{
+    std::uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline std::uint32_t read32(const unsigned char* p)
+{
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline std::uint64_t xxhRound(std::uint64_t acc, std::uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+inline std::uint64_t xxhMergeRound(std::uint64_t acc, std::uint64_t value)
+{
+    acc ^= xxhRound(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+std::string hexOf(std::uint64_t hash)
+{
+    char digits[HASH_DIGITS + 1];
+    std::snprintf(digits, sizeof(digits), "%016llx", static_cast<unsigned long long>(hash));
+    return std::string(digits, HASH_DIGITS);
+}
+
+}
+
+ServiceInstance<ImageStore> ImageStore::instance_;
+
+ImageStore::ImageStore()
+    : enabled_(false),
+    usedBytes_(0),
+    nextCandidate_(0),
+    evictTarget_(0),
+    evicted_(0)
+{
+
+}
+
+ImageStore* ImageStore::getInstance()
+{
+    return instance_.get([]() { return new ImageStore(); });
+}
+
+void ImageStore::FnImageStoreInitialization(boost::asio::io_context& io_context, const ServiceContext& services)
+{
+    services_ = services;
+    const IniConfig* config = services_.iniParser->FnGetConfig();
+    pStrand_ = std::make_unique<boost::asio::strand<boost::asio::io_context::executor_type>>(io_context.get_executor());
+    pTimer_ = std::make_unique<boost::asio::steady_timer>(*pStrand_);
+
+    if (!config->imageStoreEnabled)
+    {
+        services_.logger->FnLog("Image store disabled, images stay where they are taken.", "IMAGE");
+        return;
+    }
+
+    rootDir_ = config->imageStoreRootDir;
+    while ((rootDir_.size() > 1) && (rootDir_.back() == '/'))
+    {
+        rootDir_.pop_back();
+    }
+    scan();
+    enabled_ = true;
+
+    std::ostringstream oss;
+    oss << "Image store " << rootDir_ << " holds " << FnGetImageCount() << " images, " << (FnGetUsedBytes() / (1024 * 1024)) << " MB.";
+    services_.logger->FnLog(oss.str(), "IMAGE");
+
+    boost::asio::post(*pStrand_, [this]() {
+        scheduleEvict(std::chrono::milliseconds(0));
+    });
+}
+
+std::string ImageStore::FnPut(const std::string& image_path)
+{
+    if (!enabled_ || image_path.empty())
+    {
+        return image_path;
+    }
+
+    ImageSource image;
+    if (!image.FnOpen(image_path))
+    {
+        return image_path;
+    }
+
+    // Hashed before taking the lock, the store waits for no file read but the comparison of a duplicate
+    std::uint64_t hash = FnHashContent(image.FnGetData(), image.FnGetSize());
+    std::uint64_t size = image.FnGetSize();
+    std::string extension = boost::filesystem::path(image_path).extension().string();
+    if (extension.size() > MAX_EXTENSION_SIZE)
+    {
+        extension.clear();
+    }
+    lot_time_t now = std::chrono::system_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = images_.find(hash);
+    if (it != images_.end())
+    {
+        std::string stored = pathOf(hash, it->second.extension.view());
+
+        // A row referring to the stored image again, e.g. a park out copying the park in image
+        if (stored == image_path)
+        {
+            it->second.references++;
+            it->second.lastPut = now;
+            return stored;
+        }
+
+        if (sameContent(stored, image.FnGetData(), image.FnGetSize()))
+        {
+            it->second.references++;
+            it->second.lastPut = now;
+            image.FnClose();
+            if (::unlink(image_path.c_str()) != 0)
+            {
+                std::ostringstream oss;
+                oss << "Error removing the duplicate image :" << image_path << ", " << std::strerror(errno);
+                services_.logger->FnLog(oss.str(), "IMAGE");
+            }
+            return stored;
+        }
+
+        if (::access(stored.c_str(), F_OK) == 0)
+        {
+            std::ostringstream oss;
+            oss << "Image " << image_path << " has the hash of " << stored << " but not its content, not stored.";
+            services_.logger->FnLog(oss.str(), "IMAGE");
+            return image_path;
+        }
+
+        // Removed from under the store, the new copy takes its place
+        usedBytes_.fetch_sub(it->second.size, std::memory_order_relaxed);
+        images_.erase(it);
+    }
+
+    image.FnClose();
+    std::string stored = pathOf(hash, extension);
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(shardDir(hash), ec);
+    if (ec || !moveFile(image_path, stored))
+    {
+        std::ostringstream oss;
+        oss << "Error storing the image :" << image_path << " as " << stored << (ec ? ", " + ec.message() : "");
+        services_.logger->FnLog(oss.str(), "IMAGE");
+        return image_path;
+    }
+
+    images_.emplace(hash, storedImage{size, now, 1, InlineString<7>(extension)});
+    usedBytes_.fetch_add(size, std::memory_order_relaxed);
+    return stored;
+}
+
+std::size_t ImageStore::FnGetImageCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return images_.size();
+}
+
+std::uint64_t ImageStore::FnGetUsedBytes() const
+{
+    return usedBytes_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t ImageStore::FnHashContent(const unsigned char* data, std::size_t size)
+{
+    // XXH64 with seed 0, its reference test vectors give the same results
+    const unsigned char* p = data;
+    const unsigned char* const end = data + size;
+    std::uint64_t hash;
+
+    if (size >= 32)
+    {
+        std::uint64_t v1 = PRIME64_1 + PRIME64_2;
+        std::uint64_t v2 = PRIME64_2;
+        std::uint64_t v3 = 0;
+        std::uint64_t v4 = 0 - PRIME64_1;
+        const unsigned char* const limit = end - 32;
+        do
+        {
+            v1 = xxhRound(v1, read64(p));
+            v2 = xxhRound(v2, read64(p + 8));
+            v3 = xxhRound(v3, read64(p + 16));
+            v4 = xxhRound(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = xxhMergeRound(hash, v1);
+        hash = xxhMergeRound(hash, v2);
+        hash = xxhMergeRound(hash, v3);
+        hash = xxhMergeRound(hash, v4);
+    }
+    else
+    {
+        hash = PRIME64_5;
+    }
+
+    hash += static_cast<std::uint64_t>(size);
+
+    while (p + 8 <= end)
+    {
+        hash ^= xxhRound(0, read64(p));
+        hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end)
+    {
+        hash ^= static_cast<std::uint64_t>(read32(p)) * PRIME64_1;
+        hash = rotl64(hash, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while (p < end)
+    {
+        hash ^= (*p) * PRIME64_5;
+        hash = rotl64(hash, 11) * PRIME64_1;
+        p++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+std::string ImageStore::shardDir(std::uint64_t hash) const
+{
+    std::string hex = hexOf(hash);
+    return rootDir_ + "/" + hex.substr(0, 2) + "/" + hex.substr(2, 2);
+}
+
+std::string ImageStore::pathOf(std::uint64_t hash, std::string_view extension) const
+{
+    std::string hex = hexOf(hash);
+    std::string path = rootDir_ + "/" + hex.substr(0, 2) + "/" + hex.substr(2, 2) + "/" + hex;
+    path.append(extension);
+    return path;
+}
+
+bool ImageStore::parsePath(std::string_view path, std::uint64_t& hash) const
+{
+    // rootDir/ab/cd/abcd<12 more digits><extension>
+    if ((path.size() <= rootDir_.size()) || (path.substr(0, rootDir_.size()) != rootDir_))
+    {
+        return false;
+    }
+    std::string_view rest = path.substr(rootDir_.size());
+    if ((rest.size() < 7 + HASH_DIGITS) || (rest[0] != '/') || (rest[3] != '/') || (rest[6] != '/'))
+    {
+        return false;
+    }
+
+    std::string_view digits = rest.substr(7, HASH_DIGITS);
+    std::string_view extension = rest.substr(7 + HASH_DIGITS);
+    if ((rest.substr(1, 2) != digits.substr(0, 2)) || (rest.substr(4, 2) != digits.substr(2, 2)) ||
+        (extension.size() > MAX_EXTENSION_SIZE) || (!extension.empty() && (extension[0] != '.')))
+    {
+        return false;
+    }
+    if (!std::all_of(digits.begin(), digits.end(), [](char c) { return ((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'f')); }))
+    {
+        return false;
+    }
+
+    std::from_chars_result result = std::from_chars(digits.data(), digits.data() + digits.size(), hash, 16);
+    return result.ec == std::errc();
+}
+
+bool ImageStore::sameContent(const std::string& path, const unsigned char* data, std::size_t size)
+{
+    if (::access(path.c_str(), F_OK) != 0)
+    {
+        return false;
+    }
+
+    ImageSource stored;
+    return stored.FnOpen(path) && (stored.FnGetSize() == size) && (std::memcmp(stored.FnGetData(), data, size) == 0);
+}
+
+bool ImageStore::moveFile(const std::string& from, const std::string& to) const
+{
+    if (::rename(from.c_str(), to.c_str()) == 0)
+    {
+        return true;
+    }
+    if (errno != EXDEV)
+    {
+        std::ostringstream oss;
+        oss << "Error moving the image :" << from << ", " << std::strerror(errno);
+        services_.logger->FnLog(oss.str(), "IMAGE");
+        return false;
+    }
+
+    // Copied next to its place and renamed, the store never holds part of an image under its hash
+    std::string temp = to + TEMP_SUFFIX;
+    boost::system::error_code ec;
+    boost::filesystem::copy_file(from, temp, boost::filesystem::copy_options::overwrite_existing, ec);
+    if (ec || (::rename(temp.c_str(), to.c_str()) != 0))
+    {
+        std::ostringstream oss;
+        oss << "Error copying the image :" << from << ", " << (ec ? ec.message() : std::strerror(errno));
+        services_.logger->FnLog(oss.str(), "IMAGE");
+        ::unlink(temp.c_str());
+        return false;
+    }
+
+    ::unlink(from.c_str());
+    return true;
+}
+
+void ImageStore::scan()
+{
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(rootDir_, ec);
+    if (ec)
+    {
+        services_.logger->FnLog("Error creating the image store " + rootDir_ + ", " + ec.message(), "IMAGE");
+        return;
+    }
+
+    // Removed once the walk is over, the iterator looks at its current entry to go on
+    std::vector<boost::filesystem::path> leftovers;
+    std::lock_guard<std::mutex> lock(mutex_);
+    boost::filesystem::recursive_directory_iterator end;
+    for (boost::filesystem::recursive_directory_iterator it(rootDir_, ec); !ec && (it != end); it.increment(ec))
+    {
+        boost::system::error_code fileEc;
+        if (!boost::filesystem::is_regular_file(it->status(fileEc)))
+        {
+            continue;
+        }
+
+        std::string path = it->path().string();
+        if ((path.size() > TEMP_SUFFIX.size()) && (path.compare(path.size() - TEMP_SUFFIX.size(), TEMP_SUFFIX.size(), TEMP_SUFFIX) == 0))
+        {
+            leftovers.push_back(it->path());
+            continue;
+        }
+
+        // Anything else under rootDir is not the store's, it is left alone
+        std::uint64_t hash;
+        if (!parsePath(path, hash))
+        {
+            continue;
+        }
+
+        std::uint64_t size = boost::filesystem::file_size(it->path(), fileEc);
+        std::time_t modified = boost::filesystem::last_write_time(it->path(), fileEc);
+        if (fileEc)
+        {
+            continue;
+        }
+
+        std::string_view extension = std::string_view(path).substr(path.size() - it->path().extension().string().size());
+        if (images_.emplace(hash, storedImage{size, std::chrono::system_clock::from_time_t(modified), 0, InlineString<7>(extension)}).second)
+        {
+            usedBytes_.fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+
+    if (ec)
+    {
+        services_.logger->FnLog("Error reading the image store " + rootDir_ + ", " + ec.message(), "IMAGE");
+    }
+
+    for (const boost::filesystem::path& leftover : leftovers)
+    {
+        boost::filesystem::remove(leftover, ec);
+    }
+}
+
+void ImageStore::scheduleEvict(std::chrono::milliseconds delay)
+{
+    pTimer_->expires_after(delay);
+    pTimer_->async_wait(boost::asio::bind_executor(*pStrand_, [this](const boost::system::error_code& ec) {
+        if (ec)
+        {
+            return;
+        }
+        evict();
+    }));
+}
+
+void ImageStore::evict()
+{
+    const IniConfig* config = services_.iniParser->FnGetConfig();
+    std::chrono::milliseconds interval(std::max(config->imageStoreEvictIntervalMs, 1000));
+    std::uint64_t quota = static_cast<std::uint64_t>(std::max(config->imageStoreQuotaMb, 0)) * 1024 * 1024;
+
+    if ((quota == 0) || (FnGetUsedBytes() <= quota))
+    {
+        scheduleEvict(interval);
+        return;
+    }
+
+    if (!recount())
+    {
+        services_.logger->FnLog("Image references not counted, eviction put off.", "IMAGE");
+        scheduleEvict(interval);
+        return;
+    }
+
+    // Young images are spared as well: their row may have been written while
+    // the recount ran, or still be in the write journal
+    lot_time_t cutoff = std::chrono::system_clock::now() - std::chrono::seconds(std::max(config->imageStoreEvictMinAgeSec, 0));
+    candidates_.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [hash, image] : images_)
+        {
+            if ((image.references <= 0) && (image.lastPut < cutoff))
+            {
+                candidates_.push_back(evictCandidate{image.lastPut, hash});
+            }
+        }
+    }
+    std::sort(candidates_.begin(), candidates_.end(), [](const evictCandidate& a, const evictCandidate& b) { return a.lastPut < b.lastPut; });
+
+    nextCandidate_ = 0;
+    evictTarget_ = quota / 100 * EVICT_TARGET_PERCENT;
+    evicted_ = 0;
+    evictBatch();
+}
+
+bool ImageStore::recount()
+{
+    // Rows in the journal refer to their images but are not in the table yet
+    if (services_.mariaDb->FnGetJournalPendingCount() > 0)
+    {
+        return false;
+    }
+
+    lot_time_t started = std::chrono::system_clock::now();
+    std::vector<std::pair<std::string, long>> references;
+    if (!services_.mariaDb->FnSelectEvLotTransImageReferences(rootDir_ + "/", references))
+    {
+        return false;
+    }
+
+    std::unordered_map<std::uint64_t, long> counts;
+    counts.reserve(references.size());
+    for (const auto& [path, count] : references)
+    {
+        std::uint64_t hash;
+        if (parsePath(path, hash))
+        {
+            counts[hash] += count;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [hash, image] : images_)
+    {
+        if (image.lastPut >= started)
+        {
+            continue;
+        }
+        auto it = counts.find(hash);
+        image.references = (it != counts.end()) ? it->second : 0;
+    }
+    return true;
+}
+
+void ImageStore::evictBatch()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::size_t end = std::min(nextCandidate_ + EVICT_BATCH, candidates_.size());
+        for (; (nextCandidate_ < end) && (FnGetUsedBytes() > evictTarget_); nextCandidate_++)
+        {
+            const evictCandidate& candidate = candidates_[nextCandidate_];
+            auto it = images_.find(candidate.hash);
+
+            // Put again since it was picked
+            if ((it == images_.end()) || (it->second.references > 0) || (it->second.lastPut != candidate.lastPut))
+            {
+                continue;
+            }
+
+            std::string path = pathOf(candidate.hash, it->second.extension.view());
+            if ((::unlink(path.c_str()) != 0) && (errno != ENOENT))
+            {
+                std::ostringstream oss;
+                oss << "Error removing the image :" << path << ", " << std::strerror(errno);
+                services_.logger->FnLog(oss.str(), "IMAGE");
+                continue;
+            }
+
+            usedBytes_.fetch_sub(it->second.size, std::memory_order_relaxed);
+            images_.erase(it);
+            evicted_++;
+        }
+    }
+
+    // The next batch after whatever else is waiting on the io_context
+    if ((nextCandidate_ < candidates_.size()) && (FnGetUsedBytes() > evictTarget_))
+    {
+        boost::asio::post(*pStrand_, [this]() {
+            evictBatch();
+        });
+        return;
+    }
+
+    const IniConfig* config = services_.iniParser->FnGetConfig();
+    std::ostringstream oss;
+    oss << "Evicted " << evicted_ << " images, " << (FnGetUsedBytes() / (1024 * 1024)) << " MB of " << config->imageStoreQuotaMb << " MB in use";
+    if (FnGetUsedBytes() > evictTarget_)
+    {
+        oss << ", the rest is referenced or recent";
+    }
+    services_.logger->FnLog(oss.str(), "IMAGE");
+
+    candidates_.clear();
+    candidates_.shrink_to_fit();
+    scheduleEvict(std::chrono::milliseconds(std::max(config->imageStoreEvictIntervalMs, 1000)));
+}
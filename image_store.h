@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "lot_record.h"
+#include "service.h"
+
+/*
+ * Content-addressed store of the snapshot images.
+ * FnPut takes an image over into rootDir under the 64-bit XXH64 hash of its
+ * content, in two levels of 256 shard directories (ab/cd/abcd...jpg), so a
+ * directory holds a few entries even with hundreds of thousands of images. A
+ * snapshot identical to a stored one is not kept, its row refers to the
+ * stored file; contents are compared byte for byte before that.
+ * The index of the stored images is in memory, read from rootDir once at
+ * startup. An image is referenced by the tbl_ev_lot_trans columns holding its
+ * path: a FnPut counts one reference, and since retention removes rows behind
+ * its back the evictor recounts them from the table (two index ranges) before
+ * removing anything. The recount waits for the write journal to drain, rows
+ * still in it are not in the table.
+ * Every evictIntervalMs a store over quotaMb has its unreferenced images
+ * older than evictMinAgeSec removed, least recently put first, until it is
+ * back under 90% of the quota; a batch at a time on the strand, taking turns
+ * with FnPut. Referenced images are never removed.
+ */
+class ImageStore
+{
+public:
+    static ImageStore* getInstance();
+    // Indexes rootDir and starts the evictor, before the first park event
+    void FnImageStoreInitialization(boost::asio::io_context& io_context, const ServiceContext& services);
+
+    // Path of the stored image for the row to refer to; image_path itself if it was not stored
+    std::string FnPut(const std::string& image_path);
+
+    std::size_t FnGetImageCount() const;
+    std::uint64_t FnGetUsedBytes() const;
+
+    static std::uint64_t FnHashContent(const unsigned char* data, std::size_t size);
+
+    /*
+     * Singleton ImageStore cannot be cloneable
+     */
+    ImageStore(ImageStore& imageStore) = delete;
+
+    /*
+     * Singleton ImageStore cannot be assignable
+     */
+    void operator=(const ImageStore&) = delete;
+
+private:
+    static ServiceInstance<ImageStore> instance_;
+    ServiceContext services_;
+    ImageStore();
+
+    struct storedImage
+    {
+        std::uint64_t size;
+        // Last FnPut of the content, the file time for those found at startup
+        lot_time_t lastPut;
+        long references;
+        InlineString<7> extension;
+    };
+
+    struct evictCandidate
+    {
+        lot_time_t lastPut;
+        std::uint64_t hash;
+    };
+
+    std::unique_ptr<boost::asio::strand<boost::asio::io_context::executor_type>> pStrand_;
+    std::unique_ptr<boost::asio::steady_timer> pTimer_;
+
+    bool enabled_;
+    std::string rootDir_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::uint64_t, storedImage> images_;
+    std::atomic<std::uint64_t> usedBytes_;
+
+    // Eviction run state, only touched on the strand
+    std::vector<evictCandidate> candidates_;
+    std::size_t nextCandidate_;
+    std::uint64_t evictTarget_;
+    std::size_t evicted_;
+
+    std::string shardDir(std::uint64_t hash) const;
+    std::string pathOf(std::uint64_t hash, std::string_view extension) const;
+    // Hash of a path in the store, false for any other path
+    bool parsePath(std::string_view path, std::uint64_t& hash) const;
+    static bool sameContent(const std::string& path, const unsigned char* data, std::size_t size);
+    // Moved if rootDir is on the same file system, copied and removed otherwise
+    bool moveFile(const std::string& from, const std::string& to) const;
+    void scan();
+
+    void scheduleEvict(std::chrono::milliseconds delay);
+    void evict();
+    // References from tbl_ev_lot_trans, those put since the select started are left as they are
+    bool recount();
+    void evictBatch();
+};
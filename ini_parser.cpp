@@ -1,56 +1,134 @@
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <boost/filesystem.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/ini_parser.hpp>
+#include <sys/inotify.h>
+#include <unistd.h>
 #include "ini_parser.h"
+#include "log.h"
 
-IniParser* IniParser::iniParser_ = nullptr;
-std::mutex IniParser::mutex_;
+ServiceInstance<IniParser> IniParser::instance_;
 
 IniParser::IniParser()
-    : cameraIP_(""),
-    centralIP_(""),
-    centralServerPort_(0),
-    parkingLotLocationCode_(""),
-    timerForFilteringSnapshot_(0),
-    timerTimeoutForDeviceStatusUpdateToCentral_(0),
-    timerCentralHeartbeat_(0)
+    : config_(nullptr)
 {
-
+    publishConfig(std::make_unique<const IniConfig>());
 }
 
 IniParser* IniParser::getInstance()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (iniParser_ == nullptr)
-    {
-        iniParser_ = new IniParser();
-    }
-    return iniParser_;
+    return instance_.get([]() { return new IniParser(); });
 }
 
 bool IniParser::FnReadIniFile()
+{
+    return FnReadIniFile(INI_FILE_ABSOLUTE_PATH);
+}
+
+bool IniParser::FnReadIniFile(const std::string& iniFilePath)
 {
     bool ret = false;
 
     try
     {
-        if (!(boost::filesystem::exists(INI_FILE_PATH)))
+        if (!(boost::filesystem::exists(iniFilePath)))
         {
-            throw std::runtime_error("Ini file path: " + INI_FILE_PATH + " not exists.");
+            throw std::runtime_error("Ini file: " + iniFilePath + " not exists.");
         }
         
         boost::property_tree::ptree pt;
-        boost::property_tree::ini_parser::read_ini(INI_FILE_ABSOLUTE_PATH, pt);
+        boost::property_tree::ini_parser::read_ini(iniFilePath, pt);
+
+        std::unique_ptr<IniConfig> config = std::make_unique<IniConfig>();
+        config->cameraIP                                    = pt.get<std::string>("setting.cameraIP", "");
+        config->centralIP                                   = pt.get<std::string>("setting.centralIP", "");
+        config->centralServerPort                           = pt.get<int>("setting.centralServerPort");
+        config->parkingLotLocationCode                      = pt.get<std::string>("setting.parkingLotLocationCode");
+        config->parkingLotCount                             = pt.get<int>("setting.parkingLotCount", 200);
+        config->timerForFilteringSnapshot                   = pt.get<int>("setting.timerForFilteringSnapshot");
+        config->timerTimeoutForDeviceStatusUpdateToCentral  = pt.get<int>("setting.timerTimeoutForDeviceStatusUpdateToCentral");
+        config->timerCentralHeartbeat                       = pt.get<int>("setting.timerCentralHeartbeat");
+        config->networkInterface                            = pt.get<std::string>("setting.networkInterface", "eth0");
+        config->ioThreadCount                               = pt.get<int>("topology.ioThreadCount", 6);
+        config->ioContextPerThread                          = pt.get<bool>("topology.ioContextPerThread", false);
+        config->ioThreadCpuAffinity                         = parseIntList(pt.get<std::string>("topology.ioThreadCpuAffinity", ""));
+        config->cameraServerIP                              = pt.get<std::string>("topology.cameraServerIP", "192.168.2.150");
+        config->cameraServerPort                            = pt.get<int>("topology.cameraServerPort", 9999);
+        config->cameraServerThreads                         = parseIntList(pt.get<std::string>("topology.cameraServerThreads", ""));
+        config->timerThread                                 = pt.get<int>("topology.timerThread", 0);
+        config->centralThread                               = pt.get<int>("topology.centralThread", 0);
+        config->centralConnectTimeoutMs                     = pt.get<int>("central.connectTimeoutMs", 5000);
+        config->centralWriteTimeoutMs                       = pt.get<int>("central.writeTimeoutMs", 10000);
+        config->centralReadTimeoutMs                        = pt.get<int>("central.readTimeoutMs", 10000);
+        config->centralMaxAttempts                          = pt.get<int>("central.maxAttempts", 3);
+        config->centralRetryDelayMs                         = pt.get<int>("central.retryDelayMs", 500);
+        config->centralCompression                          = pt.get<std::string>("central.compression", "none");
+        config->centralCompressionLevel                     = pt.get<int>("central.compressionLevel", 1);
+        config->centralCompressionStrategy                  = pt.get<std::string>("central.compressionStrategy", "huffman");
+        config->centralCompressionMinBytes                  = pt.get<int>("central.compressionMinBytes", 1024);
+        config->centralTls                                  = pt.get<bool>("central.tls", false);
+        config->centralTlsVerify                            = pt.get<bool>("central.tlsVerify", true);
+        config->centralTlsCaFile                            = pt.get<std::string>("central.tlsCaFile", "");
+        config->centralTlsSessionResumption                 = pt.get<bool>("central.tlsSessionResumption", true);
+        config->centralKeepAlive                            = pt.get<bool>("central.keepAlive", false);
+        config->centralKeepAliveIdleTimeoutMs               = pt.get<int>("central.keepAliveIdleTimeoutMs", 15000);
+        config->databaseJournalFile                         = pt.get<std::string>("database.journalFile", "/home/root/ev_charging_hogging/db_journal.bin");
+        config->databaseJournalCapacityMb                   = pt.get<int>("database.journalCapacityMb", 64);
+        config->databaseJournalReplayBatch                  = pt.get<int>("database.journalReplayBatch", 200);
+        config->databaseJournalReplayIntervalMs             = pt.get<int>("database.journalReplayIntervalMs", 1000);
+        config->databaseKeepaliveIntervalMs                 = pt.get<int>("database.keepaliveIntervalMs", 30000);
+        config->databaseReconnectBaseMs                     = pt.get<int>("database.reconnectBaseMs", 1000);
+        config->databaseReconnectMaxMs                      = pt.get<int>("database.reconnectMaxMs", 30000);
+        config->databaseRetentionDays                       = pt.get<int>("database.retentionDays", 90);
+        config->databaseRetentionIntervalMs                 = pt.get<int>("database.retentionIntervalMs", 3600000);
+        config->databaseRetentionChunkRows                  = pt.get<int>("database.retentionChunkRows", 500);
+        config->databaseRetentionChunkDelayMs               = pt.get<int>("database.retentionChunkDelayMs", 200);
+        config->databaseRetentionMonthsAhead                = pt.get<int>("database.retentionMonthsAhead", 2);
+        config->centralCircuitFailureThreshold              = pt.get<int>("central.circuitFailureThreshold", 5);
+        config->centralCircuitOpenBaseMs                    = pt.get<int>("central.circuitOpenBaseMs", 5000);
+        config->centralCircuitOpenMaxMs                     = pt.get<int>("central.circuitOpenMaxMs", 300000);
+        config->centralResendSweepIntervalMs                = pt.get<int>("central.resendSweepIntervalMs", 30000);
+        config->centralResendBatchSize                      = pt.get<int>("central.resendBatchSize", 20);
+        config->centralResendRatePerSec                     = pt.get<int>("central.resendRatePerSec", 5);
+        config->centralResendMinAgeSec                      = pt.get<int>("central.resendMinAgeSec", 60);
+        config->centralBatchMaxEvents                       = pt.get<int>("central.batchMaxEvents", 1);
+        config->centralBatchMaxDelayMs                      = pt.get<int>("central.batchMaxDelayMs", 200);
+        config->centralBatchTarget                          = pt.get<std::string>("central.batchTarget", "/ParkInOutBatch");
+        config->hoggingEnabled                              = pt.get<bool>("hogging.enabled", true);
+        config->hoggingDefaultPolicy                        = pt.get<std::string>("hogging.defaultPolicy", "");
+        config->hoggingLotPolicies                          = pt.get<std::string>("hogging.lotPolicies", "");
+        config->statisticsFlushIntervalMs                   = pt.get<int>("statistics.flushIntervalMs", 300000);
+        config->statisticsHistoryHours                      = pt.get<int>("statistics.historyHours", 24);
+        config->imageStoreEnabled                           = pt.get<bool>("imageStore.enabled", true);
+        config->imageStoreRootDir                           = pt.get<std::string>("imageStore.rootDir", "/home/root/ev_charging_hogging/images");
+        config->imageStoreQuotaMb                           = pt.get<int>("imageStore.quotaMb", 2048);
+        config->imageStoreEvictIntervalMs                   = pt.get<int>("imageStore.evictIntervalMs", 600000);
+        config->imageStoreEvictMinAgeSec                    = pt.get<int>("imageStore.evictMinAgeSec", 3600);
+
+        // Every listed policy must have its section and a name that fits its column
+        for (const std::string& name : parseStringList(pt.get<std::string>("hogging.policies", "")))
+        {
+            if (name.size() > hoggingPolicyConfig::NAME_MAX_LENGTH)
+            {
+                throw std::invalid_argument("Hogging policy name " + name + " longer than " +
+                                            std::to_string(hoggingPolicyConfig::NAME_MAX_LENGTH) + " characters");
+            }
 
-        cameraIP_                                       = pt.get<std::string>("setting.cameraIP", "");
-        centralIP_                                      = pt.get<std::string>("setting.centralIP", "");
-        centralServerPort_                              = pt.get<int>("setting.centralServerPort");
-        parkingLotLocationCode_                         = pt.get<std::string>("setting.parkingLotLocationCode");
-        timerForFilteringSnapshot_                      = pt.get<int>("setting.timerForFilteringSnapshot");
-        timerTimeoutForDeviceStatusUpdateToCentral_     = pt.get<int>("setting.timerTimeoutForDeviceStatusUpdateToCentral");
-        timerCentralHeartbeat_                          = pt.get<int>("setting.timerCentralHeartbeat");
+            const boost::property_tree::ptree& section = pt.get_child("hoggingPolicy_" + name);
+            hoggingPolicyConfig policy;
+            policy.name                                     = name;
+            policy.maxDwellMin                              = section.get<int>("maxDwellMin", 0);
+            policy.graceMin                                 = section.get<int>("graceMin", 0);
+            policy.idleMaxMin                               = section.get<int>("idleMaxMin", 0);
+            policy.windows                                  = section.get<std::string>("windows", "");
+            config->hoggingPolicies.push_back(std::move(policy));
+        }
+
+        // Only a fully parsed file replaces the current snapshot
+        publishConfig(std::move(config));
 
         ret = true;
     }
@@ -82,37 +160,156 @@ bool IniParser::FnReadIniFile()
     return ret;
 }
 
+std::vector<int> IniParser::parseIntList(const std::string& str)
+{
+    std::vector<int> values;
+    std::istringstream iss(str);
+    std::string item;
+
+    while (std::getline(iss, item, ','))
+    {
+        if (!item.empty())
+        {
+            values.push_back(std::stoi(item));
+        }
+    }
+
+    return values;
+}
+
+std::vector<std::string> IniParser::parseStringList(const std::string& str)
+{
+    std::vector<std::string> values;
+    std::istringstream iss(str);
+    std::string item;
+
+    while (std::getline(iss, item, ','))
+    {
+        std::size_t first = item.find_first_not_of(" \t");
+        if (first != std::string::npos)
+        {
+            values.push_back(item.substr(first, item.find_last_not_of(" \t") - first + 1));
+        }
+    }
+
+    return values;
+}
+
+void IniParser::publishConfig(std::unique_ptr<const IniConfig> config)
+{
+    std::lock_guard<std::mutex> lock(publishMutex_);
+    config_.store(config.get(), std::memory_order_release);
+    configHistory_.push_back(std::move(config));
+}
+
+void IniParser::FnIniFileWatcherInitialization(boost::asio::io_context& io_context)
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+    {
+        Logger::getInstance()->FnLog("Failed to initialize inotify, configuration hot reload disabled.", "INI");
+        return;
+    }
+
+    // Watch the directory: editors and scp replace the file rather than rewrite it in place
+    if (inotify_add_watch(fd, INI_FILE_PATH.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        Logger::getInstance()->FnLog("Failed to watch " + INI_FILE_PATH + ", configuration hot reload disabled.", "INI");
+        close(fd);
+        return;
+    }
+
+    pInotifyDescriptor_ = std::make_unique<boost::asio::posix::stream_descriptor>(io_context, fd);
+    startIniFileWatch();
+}
+
+void IniParser::startIniFileWatch()
+{
+    pInotifyDescriptor_->async_read_some(boost::asio::buffer(inotifyBuffer_),
+                                    std::bind(&IniParser::onIniFileEvent, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+void IniParser::onIniFileEvent(const boost::system::error_code& ec, std::size_t bytes_transferred)
+{
+    if (ec)
+    {
+        if (ec != boost::asio::error::operation_aborted)
+        {
+            std::ostringstream oss;
+            oss << "Inotify read Exception :" << ec.message();
+            Logger::getInstance()->FnLog(oss.str(), "INI");
+        }
+        return;
+    }
+
+    bool changed = false;
+    std::size_t offset = 0;
+    while (offset + sizeof(struct inotify_event) <= bytes_transferred)
+    {
+        const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(inotifyBuffer_.data() + offset);
+        if (event->len > 0 && INI_FILE_NAME == event->name)
+        {
+            changed = true;
+        }
+        offset += sizeof(struct inotify_event) + event->len;
+    }
+
+    if (changed)
+    {
+        if (FnReadIniFile())
+        {
+            Logger::getInstance()->FnLog("Configuration reloaded from " + INI_FILE_ABSOLUTE_PATH, "INI");
+        }
+        else
+        {
+            Logger::getInstance()->FnLog("Failed to reload " + INI_FILE_ABSOLUTE_PATH + ", keep previous configuration.", "INI");
+        }
+    }
+
+    startIniFileWatch();
+}
+
+const IniConfig* IniParser::FnGetConfig() const
+{
+    return config_.load(std::memory_order_acquire);
+}
+
 std::string IniParser::FnGetCameraIP() const
 {
-    return cameraIP_;
+    return FnGetConfig()->cameraIP;
 }
 
 std::string IniParser::FnGetCentralIP() const
 {
-    return centralIP_;
+    return FnGetConfig()->centralIP;
 }
 
 int IniParser::FnGetCentralServerPort() const
 {
-    return centralServerPort_;
+    return FnGetConfig()->centralServerPort;
 }
 
 std::string IniParser::FnGetParkingLotLocationCode() const
 {
-    return parkingLotLocationCode_;
+    return FnGetConfig()->parkingLotLocationCode;
 }
 
 int IniParser::FnGetTimerForFilteringSnapshot() const
 {
-    return timerForFilteringSnapshot_;
+    return FnGetConfig()->timerForFilteringSnapshot;
 }
 
 int IniParser::FnGetTimerTimeoutForDeviceStatusUpdateToCentral() const
 {
-    return timerTimeoutForDeviceStatusUpdateToCentral_;
+    return FnGetConfig()->timerTimeoutForDeviceStatusUpdateToCentral;
 }
 
 int IniParser::FnGetTimerCentralHeartbeat() const
 {
-    return timerCentralHeartbeat_;
+    return FnGetConfig()->timerCentralHeartbeat;
+}
+
+std::string IniParser::FnGetNetworkInterface() const
+{
+    return FnGetConfig()->networkInterface;
 }
@@ -1,16 +1,154 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <cstddef>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <sys/inotify.h>
+#include <vector>
+#include "service.h"
+
+/*
+ * Hogging policy as configured in its [hoggingPolicy_<name>] section,
+ * compiled by HoggingEngine. A limit of 0 is not checked.
+ */
+struct hoggingPolicyConfig
+{
+    // Stored with every flagged session, tbl_ev_lot_hogging.policy is VARCHAR(20)
+    static constexpr std::size_t NAME_MAX_LENGTH = 20;
+
+    std::string name;
+    int maxDwellMin = 0;
+    int graceMin = 0;
+    int idleMaxMin = 0;
+    // Times of day the policy is enforced, "HH:MM-HH:MM,...", empty = all day
+    std::string windows;
+};
+
+/*
+ * Immutable snapshot of configuration.ini.
+ * A new snapshot is built on every (re)load and published atomically, readers
+ * always see one consistent set of values.
+ */
+struct IniConfig
+{
+    std::string cameraIP;
+    std::string centralIP;
+    int centralServerPort = 0;
+    std::string parkingLotLocationCode;
+    // Lots numbered 1 to parkingLotCount, read once at startup
+    int parkingLotCount = 200;
+    int timerForFilteringSnapshot = 0;
+    int timerTimeoutForDeviceStatusUpdateToCentral = 0;
+    int timerCentralHeartbeat = 0;
+    std::string networkInterface;
+
+    // Thread topology, applied once at startup
+    int ioThreadCount = 6;
+    bool ioContextPerThread = false;
+    std::vector<int> ioThreadCpuAffinity;
+    std::string cameraServerIP;
+    int cameraServerPort = 0;
+    std::vector<int> cameraServerThreads;
+    int timerThread = 0;
+    int centralThread = 0;
+
+    // Central request timeouts and retries
+    int centralConnectTimeoutMs = 5000;
+    int centralWriteTimeoutMs = 10000;
+    int centralReadTimeoutMs = 10000;
+    int centralMaxAttempts = 3;
+    int centralRetryDelayMs = 500;
+    std::string centralCompression = "none";
+    int centralCompressionLevel = 1;
+    std::string centralCompressionStrategy = "huffman";
+    int centralCompressionMinBytes = 1024;
+
+    // HTTPS and connection reuse. The TLS context is built once at startup,
+    // tlsVerify and tlsCaFile are not reloaded.
+    bool centralTls = false;
+    bool centralTlsVerify = true;
+    std::string centralTlsCaFile;
+    bool centralTlsSessionResumption = true;
+    bool centralKeepAlive = false;
+    int centralKeepAliveIdleTimeoutMs = 15000;
+
+    // Local database write journal, file and capacity read once at startup
+    std::string databaseJournalFile = "/home/root/ev_charging_hogging/db_journal.bin";
+    int databaseJournalCapacityMb = 64;
+    int databaseJournalReplayBatch = 200;
+    int databaseJournalReplayIntervalMs = 1000;
+    // Connection monitor, a keepalive probe after this much idle time and the reconnect backoff
+    int databaseKeepaliveIntervalMs = 30000;
+    int databaseReconnectBaseMs = 1000;
+    int databaseReconnectMaxMs = 30000;
+    // Retention of the transaction history, 0 days keeps everything
+    int databaseRetentionDays = 90;
+    int databaseRetentionIntervalMs = 3600000;
+    int databaseRetentionChunkRows = 500;
+    int databaseRetentionChunkDelayMs = 200;
+    int databaseRetentionMonthsAhead = 2;
+
+    // Circuit breaker of the Central requests
+    int centralCircuitFailureThreshold = 5;
+    int centralCircuitOpenBaseMs = 5000;
+    int centralCircuitOpenMaxMs = 300000;
+
+    // Resend of the database rows not yet sent to Central
+    int centralResendSweepIntervalMs = 30000;
+    int centralResendBatchSize = 20;
+    int centralResendRatePerSec = 5;
+    int centralResendMinAgeSec = 60;
+
+    // ParkInOut batching, a batch of at most 1 event means batching is off
+    int centralBatchMaxEvents = 1;
+    int centralBatchMaxDelayMs = 200;
+    std::string centralBatchTarget = "/ParkInOutBatch";
+
+    // Hogging rules. Lots in hoggingLotPolicies ("first-last:policy,...")
+    // follow that policy, the others hoggingDefaultPolicy.
+    bool hoggingEnabled = true;
+    std::string hoggingDefaultPolicy;
+    std::string hoggingLotPolicies;
+    std::vector<hoggingPolicyConfig> hoggingPolicies;
+
+    // Hourly lot statistics, flushed every statisticsFlushIntervalMs and at the end of
+    // each hour; statisticsHistoryHours past hours stay in memory
+    int statisticsFlushIntervalMs = 300000;
+    int statisticsHistoryHours = 24;
+
+    // Content-addressed store of the snapshot images, enabled and root directory
+    // read once at startup. Unreferenced images older than imageStoreEvictMinAgeSec
+    // are evicted, oldest first, while the store is over imageStoreQuotaMb
+    bool imageStoreEnabled = true;
+    std::string imageStoreRootDir = "/home/root/ev_charging_hogging/images";
+    int imageStoreQuotaMb = 2048;
+    int imageStoreEvictIntervalMs = 600000;
+    int imageStoreEvictMinAgeSec = 3600;
+};
 
 class IniParser
 {
 public:
     const std::string INI_FILE_PATH = "/home/root/ev_charging_hogging/Ini";
+    const std::string INI_FILE_NAME = "configuration.ini";
     const std::string INI_FILE_ABSOLUTE_PATH = "/home/root/ev_charging_hogging/Ini/configuration.ini";
 
     static IniParser* getInstance();
     bool FnReadIniFile();
+    // Read another configuration file, e.g. one pointing Central at a local mock
+    bool FnReadIniFile(const std::string& iniFilePath);
+    void FnIniFileWatcherInitialization(boost::asio::io_context& io_context);
+
+    /*
+     * Current configuration snapshot, lock-free.
+     * Take it once when several values must belong to the same version.
+     */
+    const IniConfig* FnGetConfig() const;
 
     std::string FnGetCameraIP() const;
     std::string FnGetCentralIP() const;
@@ -19,6 +157,7 @@ public:
     int FnGetTimerForFilteringSnapshot() const;
     int FnGetTimerTimeoutForDeviceStatusUpdateToCentral() const;
     int FnGetTimerCentralHeartbeat() const;
+    std::string FnGetNetworkInterface() const;
 
     /*
      * Singleton IniParser should not be cloneable
@@ -31,15 +170,22 @@ public:
     void operator=(const IniParser&) = delete;
 
 private:
-    static IniParser* iniParser_;
-    static std::mutex mutex_;
+    static ServiceInstance<IniParser> instance_;
     IniParser();
 
-    std::string cameraIP_;
-    std::string centralIP_;
-    int centralServerPort_;
-    std::string parkingLotLocationCode_;
-    int timerForFilteringSnapshot_;
-    int timerTimeoutForDeviceStatusUpdateToCentral_;
-    int timerCentralHeartbeat_;
-};
\ No newline at end of file
+    std::atomic<const IniConfig*> config_;
+    // Every published snapshot stays alive, so a reader never sees a freed one.
+    // Reloads are rare, the retained snapshots are a few hundred bytes each.
+    std::vector<std::unique_ptr<const IniConfig>> configHistory_;
+    std::mutex publishMutex_;
+
+    std::unique_ptr<boost::asio::posix::stream_descriptor> pInotifyDescriptor_;
+    // Read as a sequence of inotify_event, aligned like one as inotify(7) shows
+    alignas(struct inotify_event) std::array<char, 4096> inotifyBuffer_;
+
+    static std::vector<int> parseIntList(const std::string& str);
+    static std::vector<std::string> parseStringList(const std::string& str);
+    void publishConfig(std::unique_ptr<const IniConfig> config);
+    void startIniFileWatch();
+    void onIniFileEvent(const boost::system::error_code& ec, std::size_t bytes_transferred);
+};
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <unistd.h>
+#include "io_topology.h"
+#include "log.h"
+
+IoTopology::IoTopology(const IniConfig& config)
+    : threadCount_(config.ioThreadCount > 0 ? static_cast<std::size_t>(config.ioThreadCount) : 1),
+    ioContextPerThread_(config.ioContextPerThread)
+{
+    // A cpu outside the cpu_set_t or the machine leaves its thread unpinned, a later entry keeps its thread
+    long cpuCount = std::min<long>(sysconf(_SC_NPROCESSORS_CONF), CPU_SETSIZE);
+    if (cpuCount <= 0)
+    {
+        cpuCount = CPU_SETSIZE;
+    }
+    for (int cpu : config.ioThreadCpuAffinity)
+    {
+        if ((cpu < 0) || (cpu >= cpuCount))
+        {
+            std::ostringstream oss;
+            oss << "Invalid cpu " << cpu << " of thread " << cpuAffinity_.size() << " ignored, " << cpuCount << " cpus.";
+            Logger::getInstance()->FnLog(oss.str(), "TOPOLOGY");
+            cpu = -1;
+        }
+        cpuAffinity_.push_back(cpu);
+    }
+
+    for (int index : config.cameraServerThreads)
+    {
+        if (index < 0)
+        {
+            std::ostringstream oss;
+            oss << "Invalid camera server thread " << index << " ignored.";
+            Logger::getInstance()->FnLog(oss.str(), "TOPOLOGY");
+            continue;
+        }
+        cameraServerThreads_.push_back(index);
+    }
+
+    std::size_t contextCount = ioContextPerThread_ ? threadCount_ : 1;
+
+    for (std::size_t i = 0; i < contextCount; i++)
+    {
+        // A context run by a single thread can skip internal locking
+        int concurrencyHint = ioContextPerThread_ ? 1 : static_cast<int>(threadCount_);
+        ioContexts_.push_back(std::make_unique<boost::asio::io_context>(concurrencyHint));
+        workGuards_.push_back(boost::asio::make_work_guard(*ioContexts_.back()));
+    }
+}
+
+boost::asio::io_context& IoTopology::FnGetIoContext(std::size_t thread_index)
+{
+    if (!ioContextPerThread_)
+    {
+        return *ioContexts_.front();
+    }
+    return *ioContexts_[thread_index % ioContexts_.size()];
+}
+
+std::vector<boost::asio::io_context*> IoTopology::FnGetCameraServerIoContexts()
+{
+    std::vector<boost::asio::io_context*> contexts;
+
+    if (!ioContextPerThread_)
+    {
+        contexts.push_back(ioContexts_.front().get());
+    }
+    else if (cameraServerThreads_.empty())
+    {
+        for (auto& context : ioContexts_)
+        {
+            contexts.push_back(context.get());
+        }
+    }
+    else
+    {
+        for (int index : cameraServerThreads_)
+        {
+            contexts.push_back(&FnGetIoContext(static_cast<std::size_t>(index)));
+        }
+    }
+
+    return contexts;
+}
+
+std::size_t IoTopology::FnGetThreadCount() const
+{
+    return threadCount_;
+}
+
+bool IoTopology::FnIsIoContextPerThread() const
+{
+    return ioContextPerThread_;
+}
+
+int IoTopology::cpuForThread(std::size_t thread_index) const
+{
+    if (thread_index < cpuAffinity_.size())
+    {
+        return cpuAffinity_[thread_index];
+    }
+    return -1;
+}
+
+void IoTopology::FnLogTopology(const IniConfig& config) const
+{
+    std::ostringstream oss;
+    oss << "IO topology mode: " << (ioContextPerThread_ ? "io_context per thread" : "shared io_context")
+        << ", threads: " << threadCount_
+        << ", io_contexts: " << ioContexts_.size();
+    Logger::getInstance()->FnLog(oss.str(), "TOPOLOGY");
+
+    for (std::size_t i = 0; i < threadCount_; i++)
+    {
+        std::ostringstream thread;
+        thread << "Thread " << i << " -> io_context " << (ioContextPerThread_ ? i : 0) << ", cpu: ";
+        int cpu = cpuForThread(i);
+        if (cpu >= 0)
+        {
+            thread << cpu;
+        }
+        else
+        {
+            thread << "any";
+        }
+        Logger::getInstance()->FnLog(thread.str(), "TOPOLOGY");
+    }
+
+    std::ostringstream placement;
+    placement << "Camera server " << config.cameraServerIP << ":" << config.cameraServerPort << " on threads: ";
+    if (!ioContextPerThread_ || cameraServerThreads_.empty())
+    {
+        placement << "all";
+    }
+    else
+    {
+        for (std::size_t i = 0; i < cameraServerThreads_.size(); i++)
+        {
+            placement << (i > 0 ? "," : "") << cameraServerThreads_[i];
+        }
+    }
+    if (ioContextPerThread_)
+    {
+        placement << ", timers on thread: " << config.timerThread << ", central on thread: " << config.centralThread;
+    }
+    Logger::getInstance()->FnLog(placement.str(), "TOPOLOGY");
+}
+
+void IoTopology::worker(std::size_t thread_index)
+{
+    int cpu = cpuForThread(thread_index);
+    if (cpu >= 0)
+    {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu, &cpuSet);
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+        if (ret != 0)
+        {
+            std::ostringstream oss;
+            oss << "Failed to pin thread " << thread_index << " to cpu " << cpu << ", error: " << ret;
+            Logger::getInstance()->FnLog(oss.str(), "TOPOLOGY");
+        }
+    }
+
+    FnGetIoContext(thread_index).run();
+}
+
+void IoTopology::FnRun()
+{
+    for (std::size_t i = 0; i < threadCount_; i++)
+    {
+        threads_.create_thread(std::bind(&IoTopology::worker, this, i));
+    }
+
+    threads_.join_all();
+}
+
+void IoTopology::FnStop()
+{
+    for (auto& guard : workGuards_)
+    {
+        guard.reset();
+    }
+
+    for (auto& context : ioContexts_)
+    {
+        context->stop();
+    }
+}
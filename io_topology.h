@@ -0,0 +1,51 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ini_parser.h"
+
+/*
+ * Worker threads and the io_contexts they run.
+ * Shared mode: every thread runs the one io_context (previous behaviour).
+ * Per-thread mode: each thread runs its own io_context, so a subsystem can be
+ * placed on a specific core by choosing which io_context it is created on.
+ */
+class IoTopology
+{
+public:
+    explicit IoTopology(const IniConfig& config);
+
+    boost::asio::io_context& FnGetIoContext(std::size_t thread_index);
+    std::vector<boost::asio::io_context*> FnGetCameraServerIoContexts();
+    std::size_t FnGetThreadCount() const;
+    bool FnIsIoContextPerThread() const;
+
+    void FnLogTopology(const IniConfig& config) const;
+    void FnRun();
+    void FnStop();
+
+    /*
+     * IoTopology owns threads, it should not be cloneable
+     */
+    IoTopology(const IoTopology&) = delete;
+
+    /*
+     * IoTopology owns threads, it should not be assignable
+     */
+    void operator=(const IoTopology&) = delete;
+
+private:
+    std::size_t threadCount_;
+    bool ioContextPerThread_;
+    std::vector<int> cpuAffinity_;
+    std::vector<int> cameraServerThreads_;
+    std::vector<std::unique_ptr<boost::asio::io_context>> ioContexts_;
+    std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> workGuards_;
+    boost::thread_group threads_;
+
+    int cpuForThread(std::size_t thread_index) const;
+    void worker(std::size_t thread_index);
+};
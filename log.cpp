@@ -4,8 +4,7 @@
 #include "common.h"
 #include "log.h"
 
-Logger* Logger::logger_ = nullptr;
-std::mutex Logger::mutex_; 
+ServiceInstance<Logger> Logger::instance_;
 
 Logger::Logger()
     : loggerName_("ev")
@@ -21,12 +20,7 @@ Logger::~Logger()
 
 Logger* Logger::getInstance()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (logger_ == nullptr)
-    {
-        logger_ = new Logger();
-    }
-    return logger_;
+    return instance_.get([]() { return new Logger(); });
 }
 
 void Logger::FnCreateLogFile()
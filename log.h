@@ -5,6 +5,7 @@
 #include "spdlog/spdlog.h"
 #include "spdlog/async.h"
 #include "spdlog/sinks/basic_file_sink.h"
+#include "service.h"
 
 class Logger
 {
@@ -26,8 +27,7 @@ public:
     void operator=(const Logger&) = delete;
 
 private:
-    static Logger* logger_;
-    static std::mutex mutex_;
+    static ServiceInstance<Logger> instance_;
     std::string loggerName_;
     Logger();
     ~Logger();
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <sstream>
+#include "database.h"
+#include "hogging_engine.h"
+#include "image_store.h"
+#include "lot_statistics.h"
+#include "ini_parser.h"
+#include "log.h"
+#include "lot_occupancy.h"
+
+ServiceInstance<LotOccupancy> LotOccupancy::instance_;
+
+LotOccupancy::LotOccupancy()
+    : lotCount_(0),
+    occupiedCount_(0)
+{
+
+}
+
+LotOccupancy* LotOccupancy::getInstance()
+{
+    return instance_.get([]() { return new LotOccupancy(); });
+}
+
+void LotOccupancy::FnLotOccupancyInitialization()
+{
+    const IniConfig* config = IniParser::getInstance()->FnGetConfig();
+    lotCount_ = static_cast<std::size_t>(std::max(config->parkingLotCount, 0));
+    slots_ = std::make_unique<lotSlot[]>(lotCount_);
+
+    // Oldest park in first, a lot with more than one open session ends up with the latest
+    std::vector<ev_lot_trans_record_t> records = MariaDB::getInstance()->FnSelectOpenEvLotTransRecords(config->parkingLotLocationCode);
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    for (const ev_lot_trans_record_t& record : records)
+    {
+        long index = slotIndex(record.lot.lot_no.view());
+        if (index < 0)
+        {
+            Logger::getInstance()->FnLog("Open session of unknown lot " + record.lot.lot_no.str() + " ignored.", "OCCUPANCY");
+            continue;
+        }
+        store(static_cast<std::size_t>(index), lotState::Occupied, record.lot.lpn.view(), std::chrono::system_clock::to_time_t(record.lot.lot_in_dt));
+    }
+
+    std::ostringstream oss;
+    oss << "Lot occupancy of " << lotCount_ << " lots loaded, " << occupiedCount_.load() << " occupied.";
+    Logger::getInstance()->FnLog(oss.str(), "OCCUPANCY");
+}
+
+bool LotOccupancy::FnParkIn(parking_lot_t& lot)
+{
+    lot.lot_in_image_path = ImageStore::getInstance()->FnPut(lot.lot_in_image_path);
+
+    long index = slotIndex(lot.lot_no.view());
+    if (index >= 0)
+    {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        lot_time_t lotInTime = isLotTimeSet(lot.lot_in_dt) ? lot.lot_in_dt : std::chrono::system_clock::now();
+        store(static_cast<std::size_t>(index), lotState::Occupied, lot.lpn.view(), std::chrono::system_clock::to_time_t(lotInTime));
+        HoggingEngine::getInstance()->FnOnParkIn(lot.lot_no.view(), lot.lpn.view(), lotInTime);
+        LotStatistics::getInstance()->FnOnParkIn(lot.lot_no.view(), lotInTime);
+    }
+    else
+    {
+        Logger::getInstance()->FnLog("Park in of unknown lot " + lot.lot_no.str() + ", not cached.", "OCCUPANCY");
+    }
+
+    // The lot reflects what the camera saw even if the row could not be written
+    return MariaDB::getInstance()->FnInsertEvLotTransRecord(lot);
+}
+
+bool LotOccupancy::FnParkOut(parking_lot_t& lot)
+{
+    lot.lot_out_image_path = ImageStore::getInstance()->FnPut(lot.lot_out_image_path);
+
+    long index = slotIndex(lot.lot_no.view());
+    if (index >= 0)
+    {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        store(static_cast<std::size_t>(index), lotState::Vacant, "", 0);
+        HoggingEngine::getInstance()->FnOnParkOut(lot.lot_no.view());
+        LotStatistics::getInstance()->FnOnParkOut(lot.lot_no.view(), isLotTimeSet(lot.lot_out_dt) ? lot.lot_out_dt : std::chrono::system_clock::now());
+    }
+    else
+    {
+        Logger::getInstance()->FnLog("Park out of unknown lot " + lot.lot_no.str() + ", not cached.", "OCCUPANCY");
+    }
+
+    return MariaDB::getInstance()->FnCloseEvLotTransRecord(lot);
+}
+
+bool LotOccupancy::FnGetLot(std::string_view lot_no, lotOccupancy& occupancy) const
+{
+    long index = slotIndex(lot_no);
+    if (index < 0)
+    {
+        return false;
+    }
+
+    const lotSlot& slot = slots_[static_cast<std::size_t>(index)];
+    std::uint32_t before;
+    std::uint32_t after;
+    std::uint8_t state;
+    std::int64_t lotInTime;
+    char lpn[LPN_CAPACITY];
+    do
+    {
+        before = slot.sequence.load(std::memory_order_acquire);
+        state = slot.state.load(std::memory_order_relaxed);
+        lotInTime = slot.lotInTime.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < LPN_WORDS; i++)
+        {
+            std::uint64_t word = slot.lpn[i].load(std::memory_order_relaxed);
+            std::memcpy(lpn + i * sizeof(word), &word, sizeof(word));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = slot.sequence.load(std::memory_order_relaxed);
+    } while ((before != after) || (before & 1));
+
+    occupancy.state = static_cast<lotState>(state);
+    occupancy.lpn.assign(lpn, strnlen(lpn, LPN_CAPACITY));
+    occupancy.lotInTime = static_cast<std::time_t>(lotInTime);
+    return true;
+}
+
+bool LotOccupancy::FnIsOccupied(std::string_view lot_no) const
+{
+    long index = slotIndex(lot_no);
+    if (index < 0)
+    {
+        return false;
+    }
+
+    // A single field, no need for the sequence
+    return static_cast<lotState>(slots_[static_cast<std::size_t>(index)].state.load(std::memory_order_acquire)) == lotState::Occupied;
+}
+
+long LotOccupancy::FnGetLotIndex(std::string_view lot_no) const
+{
+    return slotIndex(lot_no);
+}
+
+std::size_t LotOccupancy::FnGetLotCount() const
+{
+    return lotCount_;
+}
+
+std::size_t LotOccupancy::FnGetOccupiedCount() const
+{
+    return occupiedCount_.load(std::memory_order_relaxed);
+}
+
+long LotOccupancy::slotIndex(std::string_view lot_no) const
+{
+    long lotNo = 0;
+    const char* end = lot_no.data() + lot_no.size();
+    std::from_chars_result result = std::from_chars(lot_no.data(), end, lotNo);
+    if ((result.ec != std::errc()) || (result.ptr != end) || (lotNo < 1) || (static_cast<std::size_t>(lotNo) > lotCount_))
+    {
+        return -1;
+    }
+    return lotNo - 1;
+}
+
+void LotOccupancy::store(std::size_t index, lotState state, std::string_view lpn, std::time_t lotInTime)
+{
+    lotSlot& slot = slots_[index];
+
+    bool wasOccupied = static_cast<lotState>(slot.state.load(std::memory_order_relaxed)) == lotState::Occupied;
+    bool isOccupied = (state == lotState::Occupied);
+    if (wasOccupied != isOccupied)
+    {
+        if (isOccupied)
+        {
+            occupiedCount_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            occupiedCount_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    char bytes[LPN_CAPACITY] = {0};
+    std::memcpy(bytes, lpn.data(), std::min(lpn.size(), LPN_CAPACITY));
+
+    std::uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.state.store(static_cast<std::uint8_t>(state), std::memory_order_relaxed);
+    slot.lotInTime.store(static_cast<std::int64_t>(lotInTime), std::memory_order_relaxed);
+    for (std::size_t i = 0; i < LPN_WORDS; i++)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, bytes + i * sizeof(word), sizeof(word));
+        slot.lpn[i].store(word, std::memory_order_relaxed);
+    }
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
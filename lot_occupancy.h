@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "service.h"
+#include "structure.h"
+
+enum class lotState : std::uint8_t
+{
+    Vacant,
+    Occupied
+};
+
+struct lotOccupancy
+{
+    lotState state;
+    std::string lpn;
+    // Park in time, 0 while vacant
+    std::time_t lotInTime;
+};
+
+/*
+ * Occupancy of the parking lots in memory, a flat array indexed by lot number
+ * (1 to parkingLotCount) holding the state, LPN and park in time of each lot.
+ * Filled at startup from the open sessions in tbl_ev_lot_trans with a single
+ * query, then kept by FnParkIn / FnParkOut, which write the transition through
+ * to the database as well. Those are called by EvtTimer at the end of the
+ * snapshot filter window of a lot event.
+ * Reads take no lock: every lot is a sequence-locked slot of its own cache
+ * line, a reader retries in the rare case it overlapped a transition of the
+ * same lot. Transitions take turns on a mutex.
+ * Park ins still in the write journal at startup are not in the database yet
+ * and not found by the warm-up.
+ * Transitions are passed on to the HoggingEngine and LotStatistics.
+ * The image of the transition is taken into the ImageStore first, the lot is
+ * left referring to the stored copy for what is done with it after.
+ */
+class LotOccupancy
+{
+public:
+    static LotOccupancy* getInstance();
+    // Sizes the table once, parkingLotCount is not reloaded
+    void FnLotOccupancyInitialization();
+
+    bool FnParkIn(parking_lot_t& lot);
+    bool FnParkOut(parking_lot_t& lot);
+
+    // False for a lot number outside the table
+    bool FnGetLot(std::string_view lot_no, lotOccupancy& occupancy) const;
+    bool FnIsOccupied(std::string_view lot_no) const;
+    // Index of the lot in the table (lot 1 is 0), -1 for a lot number outside it
+    long FnGetLotIndex(std::string_view lot_no) const;
+    std::size_t FnGetLotCount() const;
+    std::size_t FnGetOccupiedCount() const;
+
+    /*
+     * Singleton LotOccupancy cannot be cloneable
+     */
+    LotOccupancy(LotOccupancy& lotOccupancy) = delete;
+
+    /*
+     * Singleton LotOccupancy cannot be assignable
+     */
+    void operator=(const LotOccupancy&) = delete;
+
+private:
+    static ServiceInstance<LotOccupancy> instance_;
+    LotOccupancy();
+
+    // LPN bytes per slot, tbl_ev_lot_trans.lpn is a VARCHAR(10)
+    static constexpr std::size_t LPN_WORDS = 2;
+    static constexpr std::size_t LPN_CAPACITY = LPN_WORDS * sizeof(std::uint64_t);
+
+    struct alignas(64) lotSlot
+    {
+        // Odd while a transition is being written
+        std::atomic<std::uint32_t> sequence;
+        std::atomic<std::uint8_t> state;
+        std::atomic<std::int64_t> lotInTime;
+        std::array<std::atomic<std::uint64_t>, LPN_WORDS> lpn;
+    };
+
+    std::unique_ptr<lotSlot[]> slots_;
+    std::size_t lotCount_;
+    std::atomic<std::size_t> occupiedCount_;
+    std::mutex writeMutex_;
+
+    // Slot of the lot number, -1 if it has none
+    long slotIndex(std::string_view lot_no) const;
+    void store(std::size_t index, lotState state, std::string_view lpn, std::time_t lotInTime);
+};
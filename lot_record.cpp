@@ -0,0 +1,38 @@
+#include <mutex>
+#include <unordered_set>
+#include "lot_record.h"
+
+namespace
+{
+
+// Nodes of an unordered_set never move, the pointers handed out stay valid
+std::unordered_set<std::string>& internedCodes()
+{
+    static std::unordered_set<std::string> codes{std::string()};
+    return codes;
+}
+
+std::mutex internMutex;
+
+const std::string* emptyCode()
+{
+    static const std::string* code = []() {
+        std::lock_guard<std::mutex> lock(internMutex);
+        return &*internedCodes().find(std::string());
+    }();
+    return code;
+}
+
+}
+
+// No lock, every record starts out with one
+LocationCode::LocationCode()
+    : code_(emptyCode())
+{
+}
+
+LocationCode::LocationCode(std::string_view code)
+{
+    std::lock_guard<std::mutex> lock(internMutex);
+    code_ = &*internedCodes().emplace(code).first;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/*
+ * Building blocks of parking_lot_t, sized after the columns of
+ * tbl_ev_lot_trans so a park event needs no heap allocation of its own
+ * beyond the image paths.
+ */
+
+// Park in or park out, the transition a record stands for
+enum class lotEvent : std::uint8_t
+{
+    ParkIn,
+    ParkOut
+};
+
+// Event times, the default constructed (epoch) value means not set / NULL
+typedef std::chrono::system_clock::time_point lot_time_t;
+
+inline bool isLotTimeSet(lot_time_t time)
+{
+    return time != lot_time_t();
+}
+
+/*
+ * String of at most N bytes stored inline. Longer values are cut to N, the
+ * same as the VARCHAR(N) column they are written to.
+ */
+template <std::size_t N>
+class InlineString
+{
+    static_assert(N < 256, "InlineString keeps its size in one byte");
+
+public:
+    InlineString() : size_(0) {}
+    InlineString(std::string_view value) { assign(value); }
+    InlineString(const std::string& value) { assign(value); }
+    InlineString(const char* value) { assign(value); }
+
+    void assign(std::string_view value)
+    {
+        size_ = static_cast<std::uint8_t>(std::min(value.size(), N));
+        std::memcpy(data_, value.data(), size_);
+    }
+
+    std::string_view view() const { return std::string_view(data_, size_); }
+    std::string str() const { return std::string(data_, size_); }
+    bool empty() const { return size_ == 0; }
+    std::size_t size() const { return size_; }
+
+    bool operator==(std::string_view other) const { return view() == other; }
+
+private:
+    char data_[N];
+    std::uint8_t size_;
+};
+
+/*
+ * Location code interned in a process-wide table: one pointer per record,
+ * compared by address. A site has one or a few codes, the table never shrinks.
+ */
+class LocationCode
+{
+public:
+    LocationCode();
+    LocationCode(std::string_view code);
+    LocationCode(const std::string& code) : LocationCode(std::string_view(code)) {}
+    LocationCode(const char* code) : LocationCode(std::string_view(code)) {}
+
+    const std::string& str() const { return *code_; }
+    bool empty() const { return code_->empty(); }
+
+    bool operator==(const LocationCode& other) const { return code_ == other.code_; }
+
+private:
+    const std::string* code_;
+};
@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <ctime>
+#include <sstream>
+#include "database.h"
+#include "ini_parser.h"
+#include "log.h"
+#include "lot_occupancy.h"
+#include "lot_statistics.h"
+
+namespace
+{
+
+const std::chrono::hours ONE_HOUR(1);
+// A clock set forward this far (e.g. by the first time sync after boot) skips the hours in between
+const std::chrono::hours MAX_HOURS_CLOSED(24);
+
+}
+
+ServiceInstance<LotStatistics> LotStatistics::instance_;
+
+LotStatistics::LotStatistics()
+    : historyHours_(0)
+{
+
+}
+
+LotStatistics* LotStatistics::getInstance()
+{
+    return instance_.get([]() { return new LotStatistics(); });
+}
+
+void LotStatistics::FnLotStatisticsInitialization(boost::asio::io_context& io_context, const ServiceContext& services)
+{
+    services_ = services;
+    const IniConfig* config = services_.iniParser->FnGetConfig();
+    pStrand_ = std::make_unique<boost::asio::strand<boost::asio::io_context::executor_type>>(io_context.get_executor());
+    pTimer_ = std::make_unique<boost::asio::system_timer>(*pStrand_);
+
+    std::size_t lotCount = services_.lotOccupancy->FnGetLotCount();
+    lot_time_t now = std::chrono::system_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    historyHours_ = static_cast<std::size_t>(std::max(config->statisticsHistoryHours, 0));
+    lots_.assign(lotCount, lotTracking{false, lot_time_t(), lot_time_t()});
+    startHour(hourOf(now));
+    history_.assign(historyHours_, std::vector<lot_stats_hourly_t>());
+
+    for (std::size_t lot = 0; lot < lotCount; lot++)
+    {
+        lotOccupancy occupancy;
+        if (services_.lotOccupancy->FnGetLot(std::to_string(lot + 1), occupancy) && (occupancy.state == lotState::Occupied))
+        {
+            lotTracking& tracking = lots_[lot];
+            tracking.occupied = true;
+            tracking.lotInTime = std::chrono::system_clock::from_time_t(occupancy.lotInTime);
+            tracking.countedUntil = std::max(hourStart_, std::min(tracking.lotInTime, now));
+        }
+    }
+
+    // Counts written before a restart, the summary table is their only copy
+    std::vector<lot_stats_hourly_t> rows = services_.mariaDb->FnSelectEvLotStatsHourlyRecords(config->parkingLotLocationCode, "",
+                                                                                                    hourStart_ - std::chrono::hours(static_cast<long>(historyHours_)), hourStart_);
+    for (const lot_stats_hourly_t& row : rows)
+    {
+        long lot = lotIndex(row.lot_no.view());
+        if (lot < 0)
+        {
+            continue;
+        }
+
+        if (row.hour_start == hourStart_)
+        {
+            current_[lot] = row;
+            lotTracking& tracking = lots_[lot];
+            if (tracking.occupied)
+            {
+                tracking.countedUntil = std::max(tracking.countedUntil, std::min(row.update_dt, now));
+            }
+        }
+        else
+        {
+            std::size_t age = static_cast<std::size_t>(std::chrono::duration_cast<std::chrono::hours>(hourStart_ - row.hour_start).count());
+            if ((age >= 1) && (age <= historyHours_))
+            {
+                history_[age - 1].push_back(row);
+            }
+        }
+    }
+
+    std::ostringstream oss;
+    oss << "Lot statistics started, " << lotCount << " lots, " << rows.size() << " hourly rows read back.";
+    services_.logger->FnLog(oss.str(), "STATS");
+
+    boost::asio::post(*pStrand_, [this]() {
+        scheduleFlush();
+    });
+}
+
+void LotStatistics::FnOnParkIn(std::string_view lot_no, lot_time_t lotInTime)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    long lot = lotIndex(lot_no);
+    if (lot < 0)
+    {
+        return;
+    }
+
+    lot_time_t now = std::chrono::system_clock::now();
+    advance(now);
+
+    // A park in over an open session, its park out was missed
+    accrue(static_cast<std::size_t>(lot), now);
+
+    lotTracking& tracking = lots_[lot];
+    tracking.occupied = true;
+    tracking.lotInTime = lotInTime;
+    tracking.countedUntil = std::max(hourStart_, std::min(lotInTime, now));
+    current_[lot].park_ins++;
+}
+
+void LotStatistics::FnOnParkOut(std::string_view lot_no, lot_time_t lotOutTime)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    long lot = lotIndex(lot_no);
+    if (lot < 0)
+    {
+        return;
+    }
+
+    lot_time_t now = std::chrono::system_clock::now();
+    advance(now);
+
+    lotTracking& tracking = lots_[lot];
+    lot_stats_hourly_t& row = current_[lot];
+    row.park_outs++;
+    if (!tracking.occupied)
+    {
+        return;
+    }
+
+    accrue(static_cast<std::size_t>(lot), std::min(lotOutTime, now));
+    tracking.occupied = false;
+
+    if (isLotTimeSet(tracking.lotInTime) && (lotOutTime > tracking.lotInTime))
+    {
+        std::chrono::seconds dwell = std::chrono::duration_cast<std::chrono::seconds>(lotOutTime - tracking.lotInTime);
+        std::size_t bucket = 0;
+        while ((bucket < LOT_DWELL_BUCKET_LIMITS_MIN.size()) && (dwell >= std::chrono::minutes(LOT_DWELL_BUCKET_LIMITS_MIN[bucket])))
+        {
+            bucket++;
+        }
+        row.dwell_count++;
+        row.dwell_sum_sec += static_cast<std::uint64_t>(dwell.count());
+        row.dwell_histogram[bucket]++;
+    }
+}
+
+void LotStatistics::FnOnHogging(std::string_view lot_no)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    long lot = lotIndex(lot_no);
+    if (lot < 0)
+    {
+        return;
+    }
+
+    advance(std::chrono::system_clock::now());
+    current_[lot].hoggings++;
+}
+
+std::vector<lot_stats_hourly_t> LotStatistics::FnGetLotHourlyStats(std::string_view lot_no) const
+{
+    std::vector<lot_stats_hourly_t> rows;
+    std::lock_guard<std::mutex> lock(mutex_);
+    long lot = lotIndex(lot_no);
+    if (lot < 0)
+    {
+        return rows;
+    }
+
+    // Rows carry the lot number as written by this class, "07" is lot 7
+    std::string key = std::to_string(lot + 1);
+
+    // The hours are closed by the next event or flush, until then the current one may be over
+    lot_time_t now = std::chrono::system_clock::now();
+    for (const lot_stats_hourly_t& row : snapshot(now))
+    {
+        if (row.lot_no == key)
+        {
+            rows.push_back(row);
+        }
+    }
+    for (const std::vector<lot_stats_hourly_t>& hour : history_)
+    {
+        auto it = std::find_if(hour.begin(), hour.end(), [&key](const lot_stats_hourly_t& row) { return row.lot_no == key; });
+        if (it != hour.end())
+        {
+            rows.push_back(*it);
+        }
+    }
+    return rows;
+}
+
+std::vector<lot_stats_hourly_t> LotStatistics::FnGetCurrentHourStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return snapshot(std::chrono::system_clock::now());
+}
+
+lot_time_t LotStatistics::hourOf(lot_time_t time)
+{
+    std::time_t timer = std::chrono::system_clock::to_time_t(time);
+    struct tm local;
+    localtime_r(&timer, &local);
+    local.tm_min = 0;
+    local.tm_sec = 0;
+    return std::chrono::system_clock::from_time_t(std::mktime(&local));
+}
+
+bool LotStatistics::hasActivity(const lot_stats_hourly_t& row)
+{
+    return (row.park_ins > 0) || (row.park_outs > 0) || (row.hoggings > 0) || (row.occupied_sec > 0);
+}
+
+void LotStatistics::startHour(lot_time_t hourStart)
+{
+    hourStart_ = hourStart;
+    current_.assign(lots_.size(), lot_stats_hourly_t());
+    for (std::size_t lot = 0; lot < current_.size(); lot++)
+    {
+        current_[lot].lot_no = std::to_string(lot + 1);
+        current_[lot].hour_start = hourStart;
+    }
+}
+
+void LotStatistics::advance(lot_time_t now)
+{
+    while (now >= hourStart_ + ONE_HOUR)
+    {
+        lot_time_t hourEnd = hourStart_ + ONE_HOUR;
+        std::vector<lot_stats_hourly_t> closed;
+        for (std::size_t lot = 0; lot < current_.size(); lot++)
+        {
+            accrue(lot, hourEnd);
+            if (hasActivity(current_[lot]))
+            {
+                current_[lot].update_dt = hourEnd;
+                closed.push_back(current_[lot]);
+            }
+        }
+        unflushed_.insert(unflushed_.end(), closed.begin(), closed.end());
+        if (historyHours_ > 0)
+        {
+            history_.push_front(std::move(closed));
+            history_.resize(historyHours_);
+        }
+
+        if (now - hourEnd >= MAX_HOURS_CLOSED)
+        {
+            services_.logger->FnLog("Clock moved ahead by more than a day, lot statistics go on from the current hour.", "STATS");
+            hourEnd = hourOf(now);
+        }
+
+        startHour(hourEnd);
+        for (lotTracking& tracking : lots_)
+        {
+            if (tracking.occupied)
+            {
+                tracking.countedUntil = std::max(tracking.countedUntil, hourEnd);
+            }
+        }
+    }
+}
+
+void LotStatistics::accrue(std::size_t lot, lot_time_t until)
+{
+    lotTracking& tracking = lots_[lot];
+    if (!tracking.occupied || (until <= tracking.countedUntil))
+    {
+        return;
+    }
+
+    current_[lot].occupied_sec += static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(until - tracking.countedUntil).count());
+    tracking.countedUntil = until;
+}
+
+std::vector<lot_stats_hourly_t> LotStatistics::snapshot(lot_time_t now) const
+{
+    std::vector<lot_stats_hourly_t> rows;
+    for (std::size_t lot = 0; lot < current_.size(); lot++)
+    {
+        lot_stats_hourly_t row = current_[lot];
+        const lotTracking& tracking = lots_[lot];
+        if (tracking.occupied && (now > tracking.countedUntil))
+        {
+            lot_time_t until = std::min(now, hourStart_ + ONE_HOUR);
+            row.occupied_sec += static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(until - tracking.countedUntil).count());
+        }
+        if (hasActivity(row))
+        {
+            row.update_dt = now;
+            rows.push_back(row);
+        }
+    }
+    return rows;
+}
+
+long LotStatistics::lotIndex(std::string_view lot_no) const
+{
+    // No lots before the initialization, nor a context to look them up in
+    if (lots_.empty())
+    {
+        return -1;
+    }
+
+    long lot = services_.lotOccupancy->FnGetLotIndex(lot_no);
+    return ((lot >= 0) && (static_cast<std::size_t>(lot) < lots_.size())) ? lot : -1;
+}
+
+void LotStatistics::scheduleFlush()
+{
+    const IniConfig* config = services_.iniParser->FnGetConfig();
+    lot_time_t next = std::chrono::system_clock::now() + std::chrono::milliseconds(std::max(config->statisticsFlushIntervalMs, 1000));
+    {
+        // The end of the hour is always flushed, whatever the interval
+        std::lock_guard<std::mutex> lock(mutex_);
+        next = std::min(next, hourStart_ + ONE_HOUR);
+    }
+
+    pTimer_->expires_at(next);
+    pTimer_->async_wait(boost::asio::bind_executor(*pStrand_, [this](const boost::system::error_code& ec) {
+        if (ec)
+        {
+            return;
+        }
+        flush();
+    }));
+}
+
+void LotStatistics::flush()
+{
+    std::vector<lot_stats_hourly_t> rows;
+    std::size_t closedCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lot_time_t now = std::chrono::system_clock::now();
+        advance(now);
+        rows.swap(unflushed_);
+        closedCount = rows.size();
+        std::vector<lot_stats_hourly_t> current = snapshot(now);
+        rows.insert(rows.end(), current.begin(), current.end());
+    }
+
+    // Outside the lock, events go on while the statement runs
+    if (!rows.empty())
+    {
+        const IniConfig* config = services_.iniParser->FnGetConfig();
+        if (services_.mariaDb->FnUpsertEvLotStatsHourlyRecords(config->parkingLotLocationCode, rows))
+        {
+            std::ostringstream oss;
+            oss << "Lot statistics flushed, " << rows.size() << " hourly rows.";
+            services_.logger->FnLog(oss.str(), "STATS");
+        }
+        else if (closedCount > 0)
+        {
+            // The closed hours are only in those rows, they go with the next flush; the current hour is snapshot again anyway
+            std::lock_guard<std::mutex> lock(mutex_);
+            unflushed_.insert(unflushed_.begin(), rows.begin(), rows.begin() + static_cast<std::ptrdiff_t>(closedCount));
+        }
+    }
+
+    scheduleFlush();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/system_timer.hpp>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "service.h"
+#include "structure.h"
+
+/*
+ * Per-lot, per-hour rollups of park ins, park outs, hoggings, occupied time
+ * and dwell (sum, count and histogram), counted in memory as LotOccupancy and
+ * HoggingEngine report their events.
+ * The current hour is written to tbl_ev_lot_stats_hourly every
+ * flushIntervalMs and once more when it ends, as totals in one statement, so
+ * a row written again (a later flush, a journal replay) is simply replaced.
+ * Only lots with activity get a row. The last historyHours hours stay in
+ * memory for local queries, older ones are read from the summary table;
+ * nothing here reads tbl_ev_lot_trans.
+ * At startup the current and past hours are read back from the summary
+ * table; occupied time of the current hour continues from its last flush.
+ * Events and queries take turns on a mutex, the counters are a handful of
+ * additions per event.
+ */
+class LotStatistics
+{
+public:
+    static LotStatistics* getInstance();
+    // After LotOccupancy, whose occupied lots count as occupied from the start
+    void FnLotStatisticsInitialization(boost::asio::io_context& io_context, const ServiceContext& services);
+
+    void FnOnParkIn(std::string_view lot_no, lot_time_t lotInTime);
+    void FnOnParkOut(std::string_view lot_no, lot_time_t lotOutTime);
+    void FnOnHogging(std::string_view lot_no);
+
+    // Hours of the lot in memory with activity, the current one (so far) first
+    std::vector<lot_stats_hourly_t> FnGetLotHourlyStats(std::string_view lot_no) const;
+    // Every lot with activity in the current hour, so far
+    std::vector<lot_stats_hourly_t> FnGetCurrentHourStats() const;
+
+    /*
+     * Singleton LotStatistics cannot be cloneable
+     */
+    LotStatistics(LotStatistics& lotStatistics) = delete;
+
+    /*
+     * Singleton LotStatistics cannot be assignable
+     */
+    void operator=(const LotStatistics&) = delete;
+
+private:
+    static ServiceInstance<LotStatistics> instance_;
+    ServiceContext services_;
+    LotStatistics();
+
+    struct lotTracking
+    {
+        bool occupied;
+        lot_time_t lotInTime;
+        // Occupied time before this is in the counts already
+        lot_time_t countedUntil;
+    };
+
+    std::unique_ptr<boost::asio::strand<boost::asio::io_context::executor_type>> pStrand_;
+    std::unique_ptr<boost::asio::system_timer> pTimer_;
+
+    mutable std::mutex mutex_;
+    std::size_t historyHours_;
+    lot_time_t hourStart_;
+    // Current hour, one row per lot
+    std::vector<lot_stats_hourly_t> current_;
+    std::vector<lotTracking> lots_;
+    // Closed hours, newest first, only the rows with activity
+    std::deque<std::vector<lot_stats_hourly_t>> history_;
+    // Closed hours not written to the summary table yet
+    std::vector<lot_stats_hourly_t> unflushed_;
+
+    static lot_time_t hourOf(lot_time_t time);
+    static bool hasActivity(const lot_stats_hourly_t& row);
+    // Fresh rows of every lot for the hour starting at hourStart
+    void startHour(lot_time_t hourStart);
+    // Close the hours ended by now, with mutex_ held
+    void advance(lot_time_t now);
+    void accrue(std::size_t lot, lot_time_t until);
+    // Current rows with activity, occupied time taken up to now
+    std::vector<lot_stats_hourly_t> snapshot(lot_time_t now) const;
+    // Index of a lot known here, -1 otherwise; with mutex_ held
+    long lotIndex(std::string_view lot_no) const;
+
+    void scheduleFlush();
+    void flush();
+};
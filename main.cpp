@@ -1,91 +1,72 @@
 #include <boost/asio.hpp>
-#include <boost/thread.hpp>
 #include <iostream>
 #include "camera.h"
 #include "central.h"
 #include "common.h"
 #include "database.h"
+#include "hogging_engine.h"
+#include "image_store.h"
 #include "ini_parser.h"
+#include "io_topology.h"
 #include "log.h"
+#include "lot_occupancy.h"
+#include "lot_statistics.h"
+#include "resend_sweeper.h"
+#include "retention_purger.h"
 #include "structure.h"
 #include "timer.h"
 
-void worker(boost::asio::io_context& io_context)
-{
-    io_context.run();
-}
-
 int main(int argc, char* argv[])
 {
-    boost::asio::io_context io_context;
-    boost::asio::strand<boost::asio::io_context::executor_type> strand(io_context.get_executor());
-
-    // Create an io_context::work object to keep the io_context running
-    boost::asio::io_context::work work(io_context);
-
     if (IniParser::getInstance()->FnReadIniFile() == false)
     {
         std::exit(EXIT_FAILURE);
     }
     Logger::getInstance();
-    Common::getInstance()->FnLogExecutableInfo(argv[0]);
-    MariaDB::getInstance()->FnConnectMariaLocalDatabase();
-    MariaDB::getInstance()->FnInsertEvLotStatusRecord(IniParser::getInstance()->FnGetParkingLotLocationCode(), Common::getInstance()->FnGetLocalIPAddress(), "1");
-    int count = MariaDB::getInstance()->FnIsEvLotStatusTableEmpty();
-    std::cout << "Count: " << count << std::endl;
-    int id = MariaDB::getInstance()->FnGetLastInsertedIDFromEvLotStatusRecord();
-    std::cout << "Id: " << id << std::endl;
-    MariaDB::getInstance()->FnRemoveAllRecordFromEvLotStatusTable();
-    count = MariaDB::getInstance()->FnIsEvLotStatusTableEmpty();
-    std::cout << "Count: " << count << std::endl;
 
-    parking_lot_t lot1 = {"", "", "", "", "", "", "", "", "", "", ""};
-    MariaDB::getInstance()->FnInsertEvLotTransRecord(lot1);
-    id = MariaDB::getInstance()->FnGetLastInsertedIDFromEvLotTransRecord();
-    std::cout << "Id: " << id << std::endl;
+    // Topology is fixed for the lifetime of the process, hot reload does not change it
+    const IniConfig* config = IniParser::getInstance()->FnGetConfig();
+    IoTopology topology(*config);
+    topology.FnLogTopology(*config);
+
+    boost::asio::io_context& timerIoContext = topology.FnGetIoContext(config->timerThread);
+    boost::asio::io_context& centralIoContext = topology.FnGetIoContext(config->centralThread);
 
-    parking_lot_t lot = {"1", "2", "4", "5", "6", "7", "8", "9", "10", "11", "12"};
-    MariaDB::getInstance()->FnInsertEvLotTransRecord(lot);
-    id = MariaDB::getInstance()->FnGetLastInsertedIDFromEvLotTransRecord();
-    std::cout << "Id: " << id << std::endl;
-    count = MariaDB::getInstance()->FnIsEvLotTransTableEmpty();
-    std::cout << "Count: " << count << std::endl;
-    MariaDB::getInstance()->FnRemoveAllRecordFromEvLotTransTable();
-    count = MariaDB::getInstance()->FnIsEvLotTransTableEmpty();
-    std::cout << "Count: " << count << std::endl;
+    IniParser::getInstance()->FnIniFileWatcherInitialization(timerIoContext);
+    Common::getInstance()->FnLogExecutableInfo(argv[0]);
+    Common::getInstance()->FnLocalIPAddressInitialization(timerIoContext);
+    MariaDB::getInstance()->FnConnectMariaLocalDatabase();
+    MariaDB::getInstance()->FnDatabaseMonitorInitialization(timerIoContext);
+    LotOccupancy::getInstance()->FnLotOccupancyInitialization();
 
-    Central::getInstance()->FnCentralInitialization(io_context, strand);
-    Central::getInstance()->FnSendDeviceStatusUpdate(Common::getInstance()->FnGetLocalIPAddress(), Central::ERROR_CODE_IPC);
+    Central::getInstance()->FnCentralInitialization(centralIoContext);
+    // Recorded first, the resend sweeper sends it if this send does not get through
+    std::string statusKey;
+    MariaDB::getInstance()->FnInsertEvLotStatusRecord(IniParser::getInstance()->FnGetParkingLotLocationCode(), Common::getInstance()->FnGetLocalIPAddress(), Central::ERROR_CODE_IPC, &statusKey);
+    Central::getInstance()->FnSendDeviceStatusUpdate(Common::getInstance()->FnGetLocalIPAddress(), Central::ERROR_CODE_IPC,
+        [statusKey](boost::beast::error_code ec, const std::string& msg) {
+            if (!ec && msg.empty() && !statusKey.empty())
+            {
+                MariaDB::getInstance()->FnMarkEvLotStatusCentralSent(statusKey);
+            }
+        });
     Central::getInstance()->FnSendHeartbeatUpdate();
-    Central::getInstance()->FnSendParkInParkOutInfo("165",
-                                                    "SNN 4019 G", 
-                                                    Common::getInstance()->FnConvertImageToBase64String("/home/root/ev_charging_hogging/Img_240411_213251.jpg"),
-                                                    "",
-                                                    Common::getInstance()->FnGetDateTimeFormat_YYYY_MM_DD_HH_MM_SS(),
-                                                    "");
 
-    EvtTimer::getInstance()->FnTimerInitialization(io_context, strand);
+    EvtTimer::getInstance()->FnTimerInitialization(timerIoContext);
+    ServiceContext services = ServiceContext::FnFromInstances();
     EvtTimer::getInstance()->FnStartDeviceStatusUpdateTimer();
     EvtTimer::getInstance()->FnStartHeartbeatCentralTimer();
-    parking_lot_t lotFirst = {"1", "WWW1111", "4", "5", "6", "7", "8", "9", "10", "11", "12"};
-    EvtTimer::getInstance()->FnStartFirstParkingLotFilterTimer(lotFirst);
-    
-    parking_lot_t lotSecond = {"1", "WWW2222", "4", "5", "6", "7", "8", "9", "10", "11", "12"};
-    EvtTimer::getInstance()->FnStartSecondParkingLotFilterTimer(lotSecond);
-
-    parking_lot_t lotThird = {"1", "WWW3333", "4", "5", "6", "7", "8", "9", "10", "11", "12"};
-    EvtTimer::getInstance()->FnStartThirdParkingLotFilterTimer(lotThird);
-
-    CameraServer::getInstance()->FnCameraServerInitialization(io_context, "192.168.2.150", 9999);
-
-    boost::thread_group threads;
-    for (std::size_t i = 0; i < 6; i++)
-    {
-        threads.create_thread(std::bind(&worker, std::ref(io_context)));
-    }
+    ResendSweeper::getInstance()->FnResendSweeperInitialization(timerIoContext, services);
+    ResendSweeper::getInstance()->FnStartResendSweeper();
+    RetentionPurger::getInstance()->FnRetentionPurgerInitialization(timerIoContext, services);
+    RetentionPurger::getInstance()->FnStartRetentionPurger();
+    ImageStore::getInstance()->FnImageStoreInitialization(timerIoContext, services);
+    LotStatistics::getInstance()->FnLotStatisticsInitialization(timerIoContext, services);
+    HoggingEngine::getInstance()->FnHoggingEngineInitialization(timerIoContext, services);
 
+    CameraServer::getInstance()->FnCameraServerInitialization(topology.FnGetCameraServerIoContexts(), config->cameraServerIP, static_cast<unsigned short>(config->cameraServerPort));
 
-    threads.join_all();
+    topology.FnRun();
 
     return 0;
 }
\ No newline at end of file
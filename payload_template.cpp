@@ -0,0 +1,221 @@
+#include <stdexcept>
+#include "payload_template.h"
+
+namespace
+{
+
+// Characters boost::json::serialize writes as an escape sequence
+inline bool needsEscape(unsigned char c)
+{
+    return (c < 0x20) || (c == '"') || (c == '\\');
+}
+
+}
+
+PayloadTemplate::PayloadTemplate(const std::vector<payloadField>& fields)
+{
+    std::string body = "{";
+    std::string log = "{";
+    bool first = true;
+
+    for (const payloadField& field : fields)
+    {
+        std::string key;
+        if (!first)
+        {
+            key += ',';
+        }
+        first = false;
+        key += '"';
+        FnAppendEscaped(key, field.name);
+        key += "\":";
+        if (!field.isRaw)
+        {
+            key += '"';
+        }
+
+        body += key;
+        log += key;
+
+        if (field.isVariable)
+        {
+            bodySegments_.push_back(std::move(body));
+            logSegments_.push_back(std::move(log));
+            variables_.push_back(variableSlot{!field.logPlaceholder.empty(), field.isRaw, field.logPlaceholder});
+            body = field.isRaw ? "" : "\"";
+            log = field.isRaw ? "" : "\"";
+        }
+        else
+        {
+            FnAppendEscaped(body, field.value);
+            if (!field.logPlaceholder.empty() && !field.value.empty())
+            {
+                FnAppendEscaped(log, field.logPlaceholder);
+            }
+            else
+            {
+                FnAppendEscaped(log, field.value);
+            }
+            body += '"';
+            log += '"';
+        }
+    }
+
+    body += '}';
+    log += '}';
+    bodySegments_.push_back(std::move(body));
+    logSegments_.push_back(std::move(log));
+
+    // Placeholders are escaped once here, values per message.
+    // The placeholder of a raw field is logged as a JSON string.
+    for (variableSlot& slot : variables_)
+    {
+        std::string escaped = slot.isRaw ? "\"" : "";
+        FnAppendEscaped(escaped, slot.logPlaceholder);
+        if (slot.isRaw)
+        {
+            escaped += '"';
+        }
+        slot.logPlaceholder = std::move(escaped);
+    }
+
+    for (const std::string& segment : bodySegments_)
+    {
+        segmentsSize_ += segment.size();
+    }
+}
+
+std::size_t PayloadTemplate::FnGetVariableFieldCount() const
+{
+    return variables_.size();
+}
+
+void PayloadTemplate::FnRender(std::initializer_list<std::string_view> values, std::string& body, std::string& log) const
+{
+    if (values.size() != variables_.size())
+    {
+        throw std::invalid_argument("Payload template expects " + std::to_string(variables_.size()) + " values, got " + std::to_string(values.size()));
+    }
+
+    std::size_t bodySize = segmentsSize_;
+    std::size_t i = 0;
+    for (std::string_view value : values)
+    {
+        bodySize += variables_[i].isRaw ? value.size() : FnGetEscapedSize(value);
+        i++;
+    }
+    body.reserve(body.size() + bodySize);
+
+    i = 0;
+    for (std::string_view value : values)
+    {
+        const variableSlot& slot = variables_[i];
+        body += bodySegments_[i];
+        log += logSegments_[i];
+
+        if (slot.isRaw)
+        {
+            body += value;
+        }
+        else
+        {
+            FnAppendEscaped(body, value);
+        }
+
+        if (slot.hasPlaceholder && !value.empty())
+        {
+            log += slot.logPlaceholder;
+        }
+        else if (slot.isRaw)
+        {
+            log += value;
+        }
+        else
+        {
+            FnAppendEscaped(log, value);
+        }
+        i++;
+    }
+
+    body += bodySegments_[i];
+    log += logSegments_[i];
+}
+
+std::size_t PayloadTemplate::FnGetEscapedSize(std::string_view value)
+{
+    std::size_t size = value.size();
+    for (unsigned char c : value)
+    {
+        if (needsEscape(c))
+        {
+            switch (c)
+            {
+                case '"':
+                case '\\':
+                case '\b':
+                case '\f':
+                case '\n':
+                case '\r':
+                case '\t':
+                    size += 1;
+                    break;
+                default:
+                    // \u00XX
+                    size += 5;
+                    break;
+            }
+        }
+    }
+    return size;
+}
+
+void PayloadTemplate::FnAppendEscaped(std::string& out, std::string_view value)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    // Copy runs of plain characters at once, base64 images are a single run
+    std::size_t runStart = 0;
+    for (std::size_t i = 0; i < value.size(); i++)
+    {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (!needsEscape(c))
+        {
+            continue;
+        }
+
+        out.append(value.data() + runStart, i - runStart);
+        runStart = i + 1;
+
+        switch (c)
+        {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\b':
+                out += "\\b";
+                break;
+            case '\f':
+                out += "\\f";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+            {
+                char escaped[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0F]};
+                out.append(escaped, sizeof(escaped));
+                break;
+            }
+        }
+    }
+    out.append(value.data() + runStart, value.size() - runStart);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * One field of a JSON payload template. Static fields have their value
+ * rendered into the template, variable fields are filled per message.
+ * A non-empty logPlaceholder replaces a non-empty value in the log view.
+ * Raw fields are variable fields taking already serialized JSON, written
+ * as is rather than as an escaped string.
+ */
+struct payloadField
+{
+    std::string name;
+    bool isVariable = false;
+    std::string value;
+    std::string logPlaceholder;
+    bool isRaw = false;
+};
+
+inline payloadField staticPayloadField(const std::string& name, const std::string& value, const std::string& logPlaceholder = "")
+{
+    return payloadField{name, false, value, logPlaceholder};
+}
+
+inline payloadField variablePayloadField(const std::string& name, const std::string& logPlaceholder = "")
+{
+    return payloadField{name, true, "", logPlaceholder};
+}
+
+inline payloadField rawPayloadField(const std::string& name, const std::string& logPlaceholder = "")
+{
+    return payloadField{name, true, "", logPlaceholder, true};
+}
+
+/*
+ * Pre-serialized flat JSON object of string fields.
+ * The fields are compiled once into literal segments, static fields and
+ * keys already escaped, so a message is the segments interleaved with the
+ * escaped variable values. Output matches boost::json::serialize of an
+ * object built in the same field order.
+ * The log view is written in the same pass, with placeholders for the
+ * fields that must not reach the log (credentials, base64 images).
+ */
+class PayloadTemplate
+{
+public:
+    PayloadTemplate() = default;
+    explicit PayloadTemplate(const std::vector<payloadField>& fields);
+
+    std::size_t FnGetVariableFieldCount() const;
+
+    /*
+     * Append the payload for the given variable values, in template order,
+     * to body and the log view to log. Body is reserved to its exact size first.
+     */
+    void FnRender(std::initializer_list<std::string_view> values, std::string& body, std::string& log) const;
+
+    static std::size_t FnGetEscapedSize(std::string_view value);
+    static void FnAppendEscaped(std::string& out, std::string_view value);
+
+private:
+    struct variableSlot
+    {
+        bool hasPlaceholder;
+        bool isRaw;
+        std::string logPlaceholder;
+    };
+
+    // segments_[i] precedes variable i, the last segment closes the object
+    std::vector<std::string> bodySegments_;
+    std::vector<std::string> logSegments_;
+    std::vector<variableSlot> variables_;
+    std::size_t segmentsSize_ = 0;
+};
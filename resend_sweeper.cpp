@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <sstream>
+#include "central.h"
+#include "database.h"
+#include "log.h"
+#include "resend_sweeper.h"
+
+ServiceInstance<ResendSweeper> ResendSweeper::instance_;
+
+ResendSweeper::ResendSweeper()
+    : inFlight_(0),
+    sent_(0),
+    failed_(0),
+    batchFull_(false),
+    batchAborted_(false)
+{
+
+}
+
+ResendSweeper* ResendSweeper::getInstance()
+{
+    return instance_.get([]() { return new ResendSweeper(); });
+}
+
+void ResendSweeper::FnResendSweeperInitialization(boost::asio::io_context& io_context, const ServiceContext& services)
+{
+    services_ = services;
+    pStrand_ = std::make_unique<boost::asio::strand<boost::asio::io_context::executor_type>>(io_context.get_executor());
+    pTimer_ = std::make_unique<boost::asio::steady_timer>(*pStrand_);
+}
+
+void ResendSweeper::FnStartResendSweeper()
+{
+    boost::asio::post(*pStrand_, [this]() {
+        const IniConfig* config = services_.iniParser->FnGetConfig();
+        scheduleSweep(std::chrono::milliseconds(config->centralResendSweepIntervalMs));
+    });
+}
+
+void ResendSweeper::scheduleSweep(std::chrono::milliseconds delay)
+{
+    pTimer_->expires_after(delay);
+    pTimer_->async_wait(boost::asio::bind_executor(*pStrand_, [this](const boost::system::error_code& ec) {
+        if (ec)
+        {
+            return;
+        }
+        sweep();
+    }));
+}
+
+void ResendSweeper::sweep()
+{
+    const IniConfig* config = services_.iniParser->FnGetConfig();
+    std::chrono::milliseconds interval(config->centralResendSweepIntervalMs);
+
+    if (!services_.mariaDb->FnIsConnected())
+    {
+        services_.logger->FnLog("Database is not connected, resend sweep skipped.", "CENTRAL");
+        scheduleSweep(interval);
+        return;
+    }
+
+    // Would only fail fast on the open circuit
+    if (!services_.central->FnGetCentralStatus())
+    {
+        services_.logger->FnLog("Central is down, resend sweep skipped.", "CENTRAL");
+        scheduleSweep(interval);
+        return;
+    }
+
+    // Kept in memory, nothing to look for saves both queries
+    if ((services_.mariaDb->FnGetUnsentEvLotTransCount() == 0) && (services_.mariaDb->FnGetUnsentEvLotStatusCount() == 0) &&
+        (services_.mariaDb->FnGetUnsentEvLotHoggingCount() == 0))
+    {
+        scheduleSweep(interval);
+        return;
+    }
+
+    std::size_t limit = static_cast<std::size_t>(std::max(config->centralResendBatchSize, 1));
+    std::vector<ev_lot_trans_record_t> lotTrans = services_.mariaDb->FnSelectUnsentEvLotTransRecords(static_cast<int>(limit), config->centralResendMinAgeSec);
+    std::vector<ev_lot_status_record_t> lotStatus;
+    if (lotTrans.size() < limit)
+    {
+        lotStatus = services_.mariaDb->FnSelectUnsentEvLotStatusRecords(static_cast<int>(limit - lotTrans.size()), config->centralResendMinAgeSec);
+    }
+    std::vector<ev_lot_hogging_record_t> lotHogging;
+    if (lotTrans.size() + lotStatus.size() < limit)
+    {
+        lotHogging = services_.mariaDb->FnSelectUnsentEvLotHoggingRecords(static_cast<int>(limit - lotTrans.size() - lotStatus.size()),
+                                                                          config->centralResendMinAgeSec);
+    }
+
+    for (ev_lot_trans_record_t& record : lotTrans)
+    {
+        bool stampLotIn = isLotTimeSet(record.lot.lot_in_dt) && !isLotTimeSet(record.lot.lot_in_central_sent_dt);
+        bool stampLotOut = isLotTimeSet(record.lot.lot_out_dt) && !isLotTimeSet(record.lot.lot_out_central_sent_dt);
+        pending_.push_back(resendItem{resendKind::LotTrans, std::move(record), ev_lot_status_record_t{}, ev_lot_hogging_record_t{}, stampLotIn, stampLotOut});
+    }
+    for (ev_lot_status_record_t& record : lotStatus)
+    {
+        pending_.push_back(resendItem{resendKind::LotStatus, ev_lot_trans_record_t{}, std::move(record), ev_lot_hogging_record_t{}, false, false});
+    }
+    for (ev_lot_hogging_record_t& record : lotHogging)
+    {
+        pending_.push_back(resendItem{resendKind::LotHogging, ev_lot_trans_record_t{}, ev_lot_status_record_t{}, std::move(record), false, false});
+    }
+
+    if (pending_.empty())
+    {
+        scheduleSweep(interval);
+        return;
+    }
+
+    batchFull_ = (pending_.size() >= limit);
+    batchAborted_ = false;
+    sent_ = 0;
+    failed_ = 0;
+
+    std::ostringstream oss;
+    oss << "Resending " << lotTrans.size() << " park in/out, " << lotStatus.size() << " device status and "
+        << lotHogging.size() << " hogging records to Central";
+    services_.logger->FnLog(oss.str(), "CENTRAL");
+
+    sendNext();
+}
+
+void ResendSweeper::sendNext()
+{
+    if (pending_.empty())
+    {
+        return;
+    }
+
+    std::shared_ptr<const resendItem> item = std::make_shared<const resendItem>(std::move(pending_.front()));
+    pending_.pop_front();
+    inFlight_++;
+    send(std::move(item));
+
+    if (!pending_.empty())
+    {
+        // Paced rather than sent together, a backlog must not flood Central after an outage
+        const IniConfig* config = services_.iniParser->FnGetConfig();
+        pTimer_->expires_after(std::chrono::milliseconds(1000 / std::max(config->centralResendRatePerSec, 1)));
+        pTimer_->async_wait(boost::asio::bind_executor(*pStrand_, [this](const boost::system::error_code& ec) {
+            if (ec)
+            {
+                return;
+            }
+            sendNext();
+        }));
+    }
+}
+
+void ResendSweeper::send(std::shared_ptr<const resendItem> item)
+{
+    // Shared, the records are move-only and the send callback has to be copyable
+    auto callback = [this, item](boost::beast::error_code ec, const std::string& msg) {
+        bool success = !ec && msg.empty();
+        boost::asio::post(*pStrand_, [this, item, success]() {
+            onSendResult(*item, success);
+        });
+    };
+
+    switch (item->kind)
+    {
+        case resendKind::LotTrans:
+            services_.central->FnSendParkInParkOutInfo(item->lotTrans.lot, callback);
+            break;
+        case resendKind::LotStatus:
+            services_.central->FnSendDeviceStatusUpdate(item->lotStatus.device_ip, item->lotStatus.error_code, callback);
+            break;
+        case resendKind::LotHogging:
+            services_.central->FnSendHoggingEvent(item->lotHogging.hogging, callback);
+            break;
+    }
+}
+
+void ResendSweeper::onSendResult(const resendItem& item, bool success)
+{
+    inFlight_--;
+
+    if (success)
+    {
+        sent_++;
+        switch (item.kind)
+        {
+            case resendKind::LotTrans:
+                services_.mariaDb->FnMarkEvLotTransCentralSent(item.lotTrans.id, item.stampLotIn, item.stampLotOut);
+                break;
+            case resendKind::LotStatus:
+                services_.mariaDb->FnMarkEvLotStatusCentralSent(item.lotStatus.id);
+                break;
+            case resendKind::LotHogging:
+                services_.mariaDb->FnMarkEvLotHoggingCentralSent(item.lotHogging.id);
+                break;
+        }
+    }
+    else
+    {
+        failed_++;
+        if (!batchAborted_)
+        {
+            // The rest would most likely fail the same way, they stay unsent for the next sweep
+            batchAborted_ = true;
+            pending_.clear();
+            pTimer_->cancel();
+        }
+    }
+
+    if (pending_.empty() && (inFlight_ == 0))
+    {
+        finishBatch();
+    }
+}
+
+void ResendSweeper::finishBatch()
+{
+    std::ostringstream oss;
+    oss << "Resent " << sent_ << " records to Central, " << failed_ << " failed";
+    services_.logger->FnLog(oss.str(), "CENTRAL");
+
+    // A full batch means more rows are waiting, the pacing alone limits the rate
+    const IniConfig* config = services_.iniParser->FnGetConfig();
+    scheduleSweep((batchFull_ && !batchAborted_) ? std::chrono::milliseconds(0) : std::chrono::milliseconds(config->centralResendSweepIntervalMs));
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include "ini_parser.h"
+#include "service.h"
+#include "structure.h"
+
+/*
+ * Resends to Central what the database records as not sent.
+ * Every resendSweepIntervalMs the sweeper reads at most resendBatchSize unsent
+ * tbl_ev_lot_trans, tbl_ev_lot_status and tbl_ev_lot_hogging rows, in that
+ * order of priority, sends them through Central at
+ * resendRatePerSec and stamps the *_central_sent_dt columns of every row
+ * Central accepted. A full batch is followed by the next one right away, so a
+ * backlog after an outage drains at the configured rate and no faster.
+ * The sweep is skipped while Central or the database is down, or when the
+ * unsent counts kept by MariaDB are zero. The rest of a batch is dropped at
+ * the first failed send; those rows stay unsent for the next sweep.
+ * Database access happens on the sweeper strand only.
+ */
+class ResendSweeper
+{
+public:
+    static ResendSweeper* getInstance();
+    void FnResendSweeperInitialization(boost::asio::io_context& io_context, const ServiceContext& services);
+    void FnStartResendSweeper();
+
+    /*
+     * Singleton ResendSweeper cannot be cloneable
+     */
+    ResendSweeper(ResendSweeper& resendSweeper) = delete;
+
+    /*
+     * Singleton ResendSweeper cannot be assignable
+     */
+    void operator=(const ResendSweeper&) = delete;
+
+private:
+    static ServiceInstance<ResendSweeper> instance_;
+    // Services it was initialized with, taken instead of their getInstance()
+    ServiceContext services_;
+    ResendSweeper();
+
+    enum class resendKind
+    {
+        LotTrans,
+        LotStatus,
+        LotHogging
+    };
+
+    struct resendItem
+    {
+        resendKind kind;
+        ev_lot_trans_record_t lotTrans;
+        ev_lot_status_record_t lotStatus;
+        ev_lot_hogging_record_t lotHogging;
+        // Sent columns this send covers
+        bool stampLotIn;
+        bool stampLotOut;
+    };
+
+    std::unique_ptr<boost::asio::strand<boost::asio::io_context::executor_type>> pStrand_;
+    std::unique_ptr<boost::asio::steady_timer> pTimer_;
+
+    // Sweep state, only touched on the strand
+    std::deque<resendItem> pending_;
+    std::size_t inFlight_;
+    std::size_t sent_;
+    std::size_t failed_;
+    bool batchFull_;
+    bool batchAborted_;
+
+    void scheduleSweep(std::chrono::milliseconds delay);
+    void sweep();
+    void sendNext();
+    void send(std::shared_ptr<const resendItem> item);
+    void onSendResult(const resendItem& item, bool success);
+    void finishBatch();
+};
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <sstream>
+#include "database.h"
+#include "log.h"
+#include "retention_purger.h"
+
+namespace
+{
+
+// Each table with the time its rows expire by, indexed together with id
+struct retentionTable
+{
+    const char* table;
+    const char* timeColumn;
+};
+
+const retentionTable RETENTION_TABLES[] = {
+    {"tbl_ev_lot_trans", "add_dt"},
+    {"tbl_ev_lot_status", "add_dt"},
+    {"tbl_ev_lot_hogging", "add_dt"},
+    {"tbl_ev_lot_stats_hourly", "hour_start"}
+};
+
+}
+
+ServiceInstance<RetentionPurger> RetentionPurger::instance_;
+
+RetentionPurger::RetentionPurger()
+    : tableIndex_(0),
+    purged_(0)
+{
+
+}
+
+RetentionPurger* RetentionPurger::getInstance()
+{
+    return instance_.get([]() { return new RetentionPurger(); });
+}
+
+void RetentionPurger::FnRetentionPurgerInitialization(boost::asio::io_context& io_context, const ServiceContext& services)
+{
+    services_ = services;
+    pStrand_ = std::make_unique<boost::asio::strand<boost::asio::io_context::executor_type>>(io_context.get_executor());
+    pTimer_ = std::make_unique<boost::asio::steady_timer>(*pStrand_);
+}
+
+void RetentionPurger::FnStartRetentionPurger()
+{
+    // First run right away, a backlog from before retention was on is worked off from the start
+    boost::asio::post(*pStrand_, [this]() {
+        scheduleRun(std::chrono::milliseconds(0));
+    });
+}
+
+void RetentionPurger::scheduleRun(std::chrono::milliseconds delay)
+{
+    pTimer_->expires_after(delay);
+    pTimer_->async_wait(boost::asio::bind_executor(*pStrand_, [this](const boost::system::error_code& ec) {
+        if (ec)
+        {
+            return;
+        }
+        run();
+    }));
+}
+
+void RetentionPurger::run()
+{
+    const IniConfig* config = services_.iniParser->FnGetConfig();
+
+    if (!services_.mariaDb->FnIsConnected())
+    {
+        services_.logger->FnLog("Database is not connected, retention purge skipped.", "DB");
+        scheduleRun(std::chrono::milliseconds(config->databaseRetentionIntervalMs));
+        return;
+    }
+
+    // The periodic recount of the unsent rows rides along, whether retention is on or not
+    services_.mariaDb->FnRefreshUnsentCounts();
+
+    if (config->databaseRetentionDays <= 0)
+    {
+        scheduleRun(std::chrono::milliseconds(config->databaseRetentionIntervalMs));
+        return;
+    }
+
+    tableIndex_ = 0;
+    startTable();
+}
+
+void RetentionPurger::startTable()
+{
+    const IniConfig* config = services_.iniParser->FnGetConfig();
+
+    if (tableIndex_ >= std::size(RETENTION_TABLES))
+    {
+        scheduleRun(std::chrono::milliseconds(config->databaseRetentionIntervalMs));
+        return;
+    }
+
+    const std::string table = RETENTION_TABLES[tableIndex_].table;
+    purged_ = 0;
+
+    // Whole months go with their partition, the chunks only see what is left around the cutoff
+    if (services_.mariaDb->FnIsTablePartitioned(table))
+    {
+        services_.mariaDb->FnMaintainMonthlyPartitions(table, config->databaseRetentionDays, std::max(config->databaseRetentionMonthsAhead, 1));
+    }
+
+    purgeChunk();
+}
+
+void RetentionPurger::scheduleChunk(std::chrono::milliseconds delay)
+{
+    pTimer_->expires_after(delay);
+    pTimer_->async_wait(boost::asio::bind_executor(*pStrand_, [this](const boost::system::error_code& ec) {
+        if (ec)
+        {
+            return;
+        }
+        purgeChunk();
+    }));
+}
+
+void RetentionPurger::purgeChunk()
+{
+    const IniConfig* config = services_.iniParser->FnGetConfig();
+    const std::string table = RETENTION_TABLES[tableIndex_].table;
+    int chunkRows = std::max(config->databaseRetentionChunkRows, 1);
+
+    long deleted = services_.mariaDb->FnPurgeExpiredRecords(table, RETENTION_TABLES[tableIndex_].timeColumn, config->databaseRetentionDays, chunkRows);
+    if (deleted > 0)
+    {
+        purged_ += deleted;
+    }
+
+    // A full chunk means more expired rows, the next one after a pause for the inserts
+    if (deleted == chunkRows)
+    {
+        scheduleChunk(std::chrono::milliseconds(config->databaseRetentionChunkDelayMs));
+        return;
+    }
+
+    if (purged_ > 0)
+    {
+        std::ostringstream oss;
+        oss << "Purged " << purged_ << " rows older than " << config->databaseRetentionDays << " days from " << table;
+        services_.logger->FnLog(oss.str(), "DB");
+    }
+
+    tableIndex_++;
+    startTable();
+}
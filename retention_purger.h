@@ -0,0 +1,56 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include "ini_parser.h"
+#include "service.h"
+
+/*
+ * Keeps tbl_ev_lot_trans, tbl_ev_lot_status, tbl_ev_lot_hogging and
+ * tbl_ev_lot_stats_hourly within retentionDays, by add_dt or for the hourly
+ * rollups by hour_start.
+ * Every retentionIntervalMs a partitioned table gets its monthly partitions
+ * maintained: months up to retentionMonthsAhead are added and expired ones
+ * dropped. The expired rows left after that, all of them in a table that is
+ * not partitioned, are deleted retentionChunkRows at a time, oldest first,
+ * with retentionChunkDelayMs between chunks. No statement holds its locks for
+ * long and inserts go on in between.
+ * A retentionDays of 0 turns retention off.
+ */
+class RetentionPurger
+{
+public:
+    static RetentionPurger* getInstance();
+    void FnRetentionPurgerInitialization(boost::asio::io_context& io_context, const ServiceContext& services);
+    void FnStartRetentionPurger();
+
+    /*
+     * Singleton RetentionPurger cannot be cloneable
+     */
+    RetentionPurger(RetentionPurger& retentionPurger) = delete;
+
+    /*
+     * Singleton RetentionPurger cannot be assignable
+     */
+    void operator=(const RetentionPurger&) = delete;
+
+private:
+    static ServiceInstance<RetentionPurger> instance_;
+    ServiceContext services_;
+    RetentionPurger();
+
+    std::unique_ptr<boost::asio::strand<boost::asio::io_context::executor_type>> pStrand_;
+    std::unique_ptr<boost::asio::steady_timer> pTimer_;
+
+    // Run state, only touched on the strand
+    std::size_t tableIndex_;
+    long purged_;
+
+    void scheduleRun(std::chrono::milliseconds delay);
+    void run();
+    void startTable();
+    void scheduleChunk(std::chrono::milliseconds delay);
+    void purgeChunk();
+};
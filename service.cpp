@@ -0,0 +1,27 @@
+#include "central.h"
+#include "common.h"
+#include "database.h"
+#include "hogging_engine.h"
+#include "image_store.h"
+#include "ini_parser.h"
+#include "log.h"
+#include "lot_occupancy.h"
+#include "lot_statistics.h"
+#include "service.h"
+#include "timer.h"
+
+ServiceContext ServiceContext::FnFromInstances()
+{
+    ServiceContext context;
+    context.iniParser = IniParser::getInstance();
+    context.logger = Logger::getInstance();
+    context.common = Common::getInstance();
+    context.mariaDb = MariaDB::getInstance();
+    context.central = Central::getInstance();
+    context.evtTimer = EvtTimer::getInstance();
+    context.lotOccupancy = LotOccupancy::getInstance();
+    context.lotStatistics = LotStatistics::getInstance();
+    context.hoggingEngine = HoggingEngine::getInstance();
+    context.imageStore = ImageStore::getInstance();
+    return context;
+}
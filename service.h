@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+class Central;
+class Common;
+class EvtTimer;
+class HoggingEngine;
+class ImageStore;
+class IniParser;
+class Logger;
+class LotOccupancy;
+class LotStatistics;
+class MariaDB;
+
+/*
+ * Process-wide slot for one service instance.
+ * The instance is created exactly once under std::call_once, after that every
+ * access is a single acquire load, so getInstance() never takes a mutex on the
+ * hot path.
+ */
+template <typename T>
+class ServiceInstance
+{
+public:
+    template <typename Factory>
+    T* get(Factory factory)
+    {
+        T* instance = instance_.load(std::memory_order_acquire);
+        if (instance == nullptr)
+        {
+            std::call_once(onceFlag_, [this, &factory]() {
+                instance_.store(factory(), std::memory_order_release);
+            });
+            instance = instance_.load(std::memory_order_acquire);
+        }
+        return instance;
+    }
+
+private:
+    std::atomic<T*> instance_{nullptr};
+    std::once_flag onceFlag_;
+};
+
+/*
+ * Explicit set of service pointers.
+ * Components that are handed a ServiceContext use these pointers directly
+ * without going through getInstance(). Tests and benchmarks can construct
+ * their own context, FnFromInstances() fills it from the global instances.
+ */
+struct ServiceContext
+{
+    IniParser* iniParser = nullptr;
+    Logger* logger = nullptr;
+    Common* common = nullptr;
+    MariaDB* mariaDb = nullptr;
+    Central* central = nullptr;
+    EvtTimer* evtTimer = nullptr;
+    LotOccupancy* lotOccupancy = nullptr;
+    LotStatistics* lotStatistics = nullptr;
+    HoggingEngine* hoggingEngine = nullptr;
+    ImageStore* imageStore = nullptr;
+
+    static ServiceContext FnFromInstances();
+};
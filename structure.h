@@ -1,19 +1,109 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <string>
+#include "lot_record.h"
 
-typedef struct
+/*
+ * Park in / park out of a lot, as kept in tbl_ev_lot_trans.
+ * Move-only, it is handed on through timers and queues rather than copied.
+ */
+struct parking_lot_t
 {
-    std::string location_code;
-    std::string lot_no;
-    std::string lpn;
+    lotEvent event = lotEvent::ParkIn;
+    LocationCode location_code;
+    InlineString<10> lot_no;
+    InlineString<10> lpn;
     std::string lot_in_image_path;
     std::string lot_out_image_path;
-    std::string lot_in_dt;
-    std::string lot_out_dt;
-    std::string add_dt;
-    std::string update_dt;
-    std::string lot_in_central_sent_dt;
-    std::string lot_out_central_sent_dt;
-} parking_lot_t;
\ No newline at end of file
+    lot_time_t lot_in_dt;
+    lot_time_t lot_out_dt;
+    lot_time_t add_dt;
+    lot_time_t update_dt;
+    lot_time_t lot_in_central_sent_dt;
+    lot_time_t lot_out_central_sent_dt;
+
+    parking_lot_t() = default;
+    parking_lot_t(parking_lot_t&&) = default;
+    parking_lot_t& operator=(parking_lot_t&&) = default;
+    parking_lot_t(const parking_lot_t&) = delete;
+    parking_lot_t& operator=(const parking_lot_t&) = delete;
+};
+
+// tbl_ev_lot_trans row
+typedef struct
+{
+    int id;
+    parking_lot_t lot;
+} ev_lot_trans_record_t;
+
+// tbl_ev_lot_status row
+typedef struct
+{
+    int id;
+    std::string location_code;
+    std::string device_ip;
+    std::string error_code;
+} ev_lot_status_record_t;
+
+// Limit of a hogging policy that a session went past
+enum class hoggingReason : std::uint8_t
+{
+    // Parked longer than maxDwellMin
+    MaxDwell,
+    // Left standing idleMaxMin after charging ended
+    Idle
+};
+
+inline const char* hoggingReasonName(hoggingReason reason)
+{
+    return (reason == hoggingReason::Idle) ? "Idle" : "MaxDwell";
+}
+
+inline hoggingReason hoggingReasonFromName(const std::string& name)
+{
+    return (name == "Idle") ? hoggingReason::Idle : hoggingReason::MaxDwell;
+}
+
+// Session flagged as hogging its lot, as kept in tbl_ev_lot_hogging
+struct lot_hogging_t
+{
+    LocationCode location_code;
+    InlineString<10> lot_no;
+    InlineString<10> lpn;
+    std::string policy;
+    hoggingReason reason = hoggingReason::MaxDwell;
+    lot_time_t lot_in_dt;
+    lot_time_t hogging_dt;
+};
+
+// tbl_ev_lot_hogging row
+typedef struct
+{
+    int id;
+    lot_hogging_t hogging;
+} ev_lot_hogging_record_t;
+
+// Dwell histogram buckets of the hourly rollups, upper bounds in minutes; the last bucket is open
+inline constexpr std::array<int, 6> LOT_DWELL_BUCKET_LIMITS_MIN = {15, 30, 60, 120, 240, 480};
+inline constexpr std::size_t LOT_DWELL_BUCKETS = LOT_DWELL_BUCKET_LIMITS_MIN.size() + 1;
+
+// Activity of one lot within one hour, as kept in tbl_ev_lot_stats_hourly
+struct lot_stats_hourly_t
+{
+    InlineString<10> lot_no;
+    lot_time_t hour_start;
+    std::uint32_t park_ins = 0;
+    std::uint32_t park_outs = 0;
+    std::uint32_t hoggings = 0;
+    // Seconds of the hour the lot was occupied, utilization is occupied_sec / 3600
+    std::uint32_t occupied_sec = 0;
+    // Park outs with a known park in, average dwell is dwell_sum_sec / dwell_count
+    std::uint32_t dwell_count = 0;
+    std::uint64_t dwell_sum_sec = 0;
+    std::array<std::uint32_t, LOT_DWELL_BUCKETS> dwell_histogram{};
+    // Time the counts were taken
+    lot_time_t update_dt;
+};
@@ -1,10 +1,11 @@
 #include <iostream>
+#include "central.h"
 #include "database.h"
 #include "ini_parser.h"
+#include "lot_occupancy.h"
 #include "timer.h"
 
-EvtTimer* EvtTimer::evtTimer_ = nullptr;
-std::mutex EvtTimer::mutex_;
+ServiceInstance<EvtTimer> EvtTimer::instance_;
 
 
 EvtTimer::EvtTimer()
@@ -14,22 +15,17 @@ EvtTimer::EvtTimer()
 
 EvtTimer* EvtTimer::getInstance()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-
-    if (evtTimer_ == nullptr)
-    {
-        evtTimer_ = new EvtTimer();
-    }
-    return evtTimer_;
+    return instance_.get([]() { return new EvtTimer(); });
 }
 
-void EvtTimer::FnTimerInitialization(boost::asio::io_context& io_context, boost::asio::strand<boost::asio::io_context::executor_type>& strand)
+void EvtTimer::FnTimerInitialization(boost::asio::io_context& io_context)
 {
-    pDeviceStatusUpdateTimer_ = std::make_shared<Timer>(io_context, strand);
-    pHeartbeatCentralTimer_ = std::make_shared<Timer>(io_context, strand);
-    pFirstParkingLotFilterTimer_ = std::make_shared<Timer>(io_context, strand);
-    pSecondParkingLotFilterTimer_ = std::make_shared<Timer>(io_context, strand);
-    pThirdParkingLotFilterTimer_ = std::make_shared<Timer>(io_context, strand);
+    pPeriodicStrand_ = std::make_unique<boost::asio::strand<boost::asio::io_context::executor_type>>(io_context.get_executor());
+    pDeviceStatusUpdateTimer_ = std::make_shared<Timer>(io_context, *pPeriodicStrand_);
+    pHeartbeatCentralTimer_ = std::make_shared<Timer>(io_context, *pPeriodicStrand_);
+    pFirstParkingLotFilterTimer_ = std::make_shared<Timer>(io_context, boost::asio::make_strand(io_context));
+    pSecondParkingLotFilterTimer_ = std::make_shared<Timer>(io_context, boost::asio::make_strand(io_context));
+    pThirdParkingLotFilterTimer_ = std::make_shared<Timer>(io_context, boost::asio::make_strand(io_context));
 }
 
 void EvtTimer::onDeviceStatusUpdateTimerTimeout()
@@ -49,6 +45,9 @@ void EvtTimer::onHeartbeatCentralTimerTimeout()
 {
     Logger::getInstance()->FnLog(__func__, "TIMER");
 
+    // Also the probe that closes Central's circuit breaker again
+    Central::getInstance()->FnSendHeartbeatUpdate();
+
     FnStartHeartbeatCentralTimer();
 }
 
@@ -60,20 +59,19 @@ void EvtTimer::FnStartHeartbeatCentralTimer()
 
 
 // First parking lot filter timer
-void EvtTimer::onFirstParkingLotFilterTimerTimeout(std::unique_ptr<parking_lot_t> lotInfo)
+void EvtTimer::onFirstParkingLotFilterTimerTimeout(parking_lot_t lotInfo)
 {
     Logger::getInstance()->FnLog(__func__, "TIMER");
 
+    onParkingLotFiltered(lotInfo);
 }
 
-void EvtTimer::FnStartFirstParkingLotFilterTimer(const parking_lot_t& parkingLotInfo)
+void EvtTimer::FnStartFirstParkingLotFilterTimer(parking_lot_t&& parkingLotInfo)
 {
-    std::unique_ptr<parking_lot_t> data = std::make_unique<parking_lot_t>(parkingLotInfo);
-
     pFirstParkingLotFilterTimer_->start(IniParser::getInstance()->FnGetTimerForFilteringSnapshot(), 
-                                    std::function<void(std::unique_ptr<parking_lot_t>&&)>(
+                                    std::function<void(parking_lot_t&&)>(
                                         std::bind(&EvtTimer::onFirstParkingLotFilterTimerTimeout, this, std::placeholders::_1)), 
-                                        std::move(data));
+                                        std::move(parkingLotInfo));
 }
 
 void EvtTimer::FnStopFirstParkingLotFilterTimer()
@@ -88,19 +86,19 @@ bool EvtTimer::FnIsFirstParkingLotFilterTimerRunning()
 
 
 // Second parking lot filter timer
-void EvtTimer::onSecondParkingLotFilterTimerTimeout(std::unique_ptr<parking_lot_t> lotInfo)
+void EvtTimer::onSecondParkingLotFilterTimerTimeout(parking_lot_t lotInfo)
 {
     Logger::getInstance()->FnLog(__func__, "TIMER");
+
+    onParkingLotFiltered(lotInfo);
 }
 
-void EvtTimer::FnStartSecondParkingLotFilterTimer(const parking_lot_t& parkingLotInfo)
+void EvtTimer::FnStartSecondParkingLotFilterTimer(parking_lot_t&& parkingLotInfo)
 {
-    std::unique_ptr<parking_lot_t> data = std::make_unique<parking_lot_t>(parkingLotInfo);
-
     pSecondParkingLotFilterTimer_->start(IniParser::getInstance()->FnGetTimerForFilteringSnapshot(), 
-                                    std::function<void(std::unique_ptr<parking_lot_t>&&)>(
+                                    std::function<void(parking_lot_t&&)>(
                                         std::bind(&EvtTimer::onSecondParkingLotFilterTimerTimeout, this, std::placeholders::_1)), 
-                                        std::move(data));
+                                        std::move(parkingLotInfo));
 }
 
 void EvtTimer::FnStopSecondParkingLotFilterTimer()
@@ -115,20 +113,19 @@ bool EvtTimer::FnIsSecondParkingLotFilterTimerRunning()
 
 
 // Third parking lot filter timer
-void EvtTimer::onThirdParkingLotFilterTimerTimeout(std::unique_ptr<parking_lot_t> lotInfo)
+void EvtTimer::onThirdParkingLotFilterTimerTimeout(parking_lot_t lotInfo)
 {
     Logger::getInstance()->FnLog(__func__, "TIMER");
 
+    onParkingLotFiltered(lotInfo);
 }
 
-void EvtTimer::FnStartThirdParkingLotFilterTimer(const parking_lot_t& parkingLotInfo)
+void EvtTimer::FnStartThirdParkingLotFilterTimer(parking_lot_t&& parkingLotInfo)
 {
-    std::unique_ptr<parking_lot_t> data = std::make_unique<parking_lot_t>(parkingLotInfo);
-
     pThirdParkingLotFilterTimer_->start(IniParser::getInstance()->FnGetTimerForFilteringSnapshot(), 
-                                    std::function<void(std::unique_ptr<parking_lot_t>&&)>(
+                                    std::function<void(parking_lot_t&&)>(
                                         std::bind(&EvtTimer::onThirdParkingLotFilterTimerTimeout, this, std::placeholders::_1)), 
-                                        std::move(data));
+                                        std::move(parkingLotInfo));
 }
 
 void EvtTimer::FnStopThirdParkingLotFilterTimer()
@@ -139,4 +136,34 @@ void EvtTimer::FnStopThirdParkingLotFilterTimer()
 bool EvtTimer::FnIsThirdParkingLotFilterTimerRunning()
 {
     return pThirdParkingLotFilterTimer_->is_running();
-}
\ No newline at end of file
+}
+
+void EvtTimer::onParkingLotFiltered(parking_lot_t& lotInfo)
+{
+    if (lotInfo.location_code.empty())
+    {
+        lotInfo.location_code = IniParser::getInstance()->FnGetParkingLotLocationCode();
+    }
+
+    // The time the camera saw it, or now for an event that came without one
+    lot_time_t& eventDt = (lotInfo.event == lotEvent::ParkOut) ? lotInfo.lot_out_dt : lotInfo.lot_in_dt;
+    if (!isLotTimeSet(eventDt))
+    {
+        eventDt = std::chrono::system_clock::now();
+    }
+
+    bool recorded = (lotInfo.event == lotEvent::ParkOut) ? LotOccupancy::getInstance()->FnParkOut(lotInfo) : LotOccupancy::getInstance()->FnParkIn(lotInfo);
+    if (!recorded)
+    {
+        Logger::getInstance()->FnLog("Lot " + lotInfo.lot_no.str() + " event not recorded, sent to Central only.", "TIMER");
+    }
+
+    // Stamped once Central has it, an unstamped row is left to the resend sweeper
+    Central::getInstance()->FnSendParkInParkOutInfo(lotInfo,
+        [locationCode = lotInfo.location_code.str(), lotNo = lotInfo.lot_no.str(), event = lotInfo.event, eventDt](boost::beast::error_code ec, const std::string& msg) {
+            if (!ec && msg.empty())
+            {
+                MariaDB::getInstance()->FnMarkEvLotTransCentralSent(locationCode, lotNo, event, eventDt);
+            }
+        });
+}
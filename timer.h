@@ -7,12 +7,13 @@
 #include <functional>
 #include <memory>
 #include "log.h"
+#include "service.h"
 #include "structure.h"
 
 class Timer : public std::enable_shared_from_this<Timer>
 {
 public:
-    Timer(boost::asio::io_context& io_context, boost::asio::strand<boost::asio::io_context::executor_type>& strand)
+    Timer(boost::asio::io_context& io_context, const boost::asio::strand<boost::asio::io_context::executor_type>& strand)
         : timer_(io_context), strand_(strand), isTimerRunning_(false)
     {
         
@@ -89,17 +90,17 @@ class EvtTimer
 {
 public:
     static EvtTimer* getInstance();
-    void FnTimerInitialization(boost::asio::io_context& io_context, boost::asio::strand<boost::asio::io_context::executor_type>& strand);
+    void FnTimerInitialization(boost::asio::io_context& io_context);
     void FnStartDeviceStatusUpdateTimer();
     void FnStartHeartbeatCentralTimer();
 
-    void FnStartFirstParkingLotFilterTimer(const parking_lot_t& parkingLotInfo);
+    void FnStartFirstParkingLotFilterTimer(parking_lot_t&& parkingLotInfo);
     void FnStopFirstParkingLotFilterTimer();
     bool FnIsFirstParkingLotFilterTimerRunning();
-    void FnStartSecondParkingLotFilterTimer(const parking_lot_t& parkingLotInfo);
+    void FnStartSecondParkingLotFilterTimer(parking_lot_t&& parkingLotInfo);
     void FnStopSecondParkingLotFilterTimer();
     bool FnIsSecondParkingLotFilterTimerRunning();
-    void FnStartThirdParkingLotFilterTimer(const parking_lot_t& parkingLotInfo);
+    void FnStartThirdParkingLotFilterTimer(parking_lot_t&& parkingLotInfo);
     void FnStopThirdParkingLotFilterTimer();
     bool FnIsThirdParkingLotFilterTimerRunning();
 
@@ -114,10 +115,11 @@ public:
     void operator=(const EvtTimer&) = delete;
 
 private:
-    static EvtTimer* evtTimer_;
-    static std::mutex mutex_;
+    static ServiceInstance<EvtTimer> instance_;
     EvtTimer();
 
+    // Periodic jobs share one strand, every parking lot filter timer has its own
+    std::unique_ptr<boost::asio::strand<boost::asio::io_context::executor_type>> pPeriodicStrand_;
     std::shared_ptr<Timer> pDeviceStatusUpdateTimer_;
     std::shared_ptr<Timer> pHeartbeatCentralTimer_;
     std::shared_ptr<Timer> pFirstParkingLotFilterTimer_;
@@ -126,7 +128,9 @@ private:
 
     void onDeviceStatusUpdateTimerTimeout();
     void onHeartbeatCentralTimerTimeout();
-    void onFirstParkingLotFilterTimerTimeout(std::unique_ptr<parking_lot_t> lotInfo);
-    void onSecondParkingLotFilterTimerTimeout(std::unique_ptr<parking_lot_t> lotInfo);
-    void onThirdParkingLotFilterTimerTimeout(std::unique_ptr<parking_lot_t> lotInfo);
+    void onFirstParkingLotFilterTimerTimeout(parking_lot_t lotInfo);
+    void onSecondParkingLotFilterTimerTimeout(parking_lot_t lotInfo);
+    void onThirdParkingLotFilterTimerTimeout(parking_lot_t lotInfo);
+    // End of the snapshot filter window: the park in or park out is recorded, then sent to Central
+    void onParkingLotFiltered(parking_lot_t& lotInfo);
 };
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "write_journal.h"
+
+namespace
+{
+
+const char JOURNAL_MAGIC[4] = {'E', 'V', 'W', 'J'};
+const std::uint32_t JOURNAL_VERSION = 1;
+
+inline std::size_t alignRecord(std::size_t size)
+{
+    return (size + 7) & ~static_cast<std::size_t>(7);
+}
+
+}
+
+WriteJournal::WriteJournal()
+    : fd_(-1),
+    data_(nullptr),
+    capacity_(0),
+    writeOffset_(DATA_OFFSET),
+    pendingCount_(0)
+{
+}
+
+WriteJournal::~WriteJournal()
+{
+    FnClose();
+}
+
+bool WriteJournal::FnOpen(const std::string& path, std::size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (data_)
+    {
+        return true;
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    // A journal made with a larger capacity keeps its size
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    std::size_t size = std::max<std::size_t>(static_cast<std::size_t>(st.st_size), std::max<std::size_t>(capacity, DATA_OFFSET * 2));
+    if ((static_cast<std::size_t>(st.st_size) < size) && (::ftruncate(fd, static_cast<off_t>(size)) != 0))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapped = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    fd_ = fd;
+    data_ = static_cast<char*>(mapped);
+    capacity_ = size;
+
+    journalHeader* header = reinterpret_cast<journalHeader*>(data_);
+    if ((std::memcmp(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) || (header->version != JOURNAL_VERSION) ||
+        (header->replayOffset < DATA_OFFSET) || (header->replayOffset >= capacity_))
+    {
+        std::memset(data_, 0, DATA_OFFSET);
+        std::memcpy(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        header->version = JOURNAL_VERSION;
+        header->epoch = 1;
+        header->replayOffset = DATA_OFFSET;
+        std::memset(data_ + DATA_OFFSET, 0, sizeof(recordHeader));
+    }
+
+    // The pending records run up to the first frame that does not check out
+    writeOffset_ = header->replayOffset;
+    pendingCount_ = 0;
+    while (std::size_t size = recordSize(writeOffset_))
+    {
+        writeOffset_ += size;
+        pendingCount_++;
+    }
+
+    return true;
+}
+
+void WriteJournal::FnClose()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (data_)
+    {
+        ::msync(data_, capacity_, MS_ASYNC);
+        ::munmap(data_, capacity_);
+        data_ = nullptr;
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    capacity_ = 0;
+    writeOffset_ = DATA_OFFSET;
+    pendingCount_ = 0;
+}
+
+bool WriteJournal::FnIsOpen() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return data_ != nullptr;
+}
+
+bool WriteJournal::FnAppend(std::string_view payload)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::size_t size = alignRecord(sizeof(recordHeader) + payload.size());
+    if (!data_ || (payload.size() > UINT32_MAX) || (writeOffset_ + size > capacity_))
+    {
+        return false;
+    }
+
+    const journalHeader* header = reinterpret_cast<const journalHeader*>(data_);
+    recordHeader record{RECORD_MAGIC, header->epoch, static_cast<std::uint32_t>(payload.size()), recordCrc(header->epoch, payload)};
+
+    // Payload before its header, a frame is never valid before its data is in place
+    std::memcpy(data_ + writeOffset_ + sizeof(recordHeader), payload.data(), payload.size());
+    std::memcpy(data_ + writeOffset_, &record, sizeof(record));
+    writeOffset_ += size;
+    pendingCount_++;
+    return true;
+}
+
+bool WriteJournal::FnIsEmpty() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pendingCount_ == 0;
+}
+
+std::size_t WriteJournal::FnGetPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pendingCount_;
+}
+
+std::size_t WriteJournal::FnGetUsedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return data_ ? (writeOffset_ - reinterpret_cast<const journalHeader*>(data_)->replayOffset) : 0;
+}
+
+std::size_t WriteJournal::FnGetCapacity() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return capacity_;
+}
+
+std::vector<std::string> WriteJournal::FnPeek(std::size_t maxRecords) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<std::string> records;
+    if (!data_)
+    {
+        return records;
+    }
+
+    std::size_t offset = reinterpret_cast<const journalHeader*>(data_)->replayOffset;
+    while ((records.size() < maxRecords) && (offset < writeOffset_))
+    {
+        const recordHeader* record = reinterpret_cast<const recordHeader*>(data_ + offset);
+        records.emplace_back(data_ + offset + sizeof(recordHeader), record->length);
+        offset += alignRecord(sizeof(recordHeader) + record->length);
+    }
+    return records;
+}
+
+void WriteJournal::FnConsume(std::size_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!data_)
+    {
+        return;
+    }
+
+    journalHeader* header = reinterpret_cast<journalHeader*>(data_);
+    std::size_t offset = header->replayOffset;
+    for (std::size_t i = 0; (i < count) && (offset < writeOffset_); i++)
+    {
+        const recordHeader* record = reinterpret_cast<const recordHeader*>(data_ + offset);
+        offset += alignRecord(sizeof(recordHeader) + record->length);
+        pendingCount_--;
+    }
+
+    if (offset >= writeOffset_)
+    {
+        reset();
+    }
+    else
+    {
+        header->replayOffset = offset;
+    }
+}
+
+std::size_t WriteJournal::recordSize(std::size_t offset) const
+{
+    if (offset + sizeof(recordHeader) > capacity_)
+    {
+        return 0;
+    }
+
+    recordHeader record;
+    std::memcpy(&record, data_ + offset, sizeof(record));
+    const journalHeader* header = reinterpret_cast<const journalHeader*>(data_);
+    std::size_t size = alignRecord(sizeof(recordHeader) + record.length);
+    if ((record.magic != RECORD_MAGIC) || (record.epoch != header->epoch) || (offset + size > capacity_))
+    {
+        return 0;
+    }
+
+    if (record.crc != recordCrc(record.epoch, std::string_view(data_ + offset + sizeof(recordHeader), record.length)))
+    {
+        return 0;
+    }
+    return size;
+}
+
+std::uint32_t WriteJournal::recordCrc(std::uint32_t epoch, std::string_view payload)
+{
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(&epoch), sizeof(epoch));
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(payload.data()), static_cast<uInt>(payload.size()));
+    return static_cast<std::uint32_t>(crc);
+}
+
+void WriteJournal::reset()
+{
+    // New epoch first: whatever is left in the file no longer belongs to it
+    journalHeader* header = reinterpret_cast<journalHeader*>(data_);
+    header->epoch++;
+    std::memset(data_ + DATA_OFFSET, 0, sizeof(recordHeader));
+    header->replayOffset = DATA_OFFSET;
+    writeOffset_ = DATA_OFFSET;
+    pendingCount_ = 0;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Append-only journal of database writes, a memory-mapped file of
+ * CRC-framed records. Records are appended while the database is
+ * unavailable and consumed in order once they were applied.
+ *
+ * The header keeps the replay position and an epoch. Records carry the
+ * epoch they were written in, so on open the pending records are the valid
+ * frames from the replay position up to the first torn, foreign-epoch or
+ * empty frame; nothing else has to be flushed in step with the data. When
+ * everything was consumed the journal restarts at the front with the next
+ * epoch.
+ * Written through the page cache: records survive a crash of the process,
+ * a power cut loses what the kernel had not written back yet.
+ */
+class WriteJournal
+{
+public:
+    WriteJournal();
+    ~WriteJournal();
+
+    // Open or create path with at least capacity bytes and recover the pending records
+    bool FnOpen(const std::string& path, std::size_t capacity);
+    void FnClose();
+    bool FnIsOpen() const;
+
+    // False if the journal is not open or full
+    bool FnAppend(std::string_view payload);
+
+    bool FnIsEmpty() const;
+    std::size_t FnGetPendingCount() const;
+    std::size_t FnGetUsedBytes() const;
+    std::size_t FnGetCapacity() const;
+
+    // Copies of up to maxRecords oldest pending records
+    std::vector<std::string> FnPeek(std::size_t maxRecords) const;
+    // Drop the count oldest pending records, they were applied
+    void FnConsume(std::size_t count);
+
+private:
+    struct journalHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t epoch;
+        std::uint32_t reserved;
+        std::uint64_t replayOffset;
+    };
+
+    struct recordHeader
+    {
+        std::uint32_t magic;
+        std::uint32_t epoch;
+        std::uint32_t length;
+        std::uint32_t crc;
+    };
+
+    static constexpr std::size_t DATA_OFFSET = 64;
+    static constexpr std::uint32_t RECORD_MAGIC = 0x57454A52;
+
+    // Size of the record at offset, 0 if no valid record of this epoch starts there
+    std::size_t recordSize(std::size_t offset) const;
+    static std::uint32_t recordCrc(std::uint32_t epoch, std::string_view payload);
+    void reset();
+
+    mutable std::mutex mutex_;
+    int fd_;
+    char* data_;
+    std::size_t capacity_;
+    std::size_t writeOffset_;
+    std::size_t pendingCount_;
+};